@@ -0,0 +1,59 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _OPENTRACING_C_WRAPPER_ATOM_H_
+#define _OPENTRACING_C_WRAPPER_ATOM_H_
+
+/***
+ * An interned string: its copy, its length and its FNV-1a hash, which are
+ * all computed only once, when the string is interned.  The entries are
+ * never changed or removed once they are added to the atom table.
+ */
+struct otc_atom_entry {
+	std::unique_ptr<char[]> str;
+	size_t                  len;
+	uint64_t                hash;
+};
+
+
+extern struct otc_atom_entry ot_atom[OT_ATOM_MAX];
+extern std::atomic<int>      ot_atom_count;
+
+
+/***
+ * Returns the atom table entry of the atom, or nullptr if the atom is not
+ * valid.  The entries below the atom count are complete, so no lock is
+ * needed.
+ */
+static inline const struct otc_atom_entry *ot_atom_get(otc_atom_t atom)
+{
+	return OT_IN_RANGE(atom, 0, ot_atom_count.load(std::memory_order_acquire) - 1) ? ot_atom + atom : nullptr;
+}
+
+#define OT_ATOM_VIEW(a)   opentracing::string_view((a)->str.get(), (a)->len)
+
+
+uint64_t ot_atom_hash(const char *str, size_t len);
+
+#endif /* _OPENTRACING_C_WRAPPER_ATOM_H_ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
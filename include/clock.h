@@ -0,0 +1,45 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _OPENTRACING_C_WRAPPER_CLOCK_H_
+#define _OPENTRACING_C_WRAPPER_CLOCK_H_
+
+extern std::atomic<int> ot_clock_source;
+
+
+/***
+ * Tells whether the timestamps that are not set by the application are
+ * filled in by the wrapper, instead of being read by the tracer.
+ */
+static inline bool ot_clock_is_set(void)
+{
+	return ot_clock_source.load(std::memory_order_relaxed) != otc_clock_tracer;
+}
+
+
+bool                                  ot_clock_now(std::chrono::steady_clock::time_point &steady, opentracing::SystemTime &system);
+std::chrono::steady_clock::time_point ot_clock_steady(void);
+opentracing::SystemTime               ot_clock_system(void);
+
+#endif /* _OPENTRACING_C_WRAPPER_CLOCK_H_ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
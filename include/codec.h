@@ -0,0 +1,74 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _OPENTRACING_C_WRAPPER_CODEC_H_
+#define _OPENTRACING_C_WRAPPER_CODEC_H_
+
+#define OT_CODEC_JAEGER             "uber-trace-id"
+#define OT_CODEC_B3_TRACE_ID        "x-b3-traceid"
+#define OT_CODEC_B3_SPAN_ID         "x-b3-spanid"
+#define OT_CODEC_B3_PARENT_SPAN_ID  "x-b3-parentspanid"
+#define OT_CODEC_B3_SAMPLED         "x-b3-sampled"
+#define OT_CODEC_B3_FLAGS           "x-b3-flags"
+#define OT_CODEC_B3_SINGLE          "b3"
+#define OT_CODEC_W3C_TRACEPARENT    "traceparent"
+#define OT_CODEC_W3C_TRACESTATE     "tracestate"
+#define OT_CODEC_DD_TRACE_ID        "x-datadog-trace-id"
+#define OT_CODEC_DD_PARENT_ID       "x-datadog-parent-id"
+#define OT_CODEC_DD_PRIORITY        "x-datadog-sampling-priority"
+
+#define OT_CODEC_SEEN_TRACE_ID      0x01
+#define OT_CODEC_SEEN_SPAN_ID       0x02
+#define OT_CODEC_SEEN_OTHER         0x04
+#define OT_CODEC_SEEN_IDS           (OT_CODEC_SEEN_TRACE_ID | OT_CODEC_SEEN_SPAN_ID)
+
+#define OT_CODEC_FORMAT_IS_VALID(a) OT_IN_RANGE((a), otc_propagation_format_jaeger, otc_propagation_format_datadog)
+
+
+/***
+ * Reads the trace context of one header format from the key/value pairs
+ * of a carrier.  The pairs are passed to the decoder one by one, either
+ * from a text map or from the foreach_key() callback of a reader, so the
+ * carrier data is not copied anywhere.
+ */
+class otc_codec_decoder {
+	public:
+	otc_codec_decoder(otc_propagation_format_t decoder_format, struct otc_trace_context *decoder_context);
+
+	otc_propagation_error_code_t add(const char *key, const char *value);
+	otc_propagation_error_code_t finish(void) const;
+
+	static otc_propagation_error_code_t handler(void *arg, const char *key, const char *value)
+	{
+		return OT_CAST_STAT(otc_codec_decoder *, arg)->add(key, value);
+	}
+
+	private:
+	otc_propagation_format_t  format;
+	struct otc_trace_context *context;
+	int                       seen;
+	bool                      is_corrupted;
+};
+
+#endif /* _OPENTRACING_C_WRAPPER_CODEC_H_ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
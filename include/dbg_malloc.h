@@ -43,6 +43,28 @@ struct otc_dbg_mem_metadata {
 	uint64_t                 magic;
 };
 
+#define DBG_MEM_SHARDS           16
+#define DBG_MEM_SLOT_NONE        UINT32_MAX
+#define DBG_MEM_SLOT(a)          OT_CAST_STAT(uint32_t, (a) & UINT32_MAX)
+#define DBG_MEM_TAG(a)           ((a) & ~OT_CAST_STAT(uint64_t, UINT32_MAX))
+#define DBG_MEM_TAG_NEXT(a)      (DBG_MEM_TAG(a) + (UINT64_C(1) << 32))
+
+/***
+ * One shard of the memory tracker, that is, a part of the array of memory
+ * allocation records.  Every thread takes the records from its own shard:
+ * first those that have not been used at all so far, and then those that
+ * were released to the free record stack of the shard.  The top of the
+ * stack holds the index of the record in the lower 32 bits and a tag in
+ * the upper 32 bits.  The tag is changed on every push, so that a pop that
+ * was interrupted by a pop and push of the same record fails.
+ */
+struct alignas(OT_CACHE_LINE_SIZE) otc_dbg_mem_shard {
+	size_t                begin;  /* The first record of the shard. */
+	size_t                end;    /* The record after the last one. */
+	std::atomic<size_t>   unused; /* The first record not used so far. */
+	std::atomic<uint64_t> free;   /* The top of the free record stack. */
+};
+
 #ifdef __sun
 #define PRI_MI                   "lu"
 #else
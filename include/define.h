@@ -16,7 +16,33 @@
 #ifndef _OPENTRACING_C_WRAPPER_DEFINE_H_
 #define _OPENTRACING_C_WRAPPER_DEFINE_H_
 
-#undef  OT_THREADS_NO_LOCKING
+#ifndef OT_HANDLE_SHARDS
+#  define OT_HANDLE_SHARDS          64
+#endif
+#ifndef OT_POOL_SIZE
+#  define OT_POOL_SIZE              256
+#endif
+#ifdef DEBUG
+/*
+ * A structure taken from the pool would make a stale span or span context
+ * pointer valid again, so the debug version does not reuse them.
+ */
+#  undef  OT_POOL_SIZE
+#  define OT_POOL_SIZE              0
+#endif
+#ifndef OT_TAG_BUFFER
+#  define OT_TAG_BUFFER             0
+#endif
+#define OT_TAG_BUFFER_DATA          (OT_TAG_BUFFER * 32)
+#define OT_CACHE_LINE_SIZE          64
+#define OT_KEY_THREAD_BITS          12
+#define OT_KEY_THREAD_MASK          ((INT64_C(1) << OT_KEY_THREAD_BITS) - 1)
+#define OT_TEXT_MAP_INJECT_SIZE     4
+#define OT_BINARY_DATA_SIZE         64
+#define OT_SAMPLER_BUCKETS          256
+#define OT_ATOM_MAX                 1024
+#define OT_TRACER_NOOP              "noop"
+#define OT_FINISHER_SLEEP_MS        10
 
 #ifdef USE_THREADS
 #  define __THR                     __thread
@@ -39,10 +65,31 @@
 #define OT_FREE_CLEAR(a)            do { if ((a) != nullptr) { OTC_DBG_FREE(a); (a) = nullptr; } } while (0)
 
 #define OT_IN_RANGE(v,a,b)          (((v) >= (a)) && ((v) <= (b)))
-#define OT_SPAN_KEY_IS_VALID(a)     OT_IN_RANGE((a)->idx, 0, ot_span.key - 1)
+/*
+ * With the direct spans, a span or span context structure is valid as long
+ * as it points to an object; the use of a finished or destroyed one is not
+ * detected in the non-debug version (see the '--enable-direct-spans'
+ * configure option in the README).
+ */
+#ifndef OT_DIRECT_SPANS
+#  define OT_SPAN_KEY_IS_VALID(a)   OT_KEY_IS_VALID(span, (a)->idx)
+#elif defined(DEBUG)
+#  define OT_SPAN_KEY_IS_VALID(a)   (((a)->handle != nullptr) && OT_KEY_IS_VALID(span, (a)->idx))
+#else
+#  define OT_SPAN_KEY_IS_VALID(a)   ((a)->handle != nullptr)
+#endif
 #define OT_SPAN_IS_VALID(a)         (((a) != nullptr) && OT_SPAN_KEY_IS_VALID(a))
-#define OT_CTX_KEY_IS_VALID(a)      OT_IN_RANGE((a)->idx, 0, ot_span_context.key - 1)
+#ifndef OT_DIRECT_SPANS
+#  define OT_CTX_KEY_IS_VALID(a)    OT_KEY_IS_VALID(span_context, (a)->idx)
+#elif defined(DEBUG)
+#  define OT_CTX_KEY_IS_VALID(a)    (((a)->handle != nullptr) && OT_KEY_IS_VALID(span_context, (a)->idx))
+#else
+#  define OT_CTX_KEY_IS_VALID(a)    ((a)->handle != nullptr)
+#endif
 #define OT_CTX_IS_VALID(a)          (((a) != nullptr) && (OT_SPAN_IS_VALID((a)->span) || OT_CTX_KEY_IS_VALID(a)))
+#define OT_CTX_IS_NOOP(a)           (((a) == &ot_span_context_noop) || ((a)->span == &ot_span_noop))
+
+#define OT_VALUE_TYPE(a)            OT_CAST_STAT(otc_value_type_t, OTC_VALUE_TYPE(a))
 
 #define OT_CAST_CONST(t,e)          const_cast<t>(e)
 #define OT_CAST_STAT(t,e)           static_cast<t>(e)
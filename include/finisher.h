@@ -0,0 +1,108 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _OPENTRACING_C_WRAPPER_FINISHER_H_
+#define _OPENTRACING_C_WRAPPER_FINISHER_H_
+
+#ifdef USE_THREADS
+
+/***
+ * The tags and log records that the background thread passes to the span
+ * object before it finishes the span, in the format of the tag buffer of a
+ * span.  The entries and the copies of the strings that are not persistent
+ * are allocated in one block, right after this structure.  A structure with
+ * the entry member set to nullptr only counts the entries and the string
+ * data, so that the block can then be allocated at once.
+ */
+struct otc_finisher_data {
+	struct otc_span_tag_entry *entry;
+	int                        num_entries;
+	char                      *data;
+	size_t                     data_used;
+};
+
+
+/***
+ * One slot of the finish queue: the span object detached from its handle,
+ * its finish time and the data to pass to it before it is finished.  The
+ * sequence number tells whether the slot is free for the producers or
+ * filled for the consumer.
+ */
+struct otc_finisher_slot {
+	std::atomic<uint64_t>                 seq;
+	opentracing::Span                    *span;
+	std::chrono::steady_clock::time_point finish_time;
+	struct otc_finisher_data             *data;
+};
+
+
+/***
+ * Finishes the spans in a background thread.  The spans are passed to the
+ * thread through a bounded lock-free queue with many producers (the threads
+ * that finish the spans) and a single consumer (the background thread).
+ */
+class otc_finisher {
+	public:
+	otc_finisher();
+	~otc_finisher();
+
+	int  start(int size, otc_finish_policy_t finish_policy);
+	void stop(void);
+	void push(opentracing::Span *span, std::chrono::steady_clock::time_point finish_time, struct otc_finisher_data *data);
+
+	bool is_enabled(void) const { return enabled.load(std::memory_order_relaxed); }
+
+	otc_finisher(const otc_finisher &) = delete;
+	otc_finisher &operator=(const otc_finisher &) = delete;
+
+	private:
+	bool enqueue(opentracing::Span *span, std::chrono::steady_clock::time_point finish_time, struct otc_finisher_data *data);
+	bool dequeue(void);
+	void wake(void);
+	void run(void);
+
+	std::unique_ptr<struct otc_finisher_slot[]>       slot;
+	uint64_t                                          mask;
+	otc_finish_policy_t                               policy;
+	std::atomic<bool>                                 enabled;
+	std::mutex                                        mutex;
+	std::condition_variable                           cond;
+	std::thread                                       thread;
+	bool                                              is_stopping;
+	alignas(OT_CACHE_LINE_SIZE) std::atomic<uint64_t> head;
+	std::atomic<int>                                  producers;
+	std::atomic<bool>                                 is_sleeping;
+	alignas(OT_CACHE_LINE_SIZE) uint64_t              tail;
+};
+
+
+extern otc_finisher ot_finisher;
+
+void                      ot_finisher_data_add(struct otc_finisher_data *data, const char *key, const struct otc_value *value, int count);
+void                      ot_finisher_data_log(struct otc_finisher_data *data, int64_t timestamp, const struct otc_log_field *fields, int num_fields);
+struct otc_finisher_data *ot_finisher_data_new(const struct otc_finisher_data *size);
+
+#endif /* USE_THREADS */
+
+#endif /* _OPENTRACING_C_WRAPPER_FINISHER_H_ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
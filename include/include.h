@@ -19,8 +19,14 @@
 #include <cstdio>
 #include <cinttypes>
 #include <stdbool.h>
+#include <strings.h>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
 
 #include <opentracing/dynamic_load.h>
 #include <opentracing/version.h>
@@ -40,9 +46,14 @@
 #include "opentracing-c-wrapper/propagation.h"
 #include "opentracing-c-wrapper/tracer.h"
 
+#include "util.h"
 #include "span.h"
 #include "tracer.h"
-#include "util.h"
+#include "codec.h"
+#include "sampler.h"
+#include "finisher.h"
+#include "atom.h"
+#include "clock.h"
 
 #endif /* _OPENTRACING_C_WRAPPER_INCLUDE_H_ */
 
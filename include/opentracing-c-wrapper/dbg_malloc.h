@@ -37,15 +37,19 @@ struct otc_dbg_mem_data {
 	bool        used;
 } __attribute__((packed));
 
+/*
+ * The state of the memory tracker.  otc_dbg_mem_init() and
+ * otc_dbg_mem_disable() must not be called while other threads allocate or
+ * release memory.
+ */
 struct otc_dbg_mem {
 	struct otc_dbg_mem_data *data;
 	size_t                   count;
-	size_t                   unused;
-	size_t                   reused;
+	size_t                   unused;    /* The number of records not used so far. */
+	size_t                   reused;    /* The number of released records used again. */
 	uint64_t                 size;
 	uint64_t                 op_cnt[4];
 	uint8_t                  level;
-	pthread_mutex_t          mutex;
 };
 
 
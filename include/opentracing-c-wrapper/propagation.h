@@ -80,7 +80,14 @@ struct otc_text_map_writer {
 	 *   value  - string value
 	 *
 	 * DECRTIPTION
-	 *   set a key-value pair
+	 *   set a key-value pair; the key and the value are valid only during
+	 *   the call.  If set is NULL, the pairs are stored in the text_map,
+	 *   which is initialized by the inject function with otc_text_map_new()
+	 *   and gets a duplicate of each key and value, to be released with
+	 *   otc_text_map_destroy() and the OTC_TEXT_MAP_FREE_KEY and
+	 *   OTC_TEXT_MAP_FREE_VALUE flags.  If the caller has initialized the
+	 *   text_map as an arena with one of the otc_text_map_arena_*()
+	 *   functions, the arena is cleared and the pairs are copied into it
 	 *
 	 * RETURN VALUE
 	 *   otc_propagation_error_code_t - indicates success or failure
@@ -188,6 +195,42 @@ struct otc_custom_carrier_reader {
 		OTC_NONNULL_ALL;
 };
 
+/***
+ * trace context header formats that the wrapper can read and write itself
+ */
+typedef enum {
+	otc_propagation_format_none = 0,  /* the headers are handled by the tracer only */
+	otc_propagation_format_jaeger,    /* uber-trace-id */
+	otc_propagation_format_b3,        /* x-b3-traceid, x-b3-spanid, ... */
+	otc_propagation_format_b3_single, /* b3 */
+	otc_propagation_format_w3c,       /* traceparent, tracestate */
+	otc_propagation_format_datadog,   /* x-datadog-trace-id, ... */
+} otc_propagation_format_t;
+
+typedef enum {
+	OTC_TRACE_FLAG_SAMPLED  = 0x01, /* The trace is sampled. */
+	OTC_TRACE_FLAG_DEBUG    = 0x02, /* The trace is forced to be sampled. */
+	OTC_TRACE_FLAG_DEFERRED = 0x04, /* The sampling decision is not made yet. */
+} otc_trace_flags_t;
+
+/***
+ * The identifiers of a propagated span context, in the same form for all
+ * header formats.  The tracestate member points to the value in the
+ * carrier, so it is valid only as long as the carrier.
+ */
+struct otc_trace_context {
+	uint64_t    trace_id_high;  /* The upper 64 bits of a 128-bit trace id, or 0. */
+	uint64_t    trace_id;       /* The lower 64 bits of the trace id. */
+	uint64_t    span_id;        /* 64-bit span id, value of 0 is not valid. */
+	uint64_t    parent_span_id; /* 64-bit parent span id, 0 if not known. */
+	uint8_t     flags;          /* OTC_TRACE_FLAG_* */
+	const char *tracestate;     /* W3C tracestate header value, or NULL. */
+};
+
+
+otc_propagation_error_code_t otc_propagation_decode(const struct otc_text_map *text_map, otc_propagation_format_t format, struct otc_trace_context *context);
+otc_propagation_error_code_t otc_propagation_encode(struct otc_text_map *text_map, otc_propagation_format_t format, const struct otc_trace_context *context);
+
 __CPLUSPLUS_DECL_END
 #endif /* OPENTRACING_C_WRAPPER_PROPAGATION_H */
 
@@ -18,6 +18,14 @@
 
 __CPLUSPLUS_DECL_BEGIN
 
+/***
+ * A span tag
+ */
+struct otc_tag {
+	const char       *key;
+	struct otc_value  value;
+};
+
 /***
  * Encode a key-value for logging
  */
@@ -33,6 +41,14 @@ struct otc_log_field {
 	struct otc_value value;
 };
 
+/***
+ * A log field with an interned key, see otc_intern()
+ */
+struct otc_log_field_atom {
+	otc_atom_t       key;
+	struct otc_value value;
+};
+
 /***
  * A log entry for events that occured during the span lifetime
  */
@@ -89,6 +105,70 @@ struct otc_finish_span_options {
 	int num_log_records;
 };
 
+/***
+ * The span operations, shared by all spans when the library is built
+ * with the compact ABI.  The functions are the same as those described
+ * in the default otc_span structure below.
+ */
+struct otc_span;
+struct otc_span_context;
+struct otc_tracer;
+
+struct otc_span_ops {
+	void                     (*finish)(struct otc_span *span)
+		OTC_NONNULL_ALL;
+	void                     (*finish_with_options)(struct otc_span *span, const struct otc_finish_span_options *options)
+		OTC_NONNULL(1);
+	struct otc_span_context *(*span_context)(struct otc_span *span)
+		OTC_NONNULL_ALL;
+	void                     (*set_operation_name)(struct otc_span *span, const char *operation_name)
+		OTC_NONNULL_ALL;
+	void                     (*set_tag)(struct otc_span *span, const char *key, const struct otc_value *value)
+		OTC_NONNULL_ALL;
+	void                     (*log_fields)(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
+		OTC_NONNULL(1);
+	void                     (*set_baggage_item)(struct otc_span *span, const char *key, const char *value)
+		OTC_NONNULL_ALL;
+	const char              *(*baggage_item)(const struct otc_span *span, const char *key)
+		OTC_NONNULL_ALL;
+	struct otc_tracer       *(*tracer)(const struct otc_span *span)
+		OTC_NONNULL_ALL;
+	void                     (*destroy)(struct otc_span **span)
+		OTC_NONNULL_ALL;
+	void                     (*set_tags)(struct otc_span *span, const struct otc_tag *tags, int num_tags)
+		OTC_NONNULL(1);
+	void                     (*set_tags_log_finish)(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields)
+		OTC_NONNULL(1);
+	void                     (*set_tag_atom)(struct otc_span *span, otc_atom_t key, const struct otc_value *value)
+		OTC_NONNULL(1, 3);
+	void                     (*log_fields_atom)(struct otc_span *span, const struct otc_log_field_atom *fields, int num_fields)
+		OTC_NONNULL(1);
+};
+
+#ifdef OTC_COMPACT_ABI
+
+/***
+ * The span interface, compact version: the span operations are accessed
+ * through the ops pointer, ie. OTC_SPAN_OPS(span)->finish(span)
+ */
+struct otc_span {
+	int64_t idx;
+
+	/***
+	 * span object used internally by the library, must not be changed
+	 */
+	void *handle;
+
+	/***
+	 * span operations, shared by all spans
+	 */
+	const struct otc_span_ops *ops;
+};
+
+#  define OTC_SPAN_OPS(s)   ((s)->ops)
+
+#else
+
 /***
  * The span interface
  */
@@ -178,7 +258,8 @@ struct otc_span {
 	 *   num_fields - number of log fields in the log field array
 	 *
 	 * DESCRIPTION
-	 *   store log data for a span
+	 *   store log data for a span; the number of log fields is not limited
+	 *   and the fields can be of any value type
 	 */
 	void (*log_fields)(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
 		OTC_NONNULL(1);
@@ -241,8 +322,159 @@ struct otc_span {
 	 */
 	void (*destroy)(struct otc_span **span)
 		OTC_NONNULL_ALL;
+
+	/***
+	 * span object used internally by the library, must not be changed
+	 */
+	void *handle;
+
+	/***
+	 * NAME
+	 *   set_tags -
+	 *
+	 * ARGUMENTS
+	 *   span     - span instance
+	 *   tags     - array of tags to copy into the span
+	 *   num_tags - number of tags in the array
+	 *
+	 * DESCRIPTION
+	 *   add several tags to a span at once, the same as calling set_tag
+	 *   for each of them
+	 */
+	void (*set_tags)(struct otc_span *span, const struct otc_tag *tags, int num_tags)
+		OTC_NONNULL(1);
+
+	/***
+	 * NAME
+	 *   set_tags_log_finish -
+	 *
+	 * ARGUMENTS
+	 *   span       - span instance
+	 *   tags       - array of tags to copy into the span, can be NULL
+	 *   num_tags   - number of tags in the array
+	 *   fields     - log fields as an array, can be NULL
+	 *   num_fields - number of log fields in the array
+	 *
+	 * DESCRIPTION
+	 *   add several tags to a span, store one log entry and finish the span,
+	 *   all in one call; the log entry is not stored if num_fields is zero
+	 */
+	void (*set_tags_log_finish)(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields)
+		OTC_NONNULL(1);
+
+	/***
+	 * NAME
+	 *   set_tag_atom -
+	 *
+	 * ARGUMENTS
+	 *   span  - span instance
+	 *   key   - tag key, interned with otc_intern()
+	 *   value - tag value
+	 *
+	 * DESCRIPTION
+	 *   the same as set_tag, the tag is ignored if the key is not a valid
+	 *   atom
+	 */
+	void (*set_tag_atom)(struct otc_span *span, otc_atom_t key, const struct otc_value *value)
+		OTC_NONNULL(1, 3);
+
+	/***
+	 * NAME
+	 *   log_fields_atom -
+	 *
+	 * ARGUMENTS
+	 *   span       - span instance
+	 *   fields     - log fields as an array, with the keys interned with
+	 *                otc_intern()
+	 *   num_fields - number of log fields in the array
+	 *
+	 * DESCRIPTION
+	 *   the same as log_fields, the fields whose keys are not valid atoms
+	 *   are skipped
+	 */
+	void (*log_fields_atom)(struct otc_span *span, const struct otc_log_field_atom *fields, int num_fields)
+		OTC_NONNULL(1);
 };
 
+#  define OTC_SPAN_OPS(s)   (s)
+
+#endif /* OTC_COMPACT_ABI */
+
+/***
+ * The span operations as functions, which work with both ABIs, ie.
+ * otc_span_finish(span) instead of span->finish(span) or
+ * OTC_SPAN_OPS(span)->finish(span).
+ */
+static inline void otc_span_finish(struct otc_span *span)
+{
+	OTC_SPAN_OPS(span)->finish(span);
+}
+
+static inline void otc_span_finish_with_options(struct otc_span *span, const struct otc_finish_span_options *options)
+{
+	OTC_SPAN_OPS(span)->finish_with_options(span, options);
+}
+
+static inline struct otc_span_context *otc_span_get_context(struct otc_span *span)
+{
+	return OTC_SPAN_OPS(span)->span_context(span);
+}
+
+static inline void otc_span_set_operation_name(struct otc_span *span, const char *operation_name)
+{
+	OTC_SPAN_OPS(span)->set_operation_name(span, operation_name);
+}
+
+static inline void otc_span_set_tag(struct otc_span *span, const char *key, const struct otc_value *value)
+{
+	OTC_SPAN_OPS(span)->set_tag(span, key, value);
+}
+
+static inline void otc_span_log_fields(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
+{
+	OTC_SPAN_OPS(span)->log_fields(span, fields, num_fields);
+}
+
+static inline void otc_span_set_baggage_item(struct otc_span *span, const char *key, const char *value)
+{
+	OTC_SPAN_OPS(span)->set_baggage_item(span, key, value);
+}
+
+static inline const char *otc_span_baggage_item(const struct otc_span *span, const char *key)
+{
+	return OTC_SPAN_OPS(span)->baggage_item(span, key);
+}
+
+static inline struct otc_tracer *otc_span_tracer(const struct otc_span *span)
+{
+	return OTC_SPAN_OPS(span)->tracer(span);
+}
+
+static inline void otc_span_destroy(struct otc_span **span)
+{
+	OTC_SPAN_OPS(*span)->destroy(span);
+}
+
+static inline void otc_span_set_tags(struct otc_span *span, const struct otc_tag *tags, int num_tags)
+{
+	OTC_SPAN_OPS(span)->set_tags(span, tags, num_tags);
+}
+
+static inline void otc_span_set_tags_log_finish(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields)
+{
+	OTC_SPAN_OPS(span)->set_tags_log_finish(span, tags, num_tags, fields, num_fields);
+}
+
+static inline void otc_span_set_tag_atom(struct otc_span *span, otc_atom_t key, const struct otc_value *value)
+{
+	OTC_SPAN_OPS(span)->set_tag_atom(span, key, value);
+}
+
+static inline void otc_span_log_fields_atom(struct otc_span *span, const struct otc_log_field_atom *fields, int num_fields)
+{
+	OTC_SPAN_OPS(span)->log_fields_atom(span, fields, num_fields);
+}
+
 /***
  * interface for span context
  */
@@ -259,6 +491,11 @@ struct otc_span_context {
 	 */
 	void (*destroy)(struct otc_span_context **context)
 		OTC_NONNULL_ALL;
+
+	/***
+	 * span context object used internally by the library, must not be changed
+	 */
+	void *handle;
 };
 
 __CPLUSPLUS_DECL_END
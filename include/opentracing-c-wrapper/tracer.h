@@ -18,11 +18,6 @@
 
 __CPLUSPLUS_DECL_BEGIN
 
-struct otc_tag {
-	const char       *key;
-	struct otc_value  value;
-};
-
 struct otc_start_span_options {
 	struct otc_duration              start_time_steady;
 	struct otc_timestamp             start_time_system;
@@ -32,6 +27,43 @@ struct otc_start_span_options {
 	int                              num_tags;
 };
 
+/***
+ * the sampler of the wrapper, which decides whether a new span is passed
+ * to the tracer at all (it requires the header format to be set with
+ * otc_tracer_propagation_format() first)
+ */
+typedef enum {
+	otc_sampler_none = 0,      /* all spans are passed to the tracer */
+	otc_sampler_probabilistic, /* spans are sampled with the given probability */
+	otc_sampler_rate_limiting, /* at most the given number of spans per second for each operation name */
+} otc_sampler_type_t;
+
+/***
+ * what happens with a span that is finished asynchronously when the finish
+ * queue is full
+ */
+typedef enum {
+	otc_finish_policy_block = 0, /* wait until there is room in the queue */
+	otc_finish_policy_drop,      /* delete the span without calling its finish function */
+} otc_finish_policy_t;
+
+/***
+ * the source of the start, finish and log timestamps that are not set by
+ * the application
+ */
+typedef enum {
+	otc_clock_tracer = 0, /* the tracer reads the clocks itself */
+	otc_clock_coarse,     /* the wrapper reads CLOCK_MONOTONIC_COARSE and CLOCK_REALTIME_COARSE */
+	otc_clock_callback,   /* the wrapper takes the time from the application callback */
+} otc_clock_source_t;
+
+/***
+ * the clock callback, which sets the steady (CLOCK_MONOTONIC based) and the
+ * system (CLOCK_REALTIME based) time; a pointer is NULL if that time is not
+ * needed
+ */
+typedef void (*otc_clock_cb_t)(struct timespec *steady, struct timespec *system);
+
 /***
  * tracer interface
  */
@@ -71,6 +103,9 @@ struct otc_tracer {
 
 	void (*destroy)(struct otc_tracer **tracer)
 		OTC_NONNULL_ALL;
+
+	struct otc_span *(*start_span_atom)(struct otc_tracer *tracer, otc_atom_t operation_name, const struct otc_start_span_options *options)
+		OTC_NONNULL(1);
 };
 
 
@@ -79,6 +114,10 @@ struct otc_tracer *otc_tracer_load(const char *library, char *errbuf, int errbuf
 int                otc_tracer_start(const char *cfgfile, const char *cfgbuf, char *errbuf, int errbufsiz);
 void               otc_tracer_global(struct otc_tracer *tracer);
 void               otc_tracer_init_global(struct otc_tracer *tracer);
+int                otc_tracer_propagation_format(otc_propagation_format_t format);
+int                otc_tracer_sampler(otc_sampler_type_t type, double param, bool parent_based);
+int                otc_tracer_finish_async(int queue_size, otc_finish_policy_t policy);
+int                otc_tracer_clock(otc_clock_source_t source, otc_clock_cb_t callback);
 
 __CPLUSPLUS_DECL_END
 #endif /* OPENTRACING_C_WRAPPER_TRACER_H */
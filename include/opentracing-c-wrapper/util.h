@@ -31,12 +31,41 @@ struct otc_text_map {
 	size_t   count;
 	size_t   size;
 	bool     is_dynamic;
+	bool     is_arena;   /* The key/value arrays and the data are in one block. */
+	uint32_t magic;      /* Set by the library if it allocated the arrays or the arena. */
 };
 
 struct otc_binary_data {
-	void   *data;
-	size_t  size;
-	bool    is_dynamic;
+	void     *data;
+	size_t    size;
+	bool      is_dynamic;
+	uint32_t  magic;     /* Set by the library if it allocated the data buffer. */
+	size_t    capacity;  /* The size of the data buffer, valid only if the magic is set. */
+};
+
+/*
+ * The number of bytes currently held by the library, by purpose, as filled
+ * in by otc_statistics_memory().  The bytes are counted by purpose only, not
+ * by the function or the call site that allocated them.  Not included are:
+ *   - the memory of the tracer itself (the span objects and their data),
+ *   - the keys and values that otc_text_map_add() duplicates outside of a
+ *     text map arena (including those of the text map filled by an inject
+ *     function), because the application may release them itself with
+ *     free(), and because the text map may also release strings that it
+ *     did not duplicate,
+ *   - the baggage items returned to the application, which releases them
+ *     itself (otc_statistics() shows the number of bytes returned so far),
+ *   - the memory of the finisher queue and of the data of the spans queued
+ *     to be finished in the background.
+ * The keys and values copied to a text map arena are included in its
+ * arena.
+ */
+struct otc_memory_usage {
+	int64_t handle;       /* The buckets and nodes of the handle tables. */
+	int64_t span;         /* The span structures, including the pooled ones and the no-op spans of a known trace. */
+	int64_t span_context; /* The span context structures, including the pooled ones and the no-op ones of a known trace. */
+	int64_t text_map;     /* The text maps and their arrays or arenas. */
+	int64_t binary_data;  /* The binary data and their data buffers. */
 };
 
 /*
@@ -87,15 +116,20 @@ typedef void  (*otc_ext_free_t)(void *);
 void                    otc_ext_init(otc_ext_malloc_t func_malloc, otc_ext_free_t func_free);
 
 struct otc_text_map    *otc_text_map_new(struct otc_text_map *text_map, size_t size);
+struct otc_text_map    *otc_text_map_arena_new(struct otc_text_map *text_map, size_t size, size_t data_size);
+struct otc_text_map    *otc_text_map_arena_init(struct otc_text_map *text_map, size_t size, void *buffer, size_t bufsiz);
 int                     otc_text_map_add(struct otc_text_map *text_map, const char *key, size_t key_len, const char *value, size_t value_len, otc_text_map_flags_t flags);
+void                    otc_text_map_clear(struct otc_text_map *text_map, otc_text_map_flags_t flags);
 void                    otc_text_map_destroy(struct otc_text_map **text_map, otc_text_map_flags_t flags);
 
 struct otc_binary_data *otc_binary_data_new(struct otc_binary_data *binary_data, const void *data, size_t size);
+void                    otc_binary_data_clear(struct otc_binary_data *binary_data);
 void                    otc_binary_data_destroy(struct otc_binary_data **binary_data);
 
 char                   *otc_file_read(const char *filename, const char *comment, char *errbuf, int errbufsiz);
 
 void                    otc_statistics(char *buffer, size_t bufsiz);
+void                    otc_statistics_memory(struct otc_memory_usage *usage);
 
 __CPLUSPLUS_DECL_END
 #endif /* OPENTRACING_C_WRAPPER_UTIL_H */
@@ -30,6 +30,18 @@ typedef enum {
 	otc_value_null,
 } otc_value_type_t;
 
+/***
+ * value type flag: the string value remains valid and unchanged as long as
+ * the tracer exists (for example a string literal or a configuration
+ * string), so the library does not have to copy it
+ */
+#define OTC_VALUE_PERSISTENT   0x100
+
+/***
+ * value type without the flags
+ */
+#define OTC_VALUE_TYPE(a)      ((a)->type & ~OTC_VALUE_PERSISTENT)
+
 
 /***
  * union for representing various value types
@@ -47,6 +59,16 @@ struct otc_value {
 	} value;
 };
 
+/***
+ * an interned string (an operation name or a tag key), see otc_intern();
+ * negative values are not valid atoms
+ */
+typedef int32_t otc_atom_t;
+
+
+otc_atom_t  otc_intern(const char *str);
+const char *otc_atom_str(otc_atom_t atom);
+
 __CPLUSPLUS_DECL_END
 #endif /* OPENTRACING_C_WRAPPER_VALUE_H */
 
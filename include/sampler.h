@@ -0,0 +1,43 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _OPENTRACING_C_WRAPPER_SAMPLER_H_
+#define _OPENTRACING_C_WRAPPER_SAMPLER_H_
+
+/***
+ * The rate limiting state of the operation names that fall into the same
+ * bucket: the time (in nanoseconds of the steady clock) at which the next
+ * span is due.  Each bucket has its own cache line.
+ */
+struct alignas(OT_CACHE_LINE_SIZE) otc_sampler_bucket {
+	std::atomic<int64_t> due_ns;
+};
+
+
+uint64_t ot_sampler_rand(void);
+bool     ot_sampler_is_sampled(opentracing::string_view operation_name, uint64_t hash, const struct otc_start_span_options *options);
+bool     ot_sampler_is_sampled_parent(const struct otc_trace_context *context);
+bool     ot_sampler_is_set(void);
+
+#endif /* _OPENTRACING_C_WRAPPER_SAMPLER_H_ */
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
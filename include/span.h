@@ -16,9 +16,6 @@
 #ifndef _OPENTRACING_C_WRAPPER_SPAN_H_
 #define _OPENTRACING_C_WRAPPER_SPAN_H_
 
-#define OT_LF(a)   { fields[a].key, str_value[a] }
-
-
 class otc_hash {
 	public:
 	size_t operator() (int64_t key) const noexcept(true) { return key; }
@@ -31,56 +28,477 @@ class otc_equal_to {
 };
 
 
+/***
+ * The allocator of the handle tables, which counts the bytes allocated for
+ * the buckets and nodes of the table.  A table is changed only by one thread
+ * at a time (the owner of the table or the holder of its lock), so there is
+ * no need for atomic read-modify-write operations.  The counter must outlive
+ * the table.
+ */
+template<typename T> class otc_mem_allocator {
+	public:
+	typedef T value_type;
+
+	explicit otc_mem_allocator(std::atomic<int64_t> *counter) noexcept : cnt(counter) {}
+	template<typename U> otc_mem_allocator(const otc_mem_allocator<U> &alloc) noexcept : cnt(alloc.cnt) {}
+
+	T *allocate(size_t n)
+	{
+		T *retptr = std::allocator<T>().allocate(n);
+
+		add(n * sizeof(T));
+
+		return retptr;
+	}
+
+	void deallocate(T *ptr, size_t n) noexcept
+	{
+		std::allocator<T>().deallocate(ptr, n);
+
+		add(-OT_CAST_STAT(int64_t, n * sizeof(T)));
+	}
+
+	template<typename U> bool operator==(const otc_mem_allocator<U> &alloc) const noexcept { return cnt == alloc.cnt; }
+	template<typename U> bool operator!=(const otc_mem_allocator<U> &alloc) const noexcept { return cnt != alloc.cnt; }
+
+	std::atomic<int64_t> *cnt;
+
+	private:
+	void add(int64_t n) { cnt->store(cnt->load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+};
+
+template<typename T> using otc_handle_alloc = otc_mem_allocator<std::pair<const int64_t, std::unique_ptr<T>>>;
+template<typename T> using otc_handle_map   = std::unordered_map<int64_t, std::unique_ptr<T>, otc_hash, otc_equal_to, otc_handle_alloc<T>>;
+
+
 #  ifdef OT_THREADS_NO_LOCKING
-template<typename T>
-	using Handle = std::unordered_map<
-		int64_t,
-		std::unique_ptr<T>,
-		otc_hash,
-		otc_equal_to
-	>;
-struct HandleData {
-	int64_t key;
-	int64_t alloc_fail_cnt;
-	int64_t erase_cnt;
-	int64_t destroy_cnt;
+template<typename T> struct HandleData;
+
+/***
+ * The handle table of one thread.  Every thread allocates the indices of
+ * its spans and span contexts by itself: the lower OT_KEY_THREAD_BITS bits
+ * of the index hold the table number and the upper bits the sequence
+ * number.  This way the table that owns the index is known, so access to
+ * the table of another thread can be detected and refused.  The table
+ * numbers of the finished threads are reused; if there are more threads
+ * than table numbers, the cross-thread access detection is not reliable.
+ */
+template<typename T> class alignas(OT_CACHE_LINE_SIZE) HandleLocal {
+	public:
+	HandleLocal(struct HandleData<T> &handle_data) : mem_cnt(0), handle(0, otc_hash(), otc_equal_to(), otc_handle_alloc<T>(&mem_cnt)), data(handle_data), key(0), size_cnt(0)
+	{
+		const std::lock_guard<std::mutex> guard(data.mutex);
+
+		/*
+		 * A reused table number continues the sequence of the
+		 * previous table, so that the stale indices of a finished
+		 * thread never refer to the new objects.
+		 */
+		if (data.free_id.empty()) {
+			id = data.id++ & OT_KEY_THREAD_MASK;
+		} else {
+			id = data.free_id.back().first;
+			key.store(data.free_id.back().second);
+			data.free_id.pop_back();
+		}
+
+		key_base = key.load();
+		data.list.push_back(this);
+	}
+
+	~HandleLocal()
+	{
+		const std::lock_guard<std::mutex> guard(data.mutex);
+
+		data.retired_key += keys();
+		data.free_id.push_back(std::make_pair(id, key.load()));
+		data.list.erase(std::find(data.list.begin(), data.list.end(), this));
+	}
+
+	int64_t key_new(void)
+	{
+		int64_t retval = key.load(std::memory_order_relaxed);
+
+		key.store(retval + 1, std::memory_order_relaxed);
+
+		return (retval << OT_KEY_THREAD_BITS) | id;
+	}
+
+	bool is_valid(int64_t idx)
+	{
+		if (idx < 0)
+			return false;
+		else if ((idx & OT_KEY_THREAD_MASK) == id)
+			return (idx >> OT_KEY_THREAD_BITS) < key.load(std::memory_order_relaxed);
+
+		OT_STAT_INC(CROSS_THREAD);
+
+		return false;
+	}
+
+	std::unique_ptr<T> &at(int64_t idx) { return handle.at(idx); }
+
+	void emplace(int64_t idx, std::unique_ptr<T> &&ptr)
+	{
+		handle.emplace(idx, std::move(ptr));
+		size_cnt.store(handle.size(), std::memory_order_relaxed);
+	}
+
+	void erase(int64_t idx)
+	{
+		handle.erase(idx);
+		size_cnt.store(handle.size(), std::memory_order_relaxed);
+	}
+
+	size_t size(void) const { return size_cnt.load(std::memory_order_relaxed); }
+
+	int64_t keys(void) const { return key.load(std::memory_order_relaxed) - key_base; }
+
+	int64_t mem(void) const { return mem_cnt.load(std::memory_order_relaxed); }
+
+	private:
+	std::atomic<int64_t>  mem_cnt;
+	otc_handle_map<T>     handle;
+	struct HandleData<T> &data;
+	int64_t               id;
+	int64_t               key_base;
+	std::atomic<int64_t>  key;
+	std::atomic<size_t>   size_cnt;
+};
+
+template<typename T> struct HandleData {
+	std::mutex                               mutex;
+	std::vector<HandleLocal<T> *>            list;
+	std::vector<std::pair<int64_t, int64_t>> free_id;
+	int64_t                                  id;
+	int64_t                                  retired_key;
+
+	/* Number of indices allocated by all threads so far. */
+	int64_t keys(void)
+	{
+		const std::lock_guard<std::mutex> guard(mutex);
+		int64_t                           retval = retired_key;
+
+		for (auto it : list)
+			retval += it->keys();
+
+		return retval;
+	}
+
+	/* Number of entries in the handle tables of all threads. */
+	size_t size(void)
+	{
+		const std::lock_guard<std::mutex> guard(mutex);
+		size_t                            retval = 0;
+
+		for (auto it : list)
+			retval += it->size();
+
+		return retval;
+	}
+
+	/* Number of bytes allocated for the handle tables of all threads. */
+	int64_t mem(void)
+	{
+		const std::lock_guard<std::mutex> guard(mutex);
+		int64_t                           retval = 0;
+
+		for (auto it : list)
+			retval += it->mem();
+
+		return retval;
+	}
 };
 
-#     define OT_LOCK_GUARD(a,...)
-#     define OT_LOCK(a,b)
+#     define OT_KEY_NEW(a)              ot_##a##_handle(0).key_new()
+#     define OT_KEY_IS_VALID(a,i)       ot_##a##_handle(0).is_valid(i)
+#     define ot_span_handle(i)          ot_span_handle_tl
+#     define ot_span_context_handle(i)  ot_span_context_handle_tl
+#     define OT_LOCK_GUARD(a,i)
 
-extern thread_local Handle<opentracing::Span>        ot_span_handle;
-extern thread_local Handle<opentracing::SpanContext> ot_span_context_handle;
-extern struct HandleData                             ot_span;
-extern struct HandleData                             ot_span_context;
+extern thread_local HandleLocal<opentracing::Span>        ot_span_handle_tl;
+extern thread_local HandleLocal<opentracing::SpanContext> ot_span_context_handle_tl;
+extern struct HandleData<opentracing::Span>               ot_span;
+extern struct HandleData<opentracing::SpanContext>        ot_span_context;
 #  else
+/***
+ * One shard of the handle table.  Every shard has its own lock and is
+ * aligned to the cache line size, so that threads working on handles in
+ * different shards do not interfere with each other.
+ */
+template<typename T> struct alignas(OT_CACHE_LINE_SIZE) HandleShard {
+	std::atomic<int64_t> mem_cnt;
+	otc_handle_map<T>    handle;
+	std::mutex           mutex;
+
+	HandleShard() : mem_cnt(0), handle(8192 / OT_HANDLE_SHARDS + 1, otc_hash(), otc_equal_to(), otc_handle_alloc<T>(&mem_cnt)) {}
+};
+
+/***
+ * The index allocator is placed in its own cache line, apart from the
+ * shards.
+ */
 template<typename T> struct Handle {
-	std::unordered_map<
-		int64_t,
-		std::unique_ptr<T>,
-		otc_hash,
-		otc_equal_to
-	>          handle;
-	int64_t    key;
-	int64_t    alloc_fail_cnt;
-	int64_t    erase_cnt;
-	int64_t    destroy_cnt;
-	std::mutex mutex;
+	struct HandleShard<T>                            shard[OT_HANDLE_SHARDS];
+	alignas(OT_CACHE_LINE_SIZE) std::atomic<int64_t> key;
+
+	Handle();
+
+	int64_t keys(void) const { return key.load(); }
+
+	/* Number of bytes allocated for the handle tables. */
+	int64_t mem(void) const
+	{
+		int64_t retval = 0;
+
+		for (int i = 0; i < OT_HANDLE_SHARDS; i++)
+			retval += shard[i].mem_cnt.load(std::memory_order_relaxed);
+
+		return retval;
+	}
 };
 
-#     define ot_span_handle           ot_span.handle
-#     define ot_span_context_handle   ot_span_context.handle
-#     define OT_LOCK_GUARD(a,...)     const std::lock_guard<std::mutex> guard_##a(ot_##a.mutex, ##__VA_ARGS__)
-#     define OT_LOCK(a,b)             std::lock(ot_##a.mutex, ot_##b.mutex); OT_LOCK_GUARD(a, std::adopt_lock); OT_LOCK_GUARD(b, std::adopt_lock);
+#     define OT_KEY_NEW(a)              ot_##a.key++
+#     define OT_KEY_IS_VALID(a,i)       OT_IN_RANGE((i), 0, ot_##a.key - 1)
+#     define OT_SHARD(a,i)              ot_##a.shard[OT_CAST_STAT(uint64_t, (i)) % OT_HANDLE_SHARDS]
+#     define ot_span_handle(i)          OT_SHARD(span, (i)).handle
+#     define ot_span_context_handle(i)  OT_SHARD(span_context, (i)).handle
+#     define OT_LOCK_GUARD(a,i)         const otc_lock_guard guard_##a(OT_SHARD(a, (i)).mutex)
 
 extern struct Handle<opentracing::Span>        ot_span;
 extern struct Handle<opentracing::SpanContext> ot_span_context;
 #  endif /* OT_THREADS_NO_LOCKING */
 
+/***
+ * In the direct span mode the otc_span structure points to its span
+ * object, so there is no handle table lookup and no locking required.
+ * Otherwise the span object is found in the span handle table.
+ */
+#  define OT_SPAN_OBJ(s)                (*OT_SPAN_PTR(s))
+#  ifdef OT_DIRECT_SPANS
+#     define OT_SPAN_PTR(s)             OT_CAST_STAT(opentracing::Span *, (s)->handle)
+#     define OT_SPAN_LOCK_GUARD(s)
+#     define OT_CTX_PTR(c)              OT_CAST_STAT(opentracing::SpanContext *, (c)->handle)
+#     define OT_CTX_LOCK_GUARD(c)
+#  else
+#     define OT_SPAN_PTR(s)             ot_span_handle((s)->idx).at((s)->idx)
+#     define OT_SPAN_LOCK_GUARD(s)      OT_LOCK_GUARD(span, (s)->idx)
+#     define OT_CTX_PTR(c)              ot_span_context_handle((c)->idx).at((c)->idx).get()
+#     define OT_CTX_LOCK_GUARD(c)       OT_LOCK_GUARD(span_context, (c)->idx)
+#  endif
+
+
+/***
+ * Acquires the mutex, and if it is already locked, counts the time spent
+ * waiting for it.  The clock is read only if the lock is contended.
+ */
+static inline void ot_mutex_lock(std::mutex &mutex)
+{
+	if (mutex.try_lock())
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	mutex.lock();
+
+	OT_STAT_INC(LOCK_WAIT);
+	OT_STAT_ADD(LOCK_WAIT_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+
+/***
+ * A scoped handle table lock, with the lock wait time accounting.
+ */
+class otc_lock_guard {
+	public:
+	explicit otc_lock_guard(std::mutex &lock_mutex) : mutex(lock_mutex) { ot_mutex_lock(mutex); }
+	~otc_lock_guard() { mutex.unlock(); }
+
+	otc_lock_guard(const otc_lock_guard &) = delete;
+	otc_lock_guard &operator=(const otc_lock_guard &) = delete;
+
+	private:
+	std::mutex &mutex;
+};
+
+
+/***
+ * A set of handle table locks that are acquired together.  The locks are
+ * always taken in the order of their addresses so that two threads that
+ * need the same shards cannot deadlock.
+ */
+class otc_lock_set {
+	public:
+	otc_lock_set() : locked(false) {}
+	~otc_lock_set() { unlock(); }
+
+	void add(std::mutex &mutex) { mutexes.push_back(&mutex); }
+
+	void lock(void)
+	{
+		std::sort(mutexes.begin(), mutexes.end());
+		mutexes.erase(std::unique(mutexes.begin(), mutexes.end()), mutexes.end());
+
+		for (auto mutex : mutexes)
+			ot_mutex_lock(*mutex);
+
+		locked = true;
+	}
+
+	void unlock(void)
+	{
+		if (locked)
+			for (auto mutex : mutexes)
+				mutex->unlock();
+
+		mutexes.clear();
+		locked = false;
+	}
+
+	private:
+	std::vector<std::mutex *> mutexes;
+	bool                      locked;
+};
+
+
+/***
+ * A per-thread list of free span or span context structures.  Structures
+ * released by the thread are kept in the list (at most OT_POOL_SIZE of
+ * them) and reused by the next allocation, instead of being returned to
+ * the allocator set with otc_ext_init().  The remaining structures are
+ * released when the thread exits.  The bytes held by the structures, both
+ * in use and in the list, are counted in the 'mem_cnt' counter.
+ */
+class otc_pool {
+	public:
+	otc_pool(size_t size, ot_stat_t hit_cnt, ot_stat_t miss_cnt, ot_stat_t mem_cnt) : head(nullptr), count(0), elem_size(size), hit(hit_cnt), miss(miss_cnt), mem(mem_cnt)
+	{
+		/*
+		 * The statistics counters of the thread are created before
+		 * the pool, so that they are destroyed after it.
+		 */
+		ot_stats_tl.add(mem, 0);
+	}
+
+	~otc_pool()
+	{
+		while (head != nullptr) {
+			struct otc_pool_entry *entry = head;
+
+			head = entry->next;
+			OT_EXT_FREE_CLEAR(entry);
+			ot_stats_tl.add(mem, -OT_CAST_STAT(int64_t, elem_size));
+		}
+	}
+
+	void *alloc(void)
+	{
+		struct otc_pool_entry *retptr = head;
+
+		if (retptr != nullptr) {
+			head = retptr->next;
+			count--;
+
+			ot_stats_tl.add(hit, 1);
+		} else {
+			ot_stats_tl.add(miss, 1);
+
+			if ((retptr = OT_CAST_TYPEOF(retptr, OT_EXT_MALLOC(elem_size))) != nullptr)
+				ot_stats_tl.add(mem, elem_size);
+		}
+
+		return retptr;
+	}
+
+	template<typename T> void release(T **ptr)
+	{
+		if (count < OT_POOL_SIZE) {
+			struct otc_pool_entry *entry = OT_CAST_TYPEOF(entry, *ptr);
+
+			entry->next = head;
+			head        = entry;
+			*ptr        = nullptr;
+			count++;
+		} else {
+			OT_EXT_FREE_CLEAR(*ptr);
+			ot_stats_tl.add(mem, -OT_CAST_STAT(int64_t, elem_size));
+		}
+	}
+
+	private:
+	struct otc_pool_entry {
+		struct otc_pool_entry *next;
+	};
+
+	struct otc_pool_entry *head;
+	int                    count;
+	size_t                 elem_size;
+	ot_stat_t              hit;
+	ot_stat_t              miss;
+	ot_stat_t              mem;
+};
+
+
+/***
+ * One entry of the tag buffer of a span (or of the data of a span finished
+ * in the background): a tag, the header of a log record or one of the
+ * fields of the log record whose header precedes it.
+ */
+struct otc_span_tag_entry {
+	const char       *key;   /* NULL for the header of a log record. */
+	struct otc_value  value; /* The timestamp (ns, 0 if not set) of the log record header. */
+	int               count; /* The number of fields of the log record. */
+};
+
+
+#if OT_TAG_BUFFER > 0
+/***
+ * The span structure with the buffer of the tags and log fields that are
+ * set before the span is finished.  The strings that are not persistent
+ * are copied to the data area of the buffer.
+ */
+struct otc_span_buffered {
+	struct otc_span           span;
+	int                       num_entries;
+	size_t                    data_used;
+	struct otc_span_tag_entry entry[OT_TAG_BUFFER];
+	char                      data[OT_TAG_BUFFER_DATA];
+};
+
+#  define OT_SPAN_BUFFERED(s)           OT_CAST_REINTERPRET(struct otc_span_buffered *, (s))
+#endif
+
+
+/***
+ * The no-op span and span context of a sampled-out trace whose trace
+ * context is known, which keep the trace context so that the trace id is
+ * injected further.  The tracestate string is copied right after the
+ * structure.
+ */
+struct otc_span_trace {
+	struct otc_span          span;
+	struct otc_trace_context trace;
+};
+
+struct otc_span_context_trace {
+	struct otc_span_context  context;
+	struct otc_trace_context trace;
+};
+
+#define OT_SPAN_TRACE(s)                OT_CAST_REINTERPRET(struct otc_span_trace *, (s))
+#define OT_SPAN_CONTEXT_TRACE(c)        OT_CAST_REINTERPRET(struct otc_span_context_trace *, (c))
+
+
+extern struct otc_span         ot_span_noop;
+extern struct otc_span_context ot_span_context_noop;
 
 struct otc_span         *ot_span_new(void);
 void                             ot_nolock_span_destroy(struct otc_span **span);
+void                             ot_span_tag_entries_apply(opentracing::Span &span_obj, const struct otc_span_tag_entry *entry, int num_entries, struct opentracing::FinishSpanOptions *span_options);
 struct otc_span_context *ot_span_context_new(const struct otc_span *span);
+struct otc_span_context         *ot_span_context_trace_new(const struct otc_trace_context *trace);
+const struct otc_trace_context  *ot_span_context_trace(const struct otc_span_context *context);
+struct otc_span                 *ot_span_trace_new(const struct otc_start_span_options *options);
 
 #endif /* _OPENTRACING_C_WRAPPER_SPAN_H_ */
 
@@ -16,47 +16,61 @@
 #ifndef _OPENTRACING_C_WRAPPER_TRACER_H_
 #define _OPENTRACING_C_WRAPPER_TRACER_H_
 
-using TextMap = std::unordered_map<std::string, std::string>;
+/***
+ * The key/value pairs read from the foreach_key() callback of an extract
+ * reader.  The keys and values are copied to the data, each terminated with
+ * the null character, because the callback arguments are valid only during
+ * the call; the entries hold their offsets.
+ */
+struct otc_carrier_cache {
+	std::string                            data;
+	std::vector<std::pair<size_t, size_t>> entry;
+};
 
 
-class TextMapCarrier : public opentracing::TextMapReader, public opentracing::TextMapWriter {
+/***
+ * The extract carrier that reads the data directly from the reader of the
+ * caller, without copying it to a map first.  If the reader has the
+ * foreach_key() callback, it is called only once, on the first use of the
+ * carrier, and the pairs are kept in the cache, which is then read by the
+ * wrapper's decoder, ForeachKey() and each LookupKey().  Otherwise the text
+ * map of the reader is read.  If nocase is set, the letter case of the keys
+ * is ignored.  The error returned by the reader is kept.
+ */
+template<typename R, typename C, bool nocase> class CarrierReader : public R {
 	public:
-	TextMapCarrier(TextMap &text_map) : tm_data(text_map) {}
+	CarrierReader(const C *reader, struct otc_carrier_cache &cache) : rd_data(reader), rd_cache(cache), rd_is_loaded(false), rd_rc(otc_propagation_error_code_success) {}
 
 	/***
-	 * TextMapWriter: Set a key:value pair to the carrier.  Multiple calls
-	 * to Set() for the same key leads to undefined behavior.
-	 */
-	opentracing::expected<void> Set(opentracing::string_view key, opentracing::string_view value) const override
-	{
-		tm_data[key] = value;
-
-		return {};
-	}
-
-	/***
-	 * TextMapReader: LookupKey() returns the value for the specified
-	 * key if available.  If no such key is present, it returns
-	 * key_not_found_error.
+	 * LookupKey() returns the value for the specified key if available.
+	 * If no such key is present, it returns key_not_found_error.
 	 */
 	opentracing::expected<opentracing::string_view> LookupKey(opentracing::string_view key) const override
 	{
-		auto iter = tm_data.find(key);
-		if (iter != tm_data.end())
-			return opentracing::string_view{iter->second};
+		(void)load();
+
+		for (size_t i = 0; i < count(); i++)
+			if ((value_at(i) != nullptr) && key_equal(key_at(i), key))
+				return opentracing::string_view{value_at(i)};
 
 		return opentracing::make_unexpected(opentracing::key_not_found_error);
 	}
 
 	/***
-	 * TextMapReader: ForeachKey() returns TextMap contents via repeated
-	 * calls to the f() function.  If any call to f() returns an error,
-	 * ForeachKey() terminates and returns that error.
+	 * ForeachKey() returns the reader contents via repeated calls to the
+	 * f() function.  If any call to f() returns an error, ForeachKey()
+	 * terminates and returns that error.
 	 */
 	opentracing::expected<void> ForeachKey(std::function<opentracing::expected<void>(opentracing::string_view key, opentracing::string_view value)> f) const override
 	{
-		for (const auto &text_map : tm_data) {
-			auto result = f(text_map.first, text_map.second);
+		if (load() != otc_propagation_error_code_success)
+			return opentracing::make_unexpected(opentracing::invalid_carrier_error);
+
+		for (size_t i = 0; i < count(); i++) {
+			if ((key_at(i) == nullptr) || (value_at(i) == nullptr))
+				continue;
+
+			auto result = f(key_at(i), value_at(i));
 			if (!result)
 				return result;
 		}
@@ -64,62 +78,263 @@ class TextMapCarrier : public opentracing::TextMapReader, public opentracing::Te
 		return {};
 	}
 
+	/***
+	 * load() calls the foreach_key() callback of the reader, if it has one
+	 * and it has not been called yet, and copies the pairs to the cache.
+	 */
+	otc_propagation_error_code_t load(void) const
+	{
+		if (rd_is_loaded || (rd_data->foreach_key == nullptr))
+			return rd_rc;
+
+		rd_cache.data.clear();
+		rd_cache.entry.clear();
+
+		rd_rc        = rd_data->foreach_key(OT_CAST_CONST(C *, rd_data), load_cb, &rd_cache);
+		rd_is_loaded = true;
+
+		return rd_rc;
+	}
+
+	/* The number of pairs, and the key and the value of each of them. */
+	size_t count(void) const
+	{
+		if (rd_data->foreach_key != nullptr)
+			return rd_cache.entry.size();
+		else if ((rd_data->text_map.key == nullptr) || (rd_data->text_map.value == nullptr))
+			return 0;
+
+		return rd_data->text_map.count;
+	}
+
+	const char *key_at(size_t idx) const
+	{
+		return (rd_data->foreach_key != nullptr) ? (rd_cache.data.c_str() + rd_cache.entry[idx].first) : rd_data->text_map.key[idx];
+	}
+
+	const char *value_at(size_t idx) const
+	{
+		return (rd_data->foreach_key != nullptr) ? (rd_cache.data.c_str() + rd_cache.entry[idx].second) : rd_data->text_map.value[idx];
+	}
+
+	otc_propagation_error_code_t rc(void) const { return rd_rc; }
+
 	private:
-	TextMap &tm_data;
+	static bool key_equal(const char *key, opentracing::string_view key_sv)
+	{
+		if (key == nullptr)
+			return false;
+		else if (nocase)
+			return (strncasecmp(key, key_sv.data(), key_sv.size()) == 0) && (key[key_sv.size()] == '\0');
+
+		return (strncmp(key, key_sv.data(), key_sv.size()) == 0) && (key[key_sv.size()] == '\0');
+	}
+
+	/* Stops the iteration by returning an error if a pair is not valid. */
+	static otc_propagation_error_code_t load_cb(void *arg, const char *key, const char *value)
+	{
+		struct otc_carrier_cache *cache = OT_CAST_REINTERPRET(struct otc_carrier_cache *, arg);
+
+		if ((key == nullptr) || (value == nullptr))
+			return otc_propagation_error_code_unknown;
+
+		cache->entry.emplace_back(cache->data.size(), cache->data.size() + strlen(key) + 1);
+		cache->data.append(key).push_back('\0');
+		cache->data.append(value).push_back('\0');
+
+		return otc_propagation_error_code_success;
+	}
+
+	const C                              *rd_data;
+	struct otc_carrier_cache             &rd_cache;
+	mutable bool                          rd_is_loaded;
+	mutable otc_propagation_error_code_t  rd_rc;
 };
 
+using TextMapCarrierReader     = CarrierReader<opentracing::TextMapReader, struct otc_text_map_reader, false>;
+using HTTPHeadersCarrierReader = CarrierReader<opentracing::HTTPHeadersReader, struct otc_http_headers_reader, true>;
 
-class HTTPHeadersCarrier : public opentracing::HTTPHeadersReader, public opentracing::HTTPHeadersWriter {
+
+/***
+ * The inject carrier that passes the data set by the tracer directly to
+ * the writer of the caller, without an intermediate map.  If the writer
+ * has the set() callback, the key and value are copied to the buffer (to
+ * be terminated with the null character) and passed to that callback;
+ * otherwise they are added to the text map of the writer.  The number of
+ * entries written and the error returned by the writer are kept.
+ */
+template<typename W, typename C> class CarrierWriter : public W {
 	public:
-	HTTPHeadersCarrier(TextMap &text_map) : tm_data(text_map) {}
+	CarrierWriter(C *writer, std::string &buffer) : wr_data(writer), wr_buffer(buffer), wr_count(0), wr_rc(otc_propagation_error_code_success) {}
 
-	/***
-	 * HTTPHeadersWriter: Set a key:value pair to the carrier.  Multiple calls
-	 * to Set() for the same key leads to undefined behavior.
-	 */
 	opentracing::expected<void> Set(opentracing::string_view key, opentracing::string_view value) const override
 	{
-		tm_data[key] = value;
+		if (wr_data->set != nullptr) {
+			wr_buffer.assign(key.data(), key.size()).push_back('\0');
+			wr_buffer.append(value.data(), value.size());
+
+			wr_rc = wr_data->set(wr_data, wr_buffer.c_str(), wr_buffer.c_str() + key.size() + 1);
+		}
+		else if (otc_text_map_add(&(wr_data->text_map), key.empty() ? "" : key.data(), key.size(), value.empty() ? "" : value.data(), value.size(), OT_CAST_STAT(otc_text_map_flags_t, OTC_TEXT_MAP_DUP_KEY | OTC_TEXT_MAP_DUP_VALUE)) == -1) {
+			wr_rc = otc_propagation_error_code_unknown;
+		}
+
+		if (wr_rc != otc_propagation_error_code_success)
+			return opentracing::make_unexpected(opentracing::invalid_carrier_error);
+
+		wr_count++;
 
 		return {};
 	}
 
-	/***
-	 * HTTPHeadersReader: LookupKey() returns the value for the specified
-	 * key if available.  If no such key is present, it returns
-	 * key_not_found_error.
-	 */
-	opentracing::expected<opentracing::string_view> LookupKey(opentracing::string_view key) const override
+	size_t count(void) const { return wr_count; }
+	otc_propagation_error_code_t rc(void) const { return wr_rc; }
+
+	private:
+	C                                    *wr_data;
+	std::string                          &wr_buffer;
+	mutable size_t                        wr_count;
+	mutable otc_propagation_error_code_t  wr_rc;
+};
+
+using TextMapCarrierWriter     = CarrierWriter<opentracing::TextMapWriter, struct otc_text_map_writer>;
+using HTTPHeadersCarrierWriter = CarrierWriter<opentracing::HTTPHeadersWriter, struct otc_http_headers_writer>;
+
+
+/***
+ * The stream buffer used to inject the span context in the binary format.
+ * The data is written directly to the data buffer of the carrier, which is
+ * enlarged when needed.  The buffer is reused only if it was allocated by
+ * the library (by otc_binary_data_new() or the previous inject), otherwise
+ * the carrier is initialized as a new one.  The buffer is handed over to
+ * the carrier with commit().  In case of an error, abort() releases the
+ * buffer if the carrier did not have one before, otherwise the (emptied)
+ * buffer is left to the carrier.
+ */
+class BinaryWriteBuf : public std::streambuf {
+	public:
+	BinaryWriteBuf(struct otc_binary_data *binary_data) : wb_data(binary_data), wb_buffer(nullptr), wb_capacity(0), wb_reuse(false)
 	{
-		auto iter = tm_data.find(key);
-		if (iter != tm_data.end())
-			return opentracing::string_view{iter->second};
+		if (OT_CARRIER_IS_OWN(wb_data) && (wb_data->data != nullptr) && (wb_data->capacity > 0)) {
+			wb_buffer   = OT_CAST_TYPEOF(wb_buffer, wb_data->data);
+			wb_capacity = wb_data->capacity;
+			wb_reuse    = true;
+		}
 
-		return opentracing::make_unexpected(opentracing::key_not_found_error);
+		setp(wb_buffer, wb_buffer + wb_capacity);
 	}
 
-	/***
-	 * HTTPHeadersReader: ForeachKey() returns TextMap contents via repeated
-	 * calls to the f() function.  If any call to f() returns an error,
-	 * ForeachKey() terminates and returns that error.
-	 */
-	opentracing::expected<void> ForeachKey(std::function<opentracing::expected<void>(opentracing::string_view key, opentracing::string_view value)> f) const override
+	void commit(void)
 	{
-		for (const auto &text_map : tm_data) {
-			auto result = f(text_map.first, text_map.second);
-			if (!result)
-				return result;
+		if (!wb_reuse)
+			wb_data->is_dynamic = false;
+
+		wb_data->data     = wb_buffer;
+		wb_data->size     = pptr() - pbase();
+		wb_data->magic    = (wb_buffer != nullptr) ? OT_CARRIER_MAGIC : 0;
+		wb_data->capacity = wb_capacity;
+	}
+
+	void abort(void)
+	{
+		if (!wb_reuse) {
+			OT_MEM_FREE_CLEAR(BINARY_DATA, wb_buffer, wb_capacity);
+		} else {
+			wb_data->data     = wb_buffer;
+			wb_data->size     = 0;
+			wb_data->capacity = wb_capacity;
 		}
+	}
 
-		return {};
+	protected:
+	int_type overflow(int_type c) override
+	{
+		if (traits_type::eq_int_type(c, traits_type::eof()))
+			return traits_type::not_eof(c);
+		else if (!grow(wb_capacity + 1))
+			return traits_type::eof();
+
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+
+		return c;
+	}
+
+	std::streamsize xsputn(const char *s, std::streamsize n) override
+	{
+		if ((epptr() - pptr()) < n)
+			if (!grow(OT_CAST_STAT(size_t, pptr() - pbase()) + n))
+				return 0;
+
+		(void)memcpy(pptr(), s, n);
+		pbump(n);
+
+		return n;
 	}
 
 	private:
-	TextMap &tm_data;
+	/* The buffer size is at least doubled each time. */
+	bool grow(size_t size)
+	{
+		size_t  len      = pptr() - pbase();
+		size_t  capacity = std::max(std::max(size, wb_capacity * 2), OT_CAST_STAT(size_t, OT_BINARY_DATA_SIZE));
+		char   *buffer;
+
+		if ((buffer = OT_CAST_TYPEOF(buffer, OTC_DBG_REALLOC(wb_buffer, capacity))) == nullptr)
+			return false;
+
+		OT_STAT_ADD(MEM_BINARY_DATA, capacity - wb_capacity);
+
+		wb_buffer   = buffer;
+		wb_capacity = capacity;
+		setp(wb_buffer, wb_buffer + wb_capacity);
+		pbump(len);
+
+		return true;
+	}
+
+	struct otc_binary_data *wb_data;
+	char                   *wb_buffer;
+	size_t                  wb_capacity;
+	bool                    wb_reuse;
+};
+
+
+/***
+ * The stream buffer used to extract the span context in the binary format;
+ * the data is read directly from the data buffer of the carrier.
+ */
+class BinaryReadBuf : public std::streambuf {
+	public:
+	BinaryReadBuf(const struct otc_binary_data *binary_data)
+	{
+		char *data = OT_CAST_REINTERPRET(char *, binary_data->data);
+
+		setg(data, data, data + binary_data->size);
+	}
+
+	protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override
+	{
+		char *ptr = (dir == std::ios_base::beg) ? eback() : ((dir == std::ios_base::end) ? egptr() : gptr());
+
+		if (!(which & std::ios_base::in) || !OT_IN_RANGE(ptr + off, eback(), egptr()))
+			return pos_type(off_type(-1));
+
+		setg(eback(), ptr + off, egptr());
+
+		return pos_type(gptr() - eback());
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
 };
 
 
-struct otc_tracer *ot_tracer_new(void);
+struct otc_tracer        *ot_tracer_new(void);
+otc_propagation_format_t  ot_tracer_propagation_format(void);
 
 #endif /* _OPENTRACING_C_WRAPPER_TRACER_H_ */
 
@@ -24,15 +24,127 @@
 
 /* Parameter 'p' must not be in parentheses! */
 #define OT_TEXT_MAP_SIZE(p,n)   (sizeof(text_map->p) * (text_map->size + (n)))
+#define OT_TEXT_MAP_ARENA(a)    (OT_CAST_REINTERPRET(struct otc_text_map_arena *, (a)->key) - 1)
+#define OT_TEXT_MAP_DATA(a)     OT_CAST_REINTERPRET(char *, (a)->value + (a)->size)
 
+/*
+ * The value of the magic member of the text map and binary data structures
+ * whose memory was allocated by the library: only such memory is counted in
+ * the memory counters, kept for reuse by clear and reused by inject.  The
+ * structures passed by the caller are not necessarily initialized, so a
+ * single flag would not be reliable.
+ */
+#define OT_CARRIER_MAGIC        0x6f74634dU
+#define OT_CARRIER_IS_OWN(a)    ((a)->magic == OT_CARRIER_MAGIC)
+#define OT_TEXT_MAP_IS_ARENA(a) ((a)->is_arena && OT_CARRIER_IS_OWN(a))
+
+
+#define OT_STAT_ADD(c,n)         ot_stats_tl.add(OT_STAT_##c, (n))
+#define OT_STAT_INC(c)           OT_STAT_ADD(c, 1)
+
+/* Allocation and release of the memory counted in the OT_STAT_MEM_* counters. */
+#define OT_MEM_MALLOC(c,s)       ot_mem_add(OT_STAT_MEM_##c, OTC_DBG_MALLOC(s), (s))
+#define OT_MEM_CALLOC(c,n,s)     ot_mem_add(OT_STAT_MEM_##c, OTC_DBG_CALLOC((n), (s)), (n) * (s))
+#define OT_MEM_FREE_CLEAR(c,a,s) do { if ((a) != nullptr) { OT_STAT_ADD(MEM_##c, -OT_CAST_STAT(int64_t, (s))); OTC_DBG_FREE(a); (a) = nullptr; } } while (0)
+
+
+/***
+ * The header of the text map arena block.  The block contains the header,
+ * the arrays of key and value pointers and the string data, in that order.
+ */
+struct otc_text_map_arena {
+	size_t size;        /* The size of the whole block in bytes. */
+	size_t used;        /* The number of string data bytes used. */
+	bool   is_external; /* The block is provided by the caller. */
+};
+
+
+typedef enum {
+	OT_STAT_SPAN_ALLOC_FAIL = 0,
+	OT_STAT_SPAN_ERASE,
+	OT_STAT_SPAN_DESTROY,
+	OT_STAT_SPAN_POOL_HIT,
+	OT_STAT_SPAN_POOL_MISS,
+	OT_STAT_SPAN_SAMPLED_OUT,
+	OT_STAT_FINISH_ASYNC,
+	OT_STAT_FINISH_DELETED,  /* Deleted without calling the finish function. */
+	OT_STAT_CTX_ALLOC_FAIL,
+	OT_STAT_CTX_ERASE,
+	OT_STAT_CTX_DESTROY,
+	OT_STAT_CTX_POOL_HIT,
+	OT_STAT_CTX_POOL_MISS,
+	OT_STAT_CROSS_THREAD,
+	OT_STAT_CALLS,
+	OT_STAT_LOCK_WAIT,
+	OT_STAT_LOCK_WAIT_NS,
+	OT_STAT_MEM_SPAN,        /* The memory counters are in bytes. */
+	OT_STAT_MEM_CTX,
+	OT_STAT_MEM_TEXT_MAP,
+	OT_STAT_MEM_BINARY_DATA,
+	OT_STAT_BAGGAGE_RETURNED, /* The bytes of the baggage items returned so far. */
+	OT_STAT_MAX
+} ot_stat_t;
+
+/***
+ * Statistics counters of one thread.  A counter is changed only by the
+ * thread that owns it, so there is no need for atomic read-modify-write
+ * operations.  The counters are aligned to the cache line size so that
+ * the counters of different threads do not share the same cache line,
+ * and they are summed up only when the statistics are requested.
+ */
+class alignas(OT_CACHE_LINE_SIZE) otc_stats_local {
+	public:
+	otc_stats_local();
+	~otc_stats_local();
+
+	void add(ot_stat_t idx, int64_t n)
+	{
+		cnt[idx].store(cnt[idx].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	int64_t get(int idx) const { return cnt[idx].load(std::memory_order_relaxed); }
+
+	private:
+	std::atomic<int64_t> cnt[OT_STAT_MAX];
+};
+
+
+/***
+ * Convert the time to the duration since the epoch of its clock.  They are
+ * called for each timestamp set by the application or the clock source, so
+ * they are inlined.
+ */
+static inline std::chrono::microseconds timespec_to_duration_us(const struct timespec *ts)
+{
+	return std::chrono::seconds{ts->tv_sec} + std::chrono::microseconds{ts->tv_nsec / 1000};
+}
+
+static inline std::chrono::nanoseconds timespec_to_duration(const struct timespec *ts)
+{
+	return std::chrono::seconds{ts->tv_sec} + std::chrono::nanoseconds{ts->tv_nsec};
+}
+
+
+extern otc_ext_malloc_t             otc_ext_malloc;
+extern otc_ext_free_t               otc_ext_free;
+extern thread_local otc_stats_local ot_stats_tl;
+
+
+/***
+ * Counts the size of the allocated memory in the memory counter 'idx'.
+ */
+static inline void *ot_mem_add(ot_stat_t idx, void *ptr, size_t size)
+{
+	if (ptr != nullptr)
+		ot_stats_tl.add(idx, size);
 
-extern otc_ext_malloc_t otc_ext_malloc;
-extern otc_ext_free_t   otc_ext_free;
+	return ptr;
+}
 
 
-std::chrono::microseconds timespec_to_duration_us(const struct timespec *ts);
-std::chrono::nanoseconds  timespec_to_duration(const struct timespec *ts);
-const char               *otc_strerror(int errnum);
+const char *otc_strerror(int errnum);
+bool        ot_value_set(opentracing::Value &dst, const struct otc_value *src);
+void        ot_stats_get(int64_t *cnt);
 
 #endif /* _OPENTRACING_C_WRAPPER_UTIL_H_ */
 
@@ -0,0 +1,21 @@
+dnl am-enable-compact-abi.m4 by Miroslav Zagorac <mzagorac@haproxy.com>
+dnl
+AC_DEFUN([AX_ENABLE_COMPACT_ABI], [
+	AC_ARG_ENABLE([compact-abi],
+		[AS_HELP_STRING([--enable-compact-abi], [spans share one table of span operations @<:@default=no@:>@])],
+		[enable_compact_abi="${enableval}"],
+		[enable_compact_abi=no]
+	)
+
+	OTC_ABI_CFLAGS=
+
+	if test "${enable_compact_abi}" = "yes"; then
+		OTC_ABI_CFLAGS="-DOTC_COMPACT_ABI"
+
+		AC_DEFINE([OTC_COMPACT_ABI], [1], [Define to 1 to build the library with the compact ABI.])
+	fi
+
+	AC_MSG_NOTICE([compact ABI: ${enable_compact_abi}])
+
+	AC_SUBST([OTC_ABI_CFLAGS])
+])
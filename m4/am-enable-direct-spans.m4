@@ -0,0 +1,16 @@
+dnl am-enable-direct-spans.m4 by Miroslav Zagorac <mzagorac@haproxy.com>
+dnl
+AC_DEFUN([AX_ENABLE_DIRECT_SPANS], [
+	AC_ARG_ENABLE([direct-spans],
+		[AS_HELP_STRING([--enable-direct-spans], [access spans and span contexts directly instead of through the handle tables; UNSAFE: the use of a finished or destroyed span or span context is not detected @<:@default=no@:>@])],
+		[enable_direct_spans="${enableval}"],
+		[enable_direct_spans=no]
+	)
+
+	if test "${enable_direct_spans}" = "yes"; then
+		AC_DEFINE([OT_DIRECT_SPANS], [1], [Define to 1 to access spans and span contexts directly.])
+		AC_MSG_WARN([direct spans are unsafe: the use of a finished or destroyed span or span context is not detected])
+	fi
+
+	AC_MSG_NOTICE([direct spans: ${enable_direct_spans}])
+])
@@ -0,0 +1,15 @@
+dnl am-enable-thread-handles.m4 by Miroslav Zagorac <mzagorac@haproxy.com>
+dnl
+AC_DEFUN([AX_ENABLE_THREAD_HANDLES], [
+	AC_ARG_ENABLE([thread-handles],
+		[AS_HELP_STRING([--enable-thread-handles], [use per-thread span/span context handle tables without locking @<:@default=no@:>@])],
+		[enable_thread_handles="${enableval}"],
+		[enable_thread_handles=no]
+	)
+
+	if test "${enable_thread_handles}" = "yes"; then
+		AC_DEFINE([OT_THREADS_NO_LOCKING], [1], [Define to 1 to use per-thread handle tables without locking.])
+	fi
+
+	AC_MSG_NOTICE([thread handles: ${enable_thread_handles}])
+])
@@ -0,0 +1,33 @@
+dnl am-with-handle-shards.m4 by Miroslav Zagorac <mzagorac@haproxy.com>
+dnl
+AC_DEFUN([AX_WITH_HANDLE_SHARDS], [
+	AC_ARG_WITH([handle-shards],
+		[AS_HELP_STRING([--with-handle-shards=NUM], [number of span/span context handle table shards @<:@default=64@:>@])],
+		[with_handle_shards="${withval}"],
+		[with_handle_shards=64]
+	)
+
+	case "${with_handle_shards}" in
+	  yes)
+		with_handle_shards=64
+		;;
+	  no)
+		with_handle_shards=1
+		;;
+	  *[[!0-9]]*|"")
+		AC_MSG_ERROR([invalid number of handle table shards '${with_handle_shards}'])
+		;;
+	esac
+
+	if test "${with_handle_shards}" -lt 1 -o "${with_handle_shards}" -gt 1024; then
+		AC_MSG_ERROR([number of handle table shards must be in the range 1 .. 1024])
+	fi
+
+	dnl Without threads there is nothing to spread the locking over.
+	if test "${enable_threads}" = "no"; then
+		with_handle_shards=1
+	fi
+
+	AC_DEFINE_UNQUOTED([OT_HANDLE_SHARDS], [${with_handle_shards}], [Number of span/span context handle table shards.])
+	AC_MSG_NOTICE([handle table shards: ${with_handle_shards}])
+])
@@ -0,0 +1,28 @@
+dnl am-with-span-pool.m4 by Miroslav Zagorac <mzagorac@haproxy.com>
+dnl
+AC_DEFUN([AX_WITH_SPAN_POOL], [
+	AC_ARG_WITH([span-pool],
+		[AS_HELP_STRING([--with-span-pool=NUM], [maximum number of free span/span context structures kept per thread @<:@default=256@:>@])],
+		[with_span_pool="${withval}"],
+		[with_span_pool=256]
+	)
+
+	case "${with_span_pool}" in
+	  yes)
+		with_span_pool=256
+		;;
+	  no)
+		with_span_pool=0
+		;;
+	  *[[!0-9]]*|"")
+		AC_MSG_ERROR([invalid span pool size '${with_span_pool}'])
+		;;
+	esac
+
+	if test "${with_span_pool}" -gt 1048576; then
+		AC_MSG_ERROR([span pool size must be in the range 0 .. 1048576])
+	fi
+
+	AC_DEFINE_UNQUOTED([OT_POOL_SIZE], [${with_span_pool}], [Maximum number of free span/span context structures kept per thread.])
+	AC_MSG_NOTICE([span pool size: ${with_span_pool}])
+])
@@ -0,0 +1,28 @@
+dnl am-with-tag-buffer.m4 by Miroslav Zagorac <mzagorac@haproxy.com>
+dnl
+AC_DEFUN([AX_WITH_TAG_BUFFER], [
+	AC_ARG_WITH([tag-buffer],
+		[AS_HELP_STRING([--with-tag-buffer=NUM], [number of tags and log fields buffered in each span until it is finished @<:@default=no@:>@])],
+		[with_tag_buffer="${withval}"],
+		[with_tag_buffer=0]
+	)
+
+	case "${with_tag_buffer}" in
+	  yes)
+		with_tag_buffer=16
+		;;
+	  no)
+		with_tag_buffer=0
+		;;
+	  *[[!0-9]]*|"")
+		AC_MSG_ERROR([invalid tag buffer size '${with_tag_buffer}'])
+		;;
+	esac
+
+	if test "${with_tag_buffer}" -gt 1024; then
+		AC_MSG_ERROR([tag buffer size must be in the range 0 .. 1024])
+	fi
+
+	AC_DEFINE_UNQUOTED([OT_TAG_BUFFER], [${with_tag_buffer}], [Number of tags and log fields buffered in each span.])
+	AC_MSG_NOTICE([tag buffer size: ${with_tag_buffer}])
+])
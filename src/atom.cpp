@@ -0,0 +1,135 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+struct otc_atom_entry ot_atom[OT_ATOM_MAX];
+std::atomic<int>      ot_atom_count(0);
+static std::mutex     ot_atom_mutex;
+
+
+/***
+ * NAME
+ *   ot_atom_hash -
+ *
+ * ARGUMENTS
+ *   str -
+ *   len -
+ *
+ * DESCRIPTION
+ *   The FNV-1a hash of the string.
+ *
+ * RETURN VALUE
+ *   -
+ */
+uint64_t ot_atom_hash(const char *str, size_t len)
+{
+	uint64_t retval = UINT64_C(0xcbf29ce484222325);
+
+	for (size_t i = 0; i < len; i++)
+		retval = (retval ^ OT_CAST_STAT(uint8_t, str[i])) * UINT64_C(0x100000001b3);
+
+	return retval;
+}
+
+
+/***
+ * NAME
+ *   otc_intern -
+ *
+ * ARGUMENTS
+ *   str - the operation name or the tag key
+ *
+ * DESCRIPTION
+ *   Interns the string: the string is copied to the atom table (once, the
+ *   same string always gets the same atom), together with its length and
+ *   hash.  The atom can then be passed to the start_span_atom(),
+ *   set_tag_atom() and log_fields_atom() functions instead of the string,
+ *   so that the string does not have to be measured, hashed or copied on
+ *   each call.  The atoms stay valid until the program exits.
+ *
+ *   The lookup of an already interned string is linear, the function is
+ *   intended to be called while the configuration is read, not for each
+ *   span.
+ *
+ * RETURN VALUE
+ *   Returns the atom of the string, or -1 if the string is NULL, the atom
+ *   table is full or the memory cannot be allocated.
+ */
+otc_atom_t otc_intern(const char *str)
+{
+	const std::lock_guard<std::mutex> guard(ot_atom_mutex);
+	size_t                            len;
+	uint64_t                          hash;
+	int                               n;
+
+	if (str == nullptr)
+		return -1;
+
+	len  = strlen(str);
+	hash = ot_atom_hash(str, len);
+	n    = ot_atom_count.load(std::memory_order_relaxed);
+
+	for (int i = 0; i < n; i++)
+		if ((ot_atom[i].hash == hash) && (ot_atom[i].len == len) && (memcmp(ot_atom[i].str.get(), str, len) == 0))
+			return i;
+
+	if (n >= OT_ATOM_MAX)
+		return -1;
+
+	ot_atom[n].str.reset(new(std::nothrow) char[len + 1]);
+	if (ot_atom[n].str == nullptr)
+		return -1;
+
+	(void)memcpy(ot_atom[n].str.get(), str, len + 1);
+	ot_atom[n].len  = len;
+	ot_atom[n].hash = hash;
+
+	/* The new entry becomes visible to the other threads only now. */
+	ot_atom_count.store(n + 1, std::memory_order_release);
+
+	return n;
+}
+
+
+/***
+ * NAME
+ *   otc_atom_str -
+ *
+ * ARGUMENTS
+ *   atom -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the interned string, or NULL if the atom is not valid.
+ */
+const char *otc_atom_str(otc_atom_t atom)
+{
+	const struct otc_atom_entry *entry = ot_atom_get(atom);
+
+	return (entry == nullptr) ? nullptr : entry->str.get();
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
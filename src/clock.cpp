@@ -0,0 +1,206 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+std::atomic<int>                   ot_clock_source(otc_clock_tracer);
+static std::atomic<otc_clock_cb_t> ot_clock_cb(nullptr);
+
+
+/***
+ * NAME
+ *   ot_clock_read -
+ *
+ * ARGUMENTS
+ *   steady - the steady time, or nullptr if not needed
+ *   system - the system time, or nullptr if not needed
+ *
+ * DESCRIPTION
+ *   Reads the time from the selected clock source.  The coarse clocks are
+ *   read through the vDSO, without a system call, and the callback usually
+ *   returns the time that the application has already read.  The times that
+ *   the clock source does not set are left at zero.
+ *
+ * RETURN VALUE
+ *   Returns true if the wrapper fills in the timestamps, false if they are
+ *   left to the tracer.
+ */
+static bool ot_clock_read(struct timespec *steady, struct timespec *system)
+{
+	const int source = ot_clock_source.load(std::memory_order_relaxed);
+
+	if (source == otc_clock_coarse) {
+		if (steady != nullptr)
+			(void)clock_gettime(CLOCK_MONOTONIC_COARSE, steady);
+		if (system != nullptr)
+			(void)clock_gettime(CLOCK_REALTIME_COARSE, system);
+	}
+	else if (source == otc_clock_callback) {
+		const otc_clock_cb_t callback = ot_clock_cb.load(std::memory_order_acquire);
+
+		/* The callback is never unset, once it is set. */
+		if (callback == nullptr)
+			return false;
+
+		callback(steady, system);
+	}
+	else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_clock_now -
+ *
+ * ARGUMENTS
+ *   steady -
+ *   system -
+ *
+ * DESCRIPTION
+ *   Sets both the steady and the system time from the selected clock
+ *   source, with a single call of the callback.  The times that the clock
+ *   source does not set remain unchanged.
+ *
+ * RETURN VALUE
+ *   Returns true if the times are set by the wrapper, false if the tracer
+ *   reads the clocks itself.
+ */
+bool ot_clock_now(std::chrono::steady_clock::time_point &steady, opentracing::SystemTime &system)
+{
+	struct timespec ts_steady = { 0, 0 }, ts_system = { 0, 0 };
+
+	if (!ot_clock_read(&ts_steady, &ts_system))
+		return false;
+
+	if (ts_steady.tv_sec > 0)
+		steady = std::chrono::steady_clock::time_point(timespec_to_duration(&ts_steady));
+
+	if (ts_system.tv_sec > 0)
+#ifdef __clang__
+		system = opentracing::SystemTime(timespec_to_duration_us(&ts_system));
+#else
+		system = opentracing::SystemTime(timespec_to_duration(&ts_system));
+#endif
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_clock_steady -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the steady time from the selected clock source, or from the
+ *   steady clock if the clock source does not set it.
+ */
+std::chrono::steady_clock::time_point ot_clock_steady(void)
+{
+	struct timespec ts = { 0, 0 };
+
+	if (ot_clock_read(&ts, nullptr) && (ts.tv_sec > 0))
+		return std::chrono::steady_clock::time_point(timespec_to_duration(&ts));
+
+	return std::chrono::steady_clock::now();
+}
+
+
+/***
+ * NAME
+ *   ot_clock_system -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the system time from the selected clock source, or from the
+ *   system clock if the clock source does not set it.
+ */
+opentracing::SystemTime ot_clock_system(void)
+{
+	struct timespec ts = { 0, 0 };
+
+	if (ot_clock_read(nullptr, &ts) && (ts.tv_sec > 0))
+#ifdef __clang__
+		return opentracing::SystemTime(timespec_to_duration_us(&ts));
+#else
+		return opentracing::SystemTime(timespec_to_duration(&ts));
+#endif
+
+	return opentracing::SystemClock::now();
+}
+
+
+/***
+ * NAME
+ *   otc_tracer_clock -
+ *
+ * ARGUMENTS
+ *   source   - the clock source
+ *   callback - the function that returns the time, used by the
+ *              otc_clock_callback source
+ *
+ * DESCRIPTION
+ *   Selects the source of the start, finish and log timestamps that are
+ *   not set by the application.  By default the tracer reads the clocks
+ *   itself.  With otc_clock_coarse the wrapper reads the coarse clocks,
+ *   which are cheaper but only as precise as the kernel tick; with
+ *   otc_clock_callback the time is taken from the application, which
+ *   typically returns the time it has already read in its event loop.  The
+ *   steady time must then be based on CLOCK_MONOTONIC and the system time
+ *   on CLOCK_REALTIME, so that they agree with the times set explicitly.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 if the arguments are not valid.
+ */
+int otc_tracer_clock(otc_clock_source_t source, otc_clock_cb_t callback)
+{
+	if (source == otc_clock_callback) {
+		if (callback == nullptr)
+			return -1;
+
+		ot_clock_cb.store(callback, std::memory_order_release);
+	}
+	else if (!OT_IN_RANGE(source, otc_clock_tracer, otc_clock_coarse)) {
+		return -1;
+	}
+
+	ot_clock_source.store(source, std::memory_order_relaxed);
+
+	return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
@@ -0,0 +1,766 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+/***
+ * NAME
+ *   ot_hex_value -
+ *
+ * ARGUMENTS
+ *   c -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the value of the hexadecimal digit, or -1 if the character is
+ *   not a hexadecimal digit.
+ */
+static inline int ot_hex_value(int c)
+{
+	if (OT_IN_RANGE(c, '0', '9'))
+		return c - '0';
+
+	c |= 0x20;
+
+	return OT_IN_RANGE(c, 'a', 'f') ? (c - 'a' + 10) : -1;
+}
+
+
+/***
+ * NAME
+ *   ot_hex_decode -
+ *
+ * ARGUMENTS
+ *   str     -
+ *   len     -
+ *   id_high - the upper 64 bits of a 128-bit id, or NULL for a 64-bit id
+ *   id      -
+ *
+ * DESCRIPTION
+ *   Decodes an id written with at most 16 (or 32, if id_high is specified)
+ *   hexadecimal digits.
+ *
+ * RETURN VALUE
+ *   Returns true on success, false if the id is not valid.
+ */
+static bool ot_hex_decode(const char *str, size_t len, uint64_t *id_high, uint64_t *id)
+{
+	uint64_t high = 0, low = 0;
+
+	if ((len == 0) || (len > ((id_high == nullptr) ? 16U : 32U)))
+		return false;
+
+	for (size_t i = 0; i < len; i++) {
+		int value = ot_hex_value(str[i]);
+
+		if (value < 0)
+			return false;
+
+		high = (high << 4) | (low >> 60);
+		low  = (low << 4) | OT_CAST_STAT(uint64_t, value);
+	}
+
+	if (id_high != nullptr)
+		*id_high = high;
+	*id = low;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_hex_encode -
+ *
+ * ARGUMENTS
+ *   buffer -
+ *   id     -
+ *
+ * DESCRIPTION
+ *   Writes the id as 16 hexadecimal digits, without the terminating null
+ *   character.
+ *
+ * RETURN VALUE
+ *   Returns the pointer to the end of the written digits.
+ */
+static char *ot_hex_encode(char *buffer, uint64_t id)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	for (int i = 15; i >= 0; i--, id >>= 4)
+		buffer[i] = digits[id & 0x0f];
+
+	return buffer + 16;
+}
+
+
+/***
+ * NAME
+ *   ot_dec_decode -
+ *
+ * ARGUMENTS
+ *   str -
+ *   id  -
+ *
+ * DESCRIPTION
+ *   Decodes an unsigned 64-bit decimal number.
+ *
+ * RETURN VALUE
+ *   Returns true on success, false if the number is not valid.
+ */
+static bool ot_dec_decode(const char *str, uint64_t *id)
+{
+	uint64_t value = 0;
+
+	if (*str == '\0')
+		return false;
+
+	for ( ; *str != '\0'; str++) {
+		if (!OT_IN_RANGE(*str, '0', '9') || (value > ((UINT64_MAX - (*str - '0')) / 10)))
+			return false;
+
+		value = value * 10 + (*str - '0');
+	}
+
+	*id = value;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_field -
+ *
+ * ARGUMENTS
+ *   str  -
+ *   sep  -
+ *   next -
+ *
+ * DESCRIPTION
+ *   Finds the end of a field ended by the separator sep or by the end of
+ *   the string.  The ':' separator can also be URL-encoded, as written by
+ *   some tracers to the HTTP headers.  The next argument is set to the
+ *   beginning of the next field, or to NULL if this is the last field.
+ *
+ * RETURN VALUE
+ *   Returns the length of the field.
+ */
+static size_t ot_codec_field(const char *str, char sep, const char **next)
+{
+	const char *ptr;
+
+	for (ptr = str; *ptr != '\0'; ptr++)
+		if (*ptr == sep) {
+			*next = ptr + 1;
+
+			return ptr - str;
+		}
+		else if ((sep == ':') && (ptr[0] == '%') && (ptr[1] == '3') && ((ptr[2] | 0x20) == 'a')) {
+			*next = ptr + 3;
+
+			return ptr - str;
+		}
+
+	*next = nullptr;
+
+	return ptr - str;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_sampled -
+ *
+ * ARGUMENTS
+ *   str     -
+ *   len     -
+ *   context -
+ *
+ * DESCRIPTION
+ *   Sets the sampling flags from the B3 sampling state, which can be '0',
+ *   '1', 'true', 'false' or 'd' (debug, only in the single header format).
+ *
+ * RETURN VALUE
+ *   Returns true on success, false if the sampling state is not valid.
+ */
+static bool ot_codec_sampled(const char *str, size_t len, struct otc_trace_context *context)
+{
+	if (((len == 1) && (*str == '1')) || ((len == 4) && (strncasecmp(str, "true", 4) == 0)))
+		context->flags = OTC_TRACE_FLAG_SAMPLED;
+	else if (((len == 1) && (*str == '0')) || ((len == 5) && (strncasecmp(str, "false", 5) == 0)))
+		context->flags = 0;
+	else if ((len == 1) && (*str == 'd'))
+		context->flags = OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG;
+	else
+		return false;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_jaeger_decode -
+ *
+ * ARGUMENTS
+ *   value   -
+ *   context -
+ *
+ * DESCRIPTION
+ *   Decodes the uber-trace-id header value:
+ *   {trace-id}:{span-id}:{parent-span-id}:{flags}
+ *
+ * RETURN VALUE
+ *   Returns the OT_CODEC_SEEN_* bits of the decoded data, or -1 if the
+ *   header value is not valid.
+ */
+static int ot_codec_jaeger_decode(const char *value, struct otc_trace_context *context)
+{
+	const char *field[4], *next = value;
+	size_t      len[4];
+	uint64_t    flags;
+
+	for (int i = 0; i < 4; i++) {
+		if (next == nullptr)
+			return -1;
+
+		field[i] = next;
+		len[i]   = ot_codec_field(next, ':', &next);
+	}
+
+	if ((next != nullptr) || (len[3] > 2))
+		return -1;
+	else if (!ot_hex_decode(field[0], len[0], &(context->trace_id_high), &(context->trace_id)))
+		return -1;
+	else if (!ot_hex_decode(field[1], len[1], nullptr, &(context->span_id)))
+		return -1;
+	else if (!ot_hex_decode(field[2], len[2], nullptr, &(context->parent_span_id)))
+		return -1;
+	else if (!ot_hex_decode(field[3], len[3], nullptr, &flags))
+		return -1;
+
+	context->flags = flags & (OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG);
+
+	return OT_CODEC_SEEN_IDS;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_b3_decode -
+ *
+ * ARGUMENTS
+ *   key     -
+ *   value   -
+ *   context -
+ *
+ * DESCRIPTION
+ *   Decodes one of the B3 multiple headers.
+ *
+ * RETURN VALUE
+ *   Returns the OT_CODEC_SEEN_* bits of the decoded data, 0 if the header
+ *   is not a B3 header, or -1 if the header value is not valid.
+ */
+static int ot_codec_b3_decode(const char *key, const char *value, struct otc_trace_context *context)
+{
+	if (strncasecmp(key, "x-b3-", 5) != 0)
+		return 0;
+	else if (strcasecmp(key, OT_CODEC_B3_TRACE_ID) == 0)
+		return ot_hex_decode(value, strlen(value), &(context->trace_id_high), &(context->trace_id)) ? OT_CODEC_SEEN_TRACE_ID : -1;
+	else if (strcasecmp(key, OT_CODEC_B3_SPAN_ID) == 0)
+		return ot_hex_decode(value, strlen(value), nullptr, &(context->span_id)) ? OT_CODEC_SEEN_SPAN_ID : -1;
+	else if (strcasecmp(key, OT_CODEC_B3_PARENT_SPAN_ID) == 0)
+		return ot_hex_decode(value, strlen(value), nullptr, &(context->parent_span_id)) ? OT_CODEC_SEEN_OTHER : -1;
+	else if (strcasecmp(key, OT_CODEC_B3_SAMPLED) == 0) {
+		/* The debug flag takes precedence over the sampling state. */
+		if (context->flags & OTC_TRACE_FLAG_DEBUG)
+			return OT_CODEC_SEEN_OTHER;
+
+		return ot_codec_sampled(value, strlen(value), context) ? OT_CODEC_SEEN_OTHER : -1;
+	}
+	else if (strcasecmp(key, OT_CODEC_B3_FLAGS) == 0) {
+		if (strcmp(value, "1") == 0)
+			context->flags = OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG;
+		else if (strcmp(value, "0") != 0)
+			return -1;
+
+		return OT_CODEC_SEEN_OTHER;
+	}
+
+	return 0;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_b3_single_decode -
+ *
+ * ARGUMENTS
+ *   value   -
+ *   context -
+ *
+ * DESCRIPTION
+ *   Decodes the b3 header value:
+ *   {trace-id}-{span-id}[-{sampling-state}[-{parent-span-id}]]
+ *   or only {sampling-state}
+ *
+ * RETURN VALUE
+ *   Returns the OT_CODEC_SEEN_* bits of the decoded data, or -1 if the
+ *   header value is not valid.
+ */
+static int ot_codec_b3_single_decode(const char *value, struct otc_trace_context *context)
+{
+	const char *field[4], *next = value;
+	size_t      len[4];
+	int         n;
+
+	for (n = 0; (n < 4) && (next != nullptr); n++) {
+		field[n] = next;
+		len[n]   = ot_codec_field(next, '-', &next);
+	}
+
+	if (next != nullptr)
+		return -1;
+	else if (n == 1)
+		return ot_codec_sampled(field[0], len[0], context) ? OT_CODEC_SEEN_OTHER : -1;
+	else if (!ot_hex_decode(field[0], len[0], &(context->trace_id_high), &(context->trace_id)))
+		return -1;
+	else if (!ot_hex_decode(field[1], len[1], nullptr, &(context->span_id)))
+		return -1;
+	else if ((n > 2) && !ot_codec_sampled(field[2], len[2], context))
+		return -1;
+	else if ((n > 3) && !ot_hex_decode(field[3], len[3], nullptr, &(context->parent_span_id)))
+		return -1;
+
+	return OT_CODEC_SEEN_IDS;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_w3c_decode -
+ *
+ * ARGUMENTS
+ *   value   -
+ *   context -
+ *
+ * DESCRIPTION
+ *   Decodes the traceparent header value:
+ *   {version}-{trace-id}-{parent-id}-{trace-flags}
+ *   Versions higher than 00 may append more fields, which are ignored.
+ *
+ * RETURN VALUE
+ *   Returns the OT_CODEC_SEEN_* bits of the decoded data, or -1 if the
+ *   header value is not valid.
+ */
+static int ot_codec_w3c_decode(const char *value, struct otc_trace_context *context)
+{
+	const char *field[4], *next = value;
+	size_t      len[4];
+	uint64_t    version, flags;
+
+	for (int i = 0; i < 4; i++) {
+		if (next == nullptr)
+			return -1;
+
+		field[i] = next;
+		len[i]   = ot_codec_field(next, '-', &next);
+	}
+
+	if ((len[0] != 2) || (len[1] != 32) || (len[2] != 16) || (len[3] != 2))
+		return -1;
+	else if (!ot_hex_decode(field[0], len[0], nullptr, &version) || (version == 0xff) || ((version == 0) && (next != nullptr)))
+		return -1;
+	else if (!ot_hex_decode(field[1], len[1], &(context->trace_id_high), &(context->trace_id)))
+		return -1;
+	else if (!ot_hex_decode(field[2], len[2], nullptr, &(context->span_id)))
+		return -1;
+	else if (!ot_hex_decode(field[3], len[3], nullptr, &flags))
+		return -1;
+
+	context->flags = flags & OTC_TRACE_FLAG_SAMPLED;
+
+	return OT_CODEC_SEEN_IDS;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_datadog_decode -
+ *
+ * ARGUMENTS
+ *   key     -
+ *   value   -
+ *   context -
+ *
+ * DESCRIPTION
+ *   Decodes one of the DataDog headers.  The ids are decimal numbers, the
+ *   sampling priority is -1 or 0 (drop), 1 (keep) or 2 (keep by the user).
+ *
+ * RETURN VALUE
+ *   Returns the OT_CODEC_SEEN_* bits of the decoded data, 0 if the header
+ *   is not a DataDog header, or -1 if the header value is not valid.
+ */
+static int ot_codec_datadog_decode(const char *key, const char *value, struct otc_trace_context *context)
+{
+	if (strncasecmp(key, "x-datadog-", 10) != 0)
+		return 0;
+	else if (strcasecmp(key, OT_CODEC_DD_TRACE_ID) == 0)
+		return ot_dec_decode(value, &(context->trace_id)) ? OT_CODEC_SEEN_TRACE_ID : -1;
+	else if (strcasecmp(key, OT_CODEC_DD_PARENT_ID) == 0)
+		return ot_dec_decode(value, &(context->span_id)) ? OT_CODEC_SEEN_SPAN_ID : -1;
+	else if (strcasecmp(key, OT_CODEC_DD_PRIORITY) == 0) {
+		if ((strcmp(value, "-1") == 0) || (strcmp(value, "0") == 0))
+			context->flags = 0;
+		else if (strcmp(value, "1") == 0)
+			context->flags = OTC_TRACE_FLAG_SAMPLED;
+		else if (strcmp(value, "2") == 0)
+			context->flags = OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG;
+		else
+			return -1;
+
+		return OT_CODEC_SEEN_OTHER;
+	}
+
+	return 0;
+}
+
+
+/***
+ * NAME
+ *   otc_codec_decoder::otc_codec_decoder -
+ *
+ * ARGUMENTS
+ *   decoder_format  -
+ *   decoder_context -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+otc_codec_decoder::otc_codec_decoder(otc_propagation_format_t decoder_format, struct otc_trace_context *decoder_context) : format(decoder_format), context(decoder_context), seen(0), is_corrupted(false)
+{
+	(void)memset(context, 0, sizeof(*context));
+
+	context->flags = OTC_TRACE_FLAG_DEFERRED;
+}
+
+
+/***
+ * NAME
+ *   otc_codec_decoder::add -
+ *
+ * ARGUMENTS
+ *   key   -
+ *   value -
+ *
+ * DESCRIPTION
+ *   Decodes the key/value pair if the key is one of the headers of the
+ *   decoder format, other pairs are skipped.
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_span_context_corrupted if the value
+ *   of the header is not valid, otherwise otc_propagation_error_code_success.
+ */
+otc_propagation_error_code_t otc_codec_decoder::add(const char *key, const char *value)
+{
+	int rc = 0;
+
+	if ((key == nullptr) || (value == nullptr))
+		return otc_propagation_error_code_success;
+
+	if (format == otc_propagation_format_jaeger) {
+		if (strcasecmp(key, OT_CODEC_JAEGER) == 0)
+			rc = ot_codec_jaeger_decode(value, context);
+	}
+	else if (format == otc_propagation_format_b3) {
+		rc = ot_codec_b3_decode(key, value, context);
+	}
+	else if (format == otc_propagation_format_b3_single) {
+		if (strcasecmp(key, OT_CODEC_B3_SINGLE) == 0)
+			rc = ot_codec_b3_single_decode(value, context);
+	}
+	else if (format == otc_propagation_format_w3c) {
+		if (strcasecmp(key, OT_CODEC_W3C_TRACEPARENT) == 0) {
+			rc = ot_codec_w3c_decode(value, context);
+		}
+		else if (strcasecmp(key, OT_CODEC_W3C_TRACESTATE) == 0) {
+			context->tracestate = value;
+
+			rc = OT_CODEC_SEEN_OTHER;
+		}
+	}
+	else if (format == otc_propagation_format_datadog) {
+		rc = ot_codec_datadog_decode(key, value, context);
+	}
+
+	if (rc == -1) {
+		is_corrupted = true;
+
+		return otc_propagation_error_code_span_context_corrupted;
+	}
+
+	seen |= rc;
+
+	return otc_propagation_error_code_success;
+}
+
+
+/***
+ * NAME
+ *   otc_codec_decoder::finish -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Checks the data decoded from all the key/value pairs of the carrier.
+ *   A carrier that holds only the sampling state (and no ids) is valid.
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_span_context_not_found if none of
+ *   the headers of the decoder format was found,
+ *   otc_propagation_error_code_span_context_corrupted if the header values
+ *   are not valid or incomplete, otherwise
+ *   otc_propagation_error_code_success.
+ */
+otc_propagation_error_code_t otc_codec_decoder::finish(void) const
+{
+	if (is_corrupted)
+		return otc_propagation_error_code_span_context_corrupted;
+	else if (seen == 0)
+		return otc_propagation_error_code_span_context_not_found;
+	else if ((seen & OT_CODEC_SEEN_IDS) == 0)
+		return otc_propagation_error_code_success;
+	else if ((seen & OT_CODEC_SEEN_IDS) != OT_CODEC_SEEN_IDS)
+		return otc_propagation_error_code_span_context_corrupted;
+	else if (((context->trace_id_high | context->trace_id) == 0) || (context->span_id == 0))
+		return otc_propagation_error_code_span_context_corrupted;
+
+	return otc_propagation_error_code_success;
+}
+
+
+/***
+ * NAME
+ *   otc_propagation_decode -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *   format   -
+ *   context  -
+ *
+ * DESCRIPTION
+ *   Reads the trace context from the text map, using the wrapper's own
+ *   decoder for the specified header format.  The header names are
+ *   compared case-insensitively.  No memory is allocated.
+ *
+ * RETURN VALUE
+ *   -
+ */
+otc_propagation_error_code_t otc_propagation_decode(const struct otc_text_map *text_map, otc_propagation_format_t format, struct otc_trace_context *context)
+{
+	if ((text_map == nullptr) || ((text_map->count > 0) && ((text_map->key == nullptr) || (text_map->value == nullptr))))
+		return otc_propagation_error_code_invalid_carrier;
+	else if (context == nullptr)
+		return otc_propagation_error_code_invalid_span_context;
+	else if (!OT_CODEC_FORMAT_IS_VALID(format))
+		return otc_propagation_error_code_unknown;
+
+	otc_codec_decoder decoder(format, context);
+
+	for (size_t i = 0; i < text_map->count; i++)
+		if (decoder.add(text_map->key[i], text_map->value[i]) != otc_propagation_error_code_success)
+			break;
+
+	return decoder.finish();
+}
+
+
+/***
+ * NAME
+ *   ot_codec_add -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *   key      -
+ *   value    -
+ *   len      -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns true on success, false in case of an error.
+ */
+static bool ot_codec_add(struct otc_text_map *text_map, const char *key, const char *value, size_t len)
+{
+	return otc_text_map_add(text_map, key, 0, value, len, OT_CAST_STAT(otc_text_map_flags_t, OTC_TEXT_MAP_DUP_KEY | OTC_TEXT_MAP_DUP_VALUE)) != -1;
+}
+
+
+/***
+ * NAME
+ *   ot_codec_trace_id -
+ *
+ * ARGUMENTS
+ *   buffer  -
+ *   context -
+ *   is_long - write the trace id with 32 digits even if it is 64-bit only
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the pointer to the end of the written digits.
+ */
+static char *ot_codec_trace_id(char *buffer, const struct otc_trace_context *context, bool is_long)
+{
+	if (is_long || (context->trace_id_high != 0))
+		buffer = ot_hex_encode(buffer, context->trace_id_high);
+
+	return ot_hex_encode(buffer, context->trace_id);
+}
+
+
+/***
+ * NAME
+ *   otc_propagation_encode -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *   format   -
+ *   context  -
+ *
+ * DESCRIPTION
+ *   Writes the trace context to the text map, using the wrapper's own
+ *   encoder for the specified header format.  The keys and values are
+ *   duplicated by otc_text_map_add(); if the text map is an arena with
+ *   enough space, no memory is allocated.  The B3 and DataDog headers
+ *   leave out the sampling state if the decision is deferred, but the
+ *   uber-trace-id and traceparent headers always carry it, and a deferred
+ *   decision would be read as 'not sampled'; such a trace context is
+ *   therefore refused for these two formats (unless the debug flag is set,
+ *   which means that the trace is sampled).
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_invalid_span_context if the trace
+ *   context is not valid or cannot be written in the specified format,
+ *   otc_propagation_error_code_success on success.
+ */
+otc_propagation_error_code_t otc_propagation_encode(struct otc_text_map *text_map, otc_propagation_format_t format, const struct otc_trace_context *context)
+{
+	char buffer[128], *ptr = buffer;
+	bool rc = true;
+
+	if (text_map == nullptr)
+		return otc_propagation_error_code_invalid_carrier;
+	else if ((context == nullptr) || ((context->trace_id_high | context->trace_id) == 0) || (context->span_id == 0))
+		return otc_propagation_error_code_invalid_span_context;
+	else if (!OT_CODEC_FORMAT_IS_VALID(format))
+		return otc_propagation_error_code_unknown;
+	else if (((format == otc_propagation_format_jaeger) || (format == otc_propagation_format_w3c)) && ((context->flags & (OTC_TRACE_FLAG_DEFERRED | OTC_TRACE_FLAG_DEBUG)) == OTC_TRACE_FLAG_DEFERRED))
+		return otc_propagation_error_code_invalid_span_context;
+
+	if (format == otc_propagation_format_jaeger) {
+		ptr    = ot_codec_trace_id(ptr, context, false);
+		*ptr++ = ':';
+		ptr    = ot_hex_encode(ptr, context->span_id);
+		*ptr++ = ':';
+		ptr    = ot_hex_encode(ptr, context->parent_span_id);
+		*ptr++ = ':';
+		*ptr++ = '0' + (context->flags & (OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG));
+
+		rc = ot_codec_add(text_map, OT_CODEC_JAEGER, buffer, ptr - buffer);
+	}
+	else if (format == otc_propagation_format_b3) {
+		ptr = ot_codec_trace_id(buffer, context, false);
+		rc  = ot_codec_add(text_map, OT_CODEC_B3_TRACE_ID, buffer, ptr - buffer);
+
+		ptr = ot_hex_encode(buffer, context->span_id);
+		rc  = rc && ot_codec_add(text_map, OT_CODEC_B3_SPAN_ID, buffer, ptr - buffer);
+
+		if (context->parent_span_id != 0) {
+			ptr = ot_hex_encode(buffer, context->parent_span_id);
+			rc  = rc && ot_codec_add(text_map, OT_CODEC_B3_PARENT_SPAN_ID, buffer, ptr - buffer);
+		}
+
+		if (context->flags & OTC_TRACE_FLAG_DEBUG)
+			rc = rc && ot_codec_add(text_map, OT_CODEC_B3_FLAGS, "1", 1);
+		else if (!(context->flags & OTC_TRACE_FLAG_DEFERRED))
+			rc = rc && ot_codec_add(text_map, OT_CODEC_B3_SAMPLED, (context->flags & OTC_TRACE_FLAG_SAMPLED) ? "1" : "0", 1);
+	}
+	else if (format == otc_propagation_format_b3_single) {
+		ptr    = ot_codec_trace_id(ptr, context, false);
+		*ptr++ = '-';
+		ptr    = ot_hex_encode(ptr, context->span_id);
+
+		/* The parent span id can only follow the sampling state. */
+		if (!(context->flags & OTC_TRACE_FLAG_DEFERRED) || (context->flags & OTC_TRACE_FLAG_DEBUG)) {
+			*ptr++ = '-';
+			*ptr++ = (context->flags & OTC_TRACE_FLAG_DEBUG) ? 'd' : ((context->flags & OTC_TRACE_FLAG_SAMPLED) ? '1' : '0');
+
+			if (context->parent_span_id != 0) {
+				*ptr++ = '-';
+				ptr    = ot_hex_encode(ptr, context->parent_span_id);
+			}
+		}
+
+		rc = ot_codec_add(text_map, OT_CODEC_B3_SINGLE, buffer, ptr - buffer);
+	}
+	else if (format == otc_propagation_format_w3c) {
+		*ptr++ = '0';
+		*ptr++ = '0';
+		*ptr++ = '-';
+		ptr    = ot_codec_trace_id(ptr, context, true);
+		*ptr++ = '-';
+		ptr    = ot_hex_encode(ptr, context->span_id);
+		*ptr++ = '-';
+		*ptr++ = '0';
+		*ptr++ = (context->flags & (OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG)) ? '1' : '0';
+
+		rc = ot_codec_add(text_map, OT_CODEC_W3C_TRACEPARENT, buffer, ptr - buffer);
+
+		if ((context->tracestate != nullptr) && (*(context->tracestate) != '\0'))
+			rc = rc && ot_codec_add(text_map, OT_CODEC_W3C_TRACESTATE, context->tracestate, 0);
+	}
+	else if (format == otc_propagation_format_datadog) {
+		(void)snprintf(buffer, sizeof(buffer), "%" PRIu64, context->trace_id);
+		rc = ot_codec_add(text_map, OT_CODEC_DD_TRACE_ID, buffer, 0);
+
+		(void)snprintf(buffer, sizeof(buffer), "%" PRIu64, context->span_id);
+		rc = rc && ot_codec_add(text_map, OT_CODEC_DD_PARENT_ID, buffer, 0);
+
+		if (!(context->flags & OTC_TRACE_FLAG_DEFERRED) || (context->flags & OTC_TRACE_FLAG_DEBUG))
+			rc = rc && ot_codec_add(text_map, OT_CODEC_DD_PRIORITY, (context->flags & OTC_TRACE_FLAG_DEBUG) ? "2" : ((context->flags & OTC_TRACE_FLAG_SAMPLED) ? "1" : "0"), 1);
+	}
+
+	return rc ? otc_propagation_error_code_success : otc_propagation_error_code_unknown;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
@@ -16,7 +16,14 @@
 #include "include.h"
 
 
-static struct otc_dbg_mem *dbg_mem = nullptr;
+static struct otc_dbg_mem       *dbg_mem = nullptr;
+static struct otc_dbg_mem_shard  dbg_mem_shard[DBG_MEM_SHARDS];
+static size_t                    dbg_mem_shards = 0;
+static size_t                    dbg_mem_shard_size = 0;
+static std::atomic<uint32_t>    *dbg_mem_next = nullptr;
+static size_t                    dbg_mem_next_count = 0;
+static std::atomic<size_t>       dbg_mem_threads{0};
+static thread_local size_t       dbg_mem_thread_shard = SIZE_MAX;
 
 
 /***
@@ -46,6 +53,97 @@ static void otc_dbg_set_metadata(void *ptr, struct otc_dbg_mem_data *data)
 }
 
 
+/***
+ * NAME
+ *   otc_dbg_mem_slot_pop -
+ *
+ * ARGUMENTS
+ *   shard -
+ *
+ * DESCRIPTION
+ *   Takes the record from the top of the free record stack of the shard.
+ *
+ * RETURN VALUE
+ *   Returns the index of the record, or DBG_MEM_SLOT_NONE if the stack is
+ *   empty.
+ */
+static uint32_t otc_dbg_mem_slot_pop(struct otc_dbg_mem_shard *shard)
+{
+	uint64_t top = shard->free.load(std::memory_order_acquire);
+
+	while (DBG_MEM_SLOT(top) != DBG_MEM_SLOT_NONE)
+		if (shard->free.compare_exchange_weak(top, DBG_MEM_TAG(top) | dbg_mem_next[DBG_MEM_SLOT(top)].load(std::memory_order_relaxed), std::memory_order_acquire, std::memory_order_acquire))
+			return DBG_MEM_SLOT(top);
+
+	return DBG_MEM_SLOT_NONE;
+}
+
+
+/***
+ * NAME
+ *   otc_dbg_mem_slot_push -
+ *
+ * ARGUMENTS
+ *   idx - the index of the released record
+ *
+ * DESCRIPTION
+ *   Puts the record on the free record stack of the shard to which it
+ *   belongs.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void otc_dbg_mem_slot_push(size_t idx)
+{
+	struct otc_dbg_mem_shard *shard = dbg_mem_shard + std::min(idx / dbg_mem_shard_size, dbg_mem_shards - 1);
+	uint64_t                  top   = shard->free.load(std::memory_order_relaxed);
+
+	do {
+		dbg_mem_next[idx].store(DBG_MEM_SLOT(top), std::memory_order_relaxed);
+	} while (!shard->free.compare_exchange_weak(top, DBG_MEM_TAG_NEXT(top) | idx, std::memory_order_release, std::memory_order_relaxed));
+}
+
+
+/***
+ * NAME
+ *   otc_dbg_mem_slot_get -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Finds a free record, first in the shard of the calling thread and then
+ *   in the other shards.  The threads are assigned to the shards in turn
+ *   when they first allocate memory.
+ *
+ * RETURN VALUE
+ *   Returns the index of the record, or dbg_mem->count if there are no free
+ *   records left.
+ */
+static size_t otc_dbg_mem_slot_get(void)
+{
+	if (dbg_mem_thread_shard == SIZE_MAX)
+		dbg_mem_thread_shard = dbg_mem_threads.fetch_add(1, std::memory_order_relaxed);
+
+	for (size_t n = 0; n < dbg_mem_shards; n++) {
+		struct otc_dbg_mem_shard *shard = dbg_mem_shard + (dbg_mem_thread_shard + n) % dbg_mem_shards;
+		size_t                    idx;
+
+		if (shard->unused.load(std::memory_order_relaxed) < shard->end)
+			if ((idx = shard->unused.fetch_add(1, std::memory_order_relaxed)) < shard->end)
+				return idx;
+
+		if ((idx = otc_dbg_mem_slot_pop(shard)) != DBG_MEM_SLOT_NONE) {
+			(void)__atomic_fetch_add(&(dbg_mem->reused), 1, __ATOMIC_RELAXED);
+
+			return idx;
+		}
+	}
+
+	return dbg_mem->count;
+}
+
+
 /***
  * NAME
  *   otc_dbg_mem_add -
@@ -72,8 +170,8 @@ static void otc_dbg_mem_add(const char *func, int line, void *ptr, size_t size,
 	data->size = size;
 	data->used = 1;
 
-	dbg_mem->size += size;
-	dbg_mem->op_cnt[op_idx]++;
+	(void)__atomic_fetch_add(&(dbg_mem->size), size, __ATOMIC_RELAXED);
+	(void)__atomic_fetch_add(dbg_mem->op_cnt + op_idx, 1, __ATOMIC_RELAXED);
 
 	otc_dbg_set_metadata(ptr, data);
 }
@@ -91,7 +189,9 @@ static void otc_dbg_mem_add(const char *func, int line, void *ptr, size_t size,
  *   size    -
  *
  * DESCRIPTION
- *   -
+ *   Records the allocated memory.  No lock is taken: the record of the
+ *   reallocated memory belongs to the caller, and a new record is taken
+ *   from the shard of the calling thread.
  *
  * RETURN VALUE
  *   This function does not return a value.
@@ -99,7 +199,6 @@ static void otc_dbg_mem_add(const char *func, int line, void *ptr, size_t size,
 static void otc_dbg_mem_alloc(const char *func, int line, void *old_ptr, void *ptr, size_t size)
 {
 	size_t i = 0;
-	int    rc;
 
 	if (dbg_mem == nullptr) {
 		return;
@@ -110,12 +209,6 @@ static void otc_dbg_mem_alloc(const char *func, int line, void *old_ptr, void *p
 		return;
 	}
 
-	if ((rc = pthread_mutex_lock(&(dbg_mem->mutex))) != 0) {
-		DBG_MEM_ERR("cannot lock mutex: %s", otc_strerror(rc));
-
-		return;
-	}
-
 	if (old_ptr != nullptr) {
 		/* Reallocating memory. */
 		struct otc_dbg_mem_metadata *metadata = OT_CAST_TYPEOF(metadata, ptr);
@@ -135,34 +228,13 @@ static void otc_dbg_mem_alloc(const char *func, int line, void *old_ptr, void *p
 		else if (metadata->data->used && (metadata->data->ptr == DBG_MEM_DATA(old_ptr))) {
 			DBG_MEM_INFO(1, "MEM_REALLOC: %s:%d(%p %zu -> %p %zu)", func, line, old_ptr, metadata->data->size, DBG_MEM_PTR(ptr), size);
 
-			dbg_mem->size -= metadata->data->size;
+			(void)__atomic_fetch_sub(&(dbg_mem->size), metadata->data->size, __ATOMIC_RELAXED);
 			otc_dbg_mem_add(func, line, ptr, size, metadata->data, 1);
 		}
 	} else {
 		otc_dbg_set_metadata(ptr, nullptr);
 
-		/*
-		 * The first attempt is to find a location that has not been
-		 * used at all so far.  If such is not found, an attempt is
-		 * made to find the first available location.
-		 */
-		if (dbg_mem->unused < dbg_mem->count) {
-			i = dbg_mem->unused++;
-		} else {
-			do {
-				if (dbg_mem->reused >= dbg_mem->count)
-					dbg_mem->reused = 0;
-
-				if (!dbg_mem->data[dbg_mem->reused].used) {
-					i = dbg_mem->reused++;
-
-					break;
-				}
-
-				dbg_mem->reused++;
-			} while (++i <= dbg_mem->count);
-		}
-
+		i = otc_dbg_mem_slot_get();
 		if (i < dbg_mem->count) {
 			DBG_MEM_INFO(1, "MEM_ALLOC: %s:%d(%p %zu %zu)", func, line, DBG_MEM_PTR(ptr), size, i);
 
@@ -170,12 +242,6 @@ static void otc_dbg_mem_alloc(const char *func, int line, void *old_ptr, void *p
 		}
 	}
 
-	if ((rc = pthread_mutex_unlock(&(dbg_mem->mutex))) != 0) {
-		DBG_MEM_ERR("cannot unlock mutex: %s", otc_strerror(rc));
-
-		return;
-	}
-
 	if (i >= dbg_mem->count)
 		DBG_MEM_ERR("alloc overflow: %s:%d(%p -> %p %zu)", func, line, old_ptr, DBG_MEM_PTR(ptr), size);
 }
@@ -192,7 +258,10 @@ static void otc_dbg_mem_alloc(const char *func, int line, void *old_ptr, void *p
  *   op_idx -
  *
  * DESCRIPTION
- *   -
+ *   Releases the record of the memory and puts it on the free record stack
+ *   of its shard.  The record is marked as unused atomically, so that only
+ *   one of the threads that release the same memory at the same time
+ *   succeeds.
  *
  * RETURN VALUE
  *   This function does not return a value.
@@ -202,7 +271,6 @@ static void otc_dbg_mem_release(const char *func, int line, void *ptr, int op_id
 	struct otc_dbg_mem_metadata *metadata;
 	bool                         flag_invalid = 0;
 	size_t                       i;
-	int                          rc;
 
 	if (dbg_mem == nullptr) {
 		return;
@@ -213,12 +281,6 @@ static void otc_dbg_mem_release(const char *func, int line, void *ptr, int op_id
 		return;
 	}
 
-	if ((rc = pthread_mutex_lock(&(dbg_mem->mutex))) != 0) {
-		DBG_MEM_ERR("cannot lock mutex: %s", otc_strerror(rc));
-
-		return;
-	}
-
 	metadata = DBG_MEM_DATA(ptr);
 	if (metadata == nullptr) {
 		DBG_MEM_ERR("no metadata: MEM_%s %s:%d(%p)", (op_idx == 2) ? "FREE" : "RELEASE", func, line, ptr);
@@ -232,24 +294,18 @@ static void otc_dbg_mem_release(const char *func, int line, void *ptr, int op_id
 	else if (metadata->magic != DBG_MEM_MAGIC) {
 		DBG_MEM_ERR("invalid magic: MEM_%s %s:%d(%p) 0x%016" PRIu64, (op_idx == 2) ? "FREE" : "RELEASE", func, line, ptr, metadata->magic);
 	}
-	else if (metadata->data->used && (metadata->data->ptr == metadata)) {
+	else if ((metadata->data->ptr == metadata) && __atomic_exchange_n(&(metadata->data->used), 0, __ATOMIC_ACQ_REL)) {
 		DBG_MEM_INFO(1, "MEM_%s: %s:%d(%p %zu)", (op_idx == 2) ? "FREE" : "RELEASE", func, line, ptr, metadata->data->size);
 
-		metadata->data->used = 0;
+		(void)__atomic_fetch_sub(&(dbg_mem->size), metadata->data->size, __ATOMIC_RELAXED);
+		(void)__atomic_fetch_add(dbg_mem->op_cnt + op_idx, 1, __ATOMIC_RELAXED);
 
-		dbg_mem->size -= metadata->data->size;
-		dbg_mem->op_cnt[op_idx]++;
+		otc_dbg_mem_slot_push(metadata->data - dbg_mem->data);
 	}
 	else {
 		flag_invalid = 1;
 	}
 
-	if ((rc = pthread_mutex_unlock(&(dbg_mem->mutex))) != 0) {
-		DBG_MEM_ERR("cannot unlock mutex: %s", otc_strerror(rc));
-
-		return;
-	}
-
 	if (flag_invalid) {
 		DBG_MEM_ERR("invalid ptr: %s:%d(%p)", func, line, ptr);
 
@@ -474,31 +530,56 @@ char *otc_dbg_strndup(const char *func, int line, const char *s, size_t size)
  *   level -
  *
  * DESCRIPTION
- *   -
+ *   Initializes the memory tracker.  The array of memory allocation records
+ *   is divided into DBG_MEM_SHARDS shards (or fewer, if there are not enough
+ *   records), so that the threads do not compete for the same records.
+ *   The links of the free record stacks are allocated here and kept for
+ *   the life of the process; they are only replaced by a larger array if
+ *   more records are given.  The tracker is not locked, so this function
+ *   must not be called while other threads allocate or release memory.
  *
  * RETURN VALUE
  *   -
  */
 int otc_dbg_mem_init(struct otc_dbg_mem *mem, struct otc_dbg_mem_data *data, size_t count, uint8_t level)
 {
-	pthread_mutexattr_t attr;
-	int                 rc, retval = -1;
+	int retval = -1;
 
-	if ((mem == nullptr) || (data == nullptr) || (count == 0))
+	if ((mem == nullptr) || (data == nullptr) || !OT_IN_RANGE(count, 1, DBG_MEM_SLOT_NONE - 1))
 		return retval;
 
+	otc_dbg_mem_disable();
+
+	/* The previous array is not released, a late release may still use it. */
+	if (count > dbg_mem_next_count) {
+		std::atomic<uint32_t> *next = new(std::nothrow) std::atomic<uint32_t>[count];
+
+		if (next == nullptr)
+			return retval;
+
+		dbg_mem_next       = next;
+		dbg_mem_next_count = count;
+	}
+
 	(void)memset(mem, 0, sizeof(*mem));
 	(void)memset(data, 0, sizeof(*data) * count);
 
+	dbg_mem_shards     = std::min(count, OT_CAST_STAT(size_t, DBG_MEM_SHARDS));
+	dbg_mem_shard_size = count / dbg_mem_shards;
+
+	for (size_t i = 0; i < dbg_mem_shards; i++) {
+		dbg_mem_shard[i].begin = i * dbg_mem_shard_size;
+		dbg_mem_shard[i].end   = (i == (dbg_mem_shards - 1)) ? count : (dbg_mem_shard[i].begin + dbg_mem_shard_size);
+		dbg_mem_shard[i].unused.store(dbg_mem_shard[i].begin);
+		dbg_mem_shard[i].free.store(DBG_MEM_SLOT_NONE);
+	}
+
 	dbg_mem        = mem;
 	dbg_mem->data  = data;
 	dbg_mem->count = count;
 	dbg_mem->level = level;
 
-	if ((rc = pthread_mutexattr_init(&attr)) == 0)
-		if ((rc = pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE)) == 0)
-			if ((rc = pthread_mutex_init(&(dbg_mem->mutex), &attr)) == 0)
-				retval = 0;
+	retval = 0;
 
 	return retval;
 }
@@ -512,18 +593,15 @@ int otc_dbg_mem_init(struct otc_dbg_mem *mem, struct otc_dbg_mem_data *data, siz
  *   This function takes no arguments.
  *
  * DESCRIPTION
- *   -
+ *   Stops the memory tracker.  The links of the free record stacks are not
+ *   released (see otc_dbg_mem_init()).  Like the initialization, this must
+ *   not be done while other threads allocate or release memory.
  *
  * RETURN VALUE
  *   This function does not return a value.
  */
 void otc_dbg_mem_disable(void)
 {
-	if (dbg_mem == nullptr)
-		return;
-
-	(void)pthread_mutex_destroy(&(dbg_mem->mutex));
-
 	dbg_mem = nullptr;
 }
 
@@ -536,7 +614,9 @@ void otc_dbg_mem_disable(void)
  *   This function takes no arguments.
  *
  * DESCRIPTION
- *   -
+ *   Shows the memory that is still allocated.  The records are read without
+ *   any lock, so the report is exact only if no other thread is allocating
+ *   or releasing memory at the time.
  *
  * RETURN VALUE
  *   This function does not return a value.
@@ -552,9 +632,13 @@ void otc_dbg_mem_info(void)
 	if (dbg_mem == nullptr)
 		return;
 
+	dbg_mem->unused = 0;
+	for (i = 0; i < dbg_mem_shards; i++)
+		dbg_mem->unused += dbg_mem_shard[i].end - std::min(dbg_mem_shard[i].unused.load(), dbg_mem_shard[i].end);
+
 	DBG_MEM_INFO(0, "--- Memory info -------------------------------------");
 	DBG_MEM_INFO(0, "  alloc/realloc: %" PRIu64 "/%" PRIu64 ", free/release: %" PRIu64 "/%" PRIu64, dbg_mem->op_cnt[0], dbg_mem->op_cnt[1], dbg_mem->op_cnt[2], dbg_mem->op_cnt[3]);
-	DBG_MEM_INFO(0, "  unused: %zu, reused: %zu, count: %zu", dbg_mem->unused, dbg_mem->reused, dbg_mem->count);
+	DBG_MEM_INFO(0, "  unused: %zu, reused: %zu, count: %zu, shards: %zu", dbg_mem->unused, dbg_mem->reused, dbg_mem->count, dbg_mem_shards);
 	for (i = 0; i < dbg_mem->count; i++)
 		if (dbg_mem->data[i].used) {
 			DBG_MEM_INFO(0, "  %zu %s(%p %zu)", n, dbg_mem->data[i].func, dbg_mem->data[i].ptr, dbg_mem->data[i].size);
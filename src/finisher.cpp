@@ -0,0 +1,602 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+#ifdef USE_THREADS
+
+/***
+ * NAME
+ *   ot_finisher_data_string -
+ *
+ * ARGUMENTS
+ *   data -
+ *   str  -
+ *
+ * DESCRIPTION
+ *   Copies the string to the string data of the block, or only counts its
+ *   size if the block is not allocated yet.
+ *
+ * RETURN VALUE
+ *   Returns the copy of the string, or nullptr if the block is not allocated.
+ */
+static const char *ot_finisher_data_string(struct otc_finisher_data *data, const char *str)
+{
+	const size_t  len    = strlen(str) + 1;
+	char         *retptr = nullptr;
+
+	if (data->entry != nullptr) {
+		retptr = data->data + data->data_used;
+		(void)memcpy(retptr, str, len);
+	}
+	data->data_used += len;
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_finisher_data_add -
+ *
+ * ARGUMENTS
+ *   data  -
+ *   key   - the key of the tag or the log field, nullptr for the header of
+ *           a log record
+ *   value -
+ *   count - the number of fields of the log record, 0 for the others
+ *
+ * DESCRIPTION
+ *   Adds one entry to the data of the span finished in the background (or
+ *   only counts it).  The key and the string value that is not persistent
+ *   are copied.  The entries with an invalid value type are skipped, as the
+ *   caller has to count the fields of a log record the same way.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void ot_finisher_data_add(struct otc_finisher_data *data, const char *key, const struct otc_value *value, int count)
+{
+	struct otc_span_tag_entry *entry = nullptr;
+
+	if (!OT_IN_RANGE(OT_VALUE_TYPE(value), otc_value_bool, otc_value_null))
+		return;
+
+	if (data->entry != nullptr) {
+		entry        = data->entry + data->num_entries;
+		entry->value = *value;
+		entry->count = count;
+	}
+	data->num_entries++;
+
+	if (key == nullptr) {
+		if (entry != nullptr)
+			entry->key = nullptr;
+	} else {
+		key = ot_finisher_data_string(data, key);
+		if (entry != nullptr)
+			entry->key = key;
+	}
+
+	if ((OT_VALUE_TYPE(value) == otc_value_string) && !(value->type & OTC_VALUE_PERSISTENT) && (value->value.string_value != nullptr)) {
+		const char *str = ot_finisher_data_string(data, value->value.string_value);
+
+		if (entry != nullptr)
+			entry->value.value.string_value = str;
+	}
+}
+
+
+/***
+ * NAME
+ *   ot_finisher_data_log -
+ *
+ * ARGUMENTS
+ *   data       -
+ *   timestamp  - the time of the log record (ns), or 0 if not set
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   Adds one log record to the data of the span finished in the background
+ *   (or only counts it).  The fields without a key or with an invalid value
+ *   type are skipped; a log record without fields is not kept.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void ot_finisher_data_log(struct otc_finisher_data *data, int64_t timestamp, const struct otc_log_field *fields, int num_fields)
+{
+	struct otc_value header;
+	int              count = 0;
+
+	for (int i = 0; i < num_fields; i++)
+		if ((fields[i].key != nullptr) && OT_IN_RANGE(OT_VALUE_TYPE(&(fields[i].value)), otc_value_bool, otc_value_null))
+			count++;
+
+	if (count == 0)
+		return;
+
+	header.type              = otc_value_int64;
+	header.value.int64_value = timestamp;
+	ot_finisher_data_add(data, nullptr, &header, count);
+
+	for (int i = 0; i < num_fields; i++)
+		if (fields[i].key != nullptr)
+			ot_finisher_data_add(data, fields[i].key, &(fields[i].value), 0);
+}
+
+
+/***
+ * NAME
+ *   ot_finisher_data_new -
+ *
+ * ARGUMENTS
+ *   size - the counted entries and string data
+ *
+ * DESCRIPTION
+ *   Allocates the block for the entries and the string data counted in
+ *   size.  The entries are then added with the same calls that counted
+ *   them.
+ *
+ * RETURN VALUE
+ *   Returns the empty data, or nullptr in case of an error.
+ */
+struct otc_finisher_data *ot_finisher_data_new(const struct otc_finisher_data *size)
+{
+	struct otc_finisher_data *retptr;
+
+	retptr = OT_CAST_TYPEOF(retptr, OTC_DBG_MALLOC(sizeof(*retptr) + size->num_entries * sizeof(*(retptr->entry)) + size->data_used));
+	if (retptr != nullptr) {
+		retptr->entry       = OT_CAST_REINTERPRET(struct otc_span_tag_entry *, retptr + 1);
+		retptr->num_entries = 0;
+		retptr->data        = OT_CAST_REINTERPRET(char *, retptr->entry + size->num_entries);
+		retptr->data_used   = 0;
+	}
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_finisher_finish -
+ *
+ * ARGUMENTS
+ *   span        - the span object, detached from its handle
+ *   finish_time -
+ *   data        - the tags and log records to pass to the span, or nullptr
+ *
+ * DESCRIPTION
+ *   Builds the finish options, passes the data to the span object, then
+ *   finishes and deletes it.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_finisher_finish(opentracing::Span *span, std::chrono::steady_clock::time_point finish_time, struct otc_finisher_data *data)
+{
+	std::unique_ptr<opentracing::Span> span_ptr(span);
+	opentracing::FinishSpanOptions     options;
+
+	options.finish_steady_timestamp = finish_time;
+
+	if (data != nullptr) {
+		ot_span_tag_entries_apply(*span, data->entry, data->num_entries, &options);
+
+		OT_FREE(data);
+	}
+
+	span->FinishWithOptions(options);
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::otc_finisher -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+otc_finisher::otc_finisher() : mask(0), policy(otc_finish_policy_block), enabled(false), is_stopping(false), head(0), producers(0), is_sleeping(false), tail(0)
+{
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::~otc_finisher -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Finishes the queued spans and stops the background thread, if the
+ *   application exits without closing the tracer.  The tracer must still
+ *   exist at that time, see the definition of ot_finisher.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+otc_finisher::~otc_finisher()
+{
+	stop();
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::enqueue -
+ *
+ * ARGUMENTS
+ *   span        -
+ *   finish_time -
+ *   data        -
+ *
+ * DESCRIPTION
+ *   Puts the span into the first free slot of the queue.  The producers
+ *   claim the slots by advancing the head of the queue; a slot is free if
+ *   its sequence number equals the position of the head.  The background
+ *   thread is woken up only after every half of the queue is filled, so
+ *   that it finishes the spans in batches instead of being woken up for
+ *   each span.
+ *
+ * RETURN VALUE
+ *   Returns true if the span is queued, false if the queue is full.
+ */
+bool otc_finisher::enqueue(opentracing::Span *span, std::chrono::steady_clock::time_point finish_time, struct otc_finisher_data *data)
+{
+	uint64_t pos = head.load(std::memory_order_relaxed);
+
+	for ( ; ; ) {
+		struct otc_finisher_slot &entry = slot[pos & mask];
+		const int64_t             diff  = OT_CAST_STAT(int64_t, entry.seq.load(std::memory_order_acquire) - pos);
+
+		if (diff == 0) {
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				entry.span        = span;
+				entry.finish_time = finish_time;
+				entry.data        = data;
+				entry.seq.store(pos + 1, std::memory_order_release);
+
+				if ((pos & (mask >> 1)) == 0)
+					wake();
+
+				return true;
+			}
+		}
+		else if (diff < 0) {
+			return false;
+		}
+		else {
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::wake -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Wakes up the background thread, if it is sleeping.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_finisher::wake(void)
+{
+	if (is_sleeping.load() && is_sleeping.exchange(false)) {
+		const std::lock_guard<std::mutex> guard(mutex);
+
+		cond.notify_one();
+	}
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::dequeue -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Takes the span from the tail of the queue and finishes it.  The slot is
+ *   returned to the producers before the span is finished, so that they do
+ *   not have to wait for the tracer.  Called only by the background thread.
+ *
+ * RETURN VALUE
+ *   Returns true if a span was finished, false if the queue is empty.
+ */
+bool otc_finisher::dequeue(void)
+{
+	struct otc_finisher_slot &entry = slot[tail & mask];
+
+	if (entry.seq.load(std::memory_order_acquire) != (tail + 1))
+		return false;
+
+	opentracing::Span                     *span        = entry.span;
+	std::chrono::steady_clock::time_point  finish_time = entry.finish_time;
+	struct otc_finisher_data              *data        = entry.data;
+
+	entry.seq.store(tail + mask + 1, std::memory_order_release);
+	tail++;
+
+	ot_finisher_finish(span, finish_time, data);
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::run -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   The background thread.  It finishes the queued spans and sleeps when
+ *   the queue is empty, until a producer wakes it up or at most for
+ *   OT_FINISHER_SLEEP_MS milliseconds.  When stopped, it finishes all the
+ *   spans left in the queue before it exits.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_finisher::run(void)
+{
+	for ( ; ; ) {
+		if (dequeue())
+			continue;
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if (is_stopping)
+			break;
+
+		is_sleeping.store(true);
+		if (slot[tail & mask].seq.load() != (tail + 1))
+			(void)cond.wait_for(lock, std::chrono::milliseconds(OT_FINISHER_SLEEP_MS));
+		is_sleeping.store(false, std::memory_order_relaxed);
+	}
+
+	while (dequeue());
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::start -
+ *
+ * ARGUMENTS
+ *   size          - the number of spans that can be queued
+ *   finish_policy - what to do when the queue is full
+ *
+ * DESCRIPTION
+ *   Starts the background thread, after stopping the one that may already
+ *   be running.  The queue size is rounded up to a power of 2.  Must not be
+ *   called concurrently with stop().
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 in case of an error.
+ */
+int otc_finisher::start(int size, otc_finish_policy_t finish_policy)
+{
+	uint64_t n = 2;
+
+	stop();
+
+	while (n < OT_CAST_STAT(uint64_t, size))
+		n <<= 1;
+
+	slot.reset(new(std::nothrow) struct otc_finisher_slot[n]);
+	if (slot == nullptr)
+		return -1;
+
+	for (uint64_t i = 0; i < n; i++)
+		slot[i].seq.store(i, std::memory_order_relaxed);
+
+	mask        = n - 1;
+	policy      = finish_policy;
+	is_stopping = false;
+	head.store(0, std::memory_order_relaxed);
+	tail        = 0;
+
+	try {
+		thread = std::thread(&otc_finisher::run, this);
+	}
+	catch (...) {
+		slot.reset();
+
+		return -1;
+	}
+
+	enabled.store(true);
+
+	return 0;
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::stop -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Stops the background thread.  The spans finished from now on are
+ *   finished synchronously; the spans that are already queued are finished
+ *   by the background thread before it exits.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_finisher::stop(void)
+{
+	if (!thread.joinable())
+		return;
+
+	/* Wait for the producers that saw the finisher enabled. */
+	enabled.store(false);
+	while (producers.load() > 0)
+		std::this_thread::yield();
+
+	{
+		const std::lock_guard<std::mutex> guard(mutex);
+
+		is_stopping = true;
+	}
+
+	cond.notify_one();
+	thread.join();
+	slot.reset();
+}
+
+
+/***
+ * NAME
+ *   otc_finisher::push -
+ *
+ * ARGUMENTS
+ *   span        - the span object, detached from its handle
+ *   finish_time -
+ *   data        - the tags and log records to pass to the span, or nullptr
+ *
+ * DESCRIPTION
+ *   Passes the span to the background thread, which builds the finish
+ *   options, finishes and deletes it; the finisher takes the ownership of
+ *   the span object and its data.  Must not be called with a lock held, as
+ *   with the block policy it waits for the queue.  If the queue
+ *   is full, the calling thread waits for a free slot, or the span is
+ *   deleted without its finish function being called, depending on the
+ *   policy.  Whether such a span is reported depends on the destructor of
+ *   the tracer's span.  If the finisher has been stopped in the meantime,
+ *   the span is finished synchronously.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_finisher::push(opentracing::Span *span, std::chrono::steady_clock::time_point finish_time, struct otc_finisher_data *data)
+{
+	bool is_queued;
+
+	producers.fetch_add(1);
+	if (!enabled.load()) {
+		producers.fetch_sub(1, std::memory_order_release);
+
+		ot_finisher_finish(span, finish_time, data);
+
+		return;
+	}
+
+	while (!(is_queued = enqueue(span, finish_time, data)) && (policy == otc_finish_policy_block)) {
+		wake();
+
+		std::this_thread::yield();
+	}
+
+	producers.fetch_sub(1, std::memory_order_release);
+
+	if (is_queued) {
+		OT_STAT_INC(FINISH_ASYNC);
+	} else {
+		/*
+		 * The tracer may still finish and report the span from its
+		 * destructor, this thread then pays for it.
+		 */
+		OT_STAT_INC(FINISH_DELETED);
+
+		OT_FREE(data);
+		delete span;
+	}
+}
+
+#endif /* USE_THREADS */
+
+
+/***
+ * NAME
+ *   otc_tracer_finish_async -
+ *
+ * ARGUMENTS
+ *   queue_size - the number of spans that can wait to be finished, or 0 to
+ *                finish the spans synchronously
+ *   policy     - what to do with a span when the queue is full
+ *
+ * DESCRIPTION
+ *   Moves the work of finishing the spans (building the finish options and
+ *   the log records, calling the finish function of the tracer and deleting
+ *   the span object) to a background thread.  The thread that finishes a
+ *   span only copies its tags and log records, removes the span from its
+ *   handle table and puts it into the queue, without holding the lock of
+ *   the span.  If the
+ *   finish time is not set, the span is finished with the time at which
+ *   it was queued.  The tracer close function waits until all the queued
+ *   spans are finished.
+ *
+ *   With the otc_finish_policy_drop policy, a span that does not fit into
+ *   the full queue is deleted by the calling thread without its finish
+ *   function being called.  The OpenTracing API has no way to discard a
+ *   span, so what happens next depends on the tracer: some tracers (the
+ *   mocktracer and zipkin, for example) finish the span in its destructor
+ *   and still report it, synchronously, in the calling thread; others do
+ *   not report it at all.  otc_statistics() counts such spans as deleted.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 if the arguments are not valid, the
+ *   background thread cannot be started or the library is built without
+ *   the thread support.
+ */
+int otc_tracer_finish_async(int queue_size, otc_finish_policy_t policy)
+{
+#ifdef USE_THREADS
+	if ((queue_size < 0) || !OT_IN_RANGE(policy, otc_finish_policy_block, otc_finish_policy_drop))
+		return -1;
+	else if (queue_size == 0)
+		ot_finisher.stop();
+	else
+		return ot_finisher.start(queue_size, policy);
+
+	return 0;
+#else
+	(void)queue_size;
+	(void)policy;
+
+	return -1;
+#endif
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
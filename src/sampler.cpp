@@ -0,0 +1,266 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+static std::atomic<int>          ot_sampler_type(otc_sampler_none);
+static std::atomic<bool>         ot_sampler_parent_based(false);
+static std::atomic<uint64_t>     ot_sampler_threshold(0);
+static std::atomic<int64_t>      ot_sampler_interval_ns(0);
+static struct otc_sampler_bucket ot_sampler_bucket[OT_SAMPLER_BUCKETS];
+static thread_local uint64_t     ot_sampler_random = 0;
+
+
+/***
+ * NAME
+ *   ot_sampler_rand -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   A xorshift64* pseudo-random number generator, with the state kept
+ *   per thread.  The state is seeded with the clock and the address of
+ *   the state on the first call in the thread.
+ *
+ * RETURN VALUE
+ *   Returns a 64-bit pseudo-random number.
+ */
+uint64_t ot_sampler_rand(void)
+{
+	uint64_t x = ot_sampler_random;
+
+	if (x == 0) {
+		x  = OT_CAST_STAT(uint64_t, std::chrono::steady_clock::now().time_since_epoch().count());
+		x ^= OT_CAST_REINTERPRET(uintptr_t, &ot_sampler_random) * UINT64_C(0x9e3779b97f4a7c15);
+		if (x == 0)
+			x = UINT64_C(0x9e3779b97f4a7c15);
+	}
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+
+	ot_sampler_random = x;
+
+	return x * UINT64_C(0x2545f4914f6cdd1d);
+}
+
+
+/***
+ * NAME
+ *   ot_sampler_rate_limit -
+ *
+ * ARGUMENTS
+ *   hash - the hash of the operation name
+ *
+ * DESCRIPTION
+ *   Rate limiting with the generic cell rate algorithm: the spans of the
+ *   same operation name are sampled at most once per interval, with a
+ *   burst of up to one second worth of spans.  The operation names are
+ *   hashed into OT_SAMPLER_BUCKETS buckets; names that fall into the same
+ *   bucket share its rate.
+ *
+ * RETURN VALUE
+ *   Returns true if the span is sampled, false otherwise.
+ */
+static bool ot_sampler_rate_limit(uint64_t hash)
+{
+	const int64_t              interval_ns = ot_sampler_interval_ns.load(std::memory_order_relaxed);
+	const int64_t              burst_ns    = std::max(INT64_C(1000000000) - interval_ns, INT64_C(0));
+	struct otc_sampler_bucket &bucket      = ot_sampler_bucket[hash % OT_SAMPLER_BUCKETS];
+	int64_t                    now_ns, due_ns;
+
+	if (interval_ns <= 0)
+		return false;
+
+	now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	due_ns = bucket.due_ns.load(std::memory_order_relaxed);
+
+	do {
+		if ((due_ns - now_ns) > burst_ns)
+			return false;
+	} while (!bucket.due_ns.compare_exchange_weak(due_ns, std::max(due_ns, now_ns) + interval_ns, std::memory_order_relaxed));
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_sampler_is_sampled -
+ *
+ * ARGUMENTS
+ *   operation_name -
+ *   hash           - the hash of the operation name, or 0 if it is not
+ *                    known yet (it is computed only if needed)
+ *   options        -
+ *
+ * DESCRIPTION
+ *   Makes the sampling decision for a new span, before anything is
+ *   allocated for it.  With the parent-based sampling the span follows the
+ *   decision made for the spans it references: it is not sampled if it
+ *   references only no-op spans, and it is always sampled if it references
+ *   a sampled span or an extracted span context.  An extracted span
+ *   context whose header says that it is not sampled is a no-op span
+ *   context (see ot_sampler_is_sampled_parent()).  Spans without
+ *   references are sampled by the configured sampler.
+ *
+ * RETURN VALUE
+ *   Returns true if the span is sampled, false otherwise.
+ */
+bool ot_sampler_is_sampled(opentracing::string_view operation_name, uint64_t hash, const struct otc_start_span_options *options)
+{
+	const int type = ot_sampler_type.load(std::memory_order_relaxed);
+
+	if ((options != nullptr) && (options->references != nullptr) && ot_sampler_parent_based.load(std::memory_order_relaxed)) {
+		bool is_noop = false;
+
+		for (int i = 0; i < options->num_references; i++)
+			if (options->references[i].referenced_context == nullptr)
+				/* Do nothing. */;
+			else if (OT_CTX_IS_NOOP(options->references[i].referenced_context))
+				is_noop = true;
+			else
+				return true;
+
+		if (is_noop)
+			return false;
+	}
+
+	if (type == otc_sampler_probabilistic) {
+		const uint64_t threshold = ot_sampler_threshold.load(std::memory_order_relaxed);
+
+		return (threshold == UINT64_MAX) || (ot_sampler_rand() < threshold);
+	}
+	else if (type == otc_sampler_rate_limiting) {
+		return ot_sampler_rate_limit((hash == 0) ? ot_atom_hash(operation_name.data(), operation_name.size()) : hash);
+	}
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_sampler_is_sampled_parent -
+ *
+ * ARGUMENTS
+ *   context - the trace context decoded from the carrier
+ *
+ * DESCRIPTION
+ *   With the parent-based sampling, the span context extracted from a
+ *   carrier follows the sampling decision found in the trace context
+ *   headers, if the decoder of the wrapper has read them (which is done
+ *   only if the header format is set with otc_tracer_propagation_format()).
+ *   The decision is followed only if it is explicit: a trace context
+ *   without the sampling state is sampled.
+ *
+ * RETURN VALUE
+ *   Returns false if the extracted span context is not sampled, true
+ *   otherwise.
+ */
+bool ot_sampler_is_sampled_parent(const struct otc_trace_context *context)
+{
+	if (!ot_sampler_parent_based.load(std::memory_order_relaxed))
+		return true;
+
+	return (context->flags & (OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG | OTC_TRACE_FLAG_DEFERRED)) != 0;
+}
+
+
+/***
+ * NAME
+ *   ot_sampler_is_set -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns true if the sampler of the wrapper can return no-op spans,
+ *   false otherwise.
+ */
+bool ot_sampler_is_set(void)
+{
+	return (ot_sampler_type.load(std::memory_order_relaxed) != otc_sampler_none) || ot_sampler_parent_based.load(std::memory_order_relaxed);
+}
+
+
+/***
+ * NAME
+ *   otc_tracer_sampler -
+ *
+ * ARGUMENTS
+ *   type         - the sampler type
+ *   param        - the sampling probability (0 to 1) for the probabilistic
+ *                  sampler, or the number of spans per second for the rate
+ *                  limiting sampler
+ *   parent_based - the spans that reference other spans follow their
+ *                  sampling decision
+ *
+ * DESCRIPTION
+ *   Sets the sampler of the wrapper.  The spans that are not sampled are
+ *   not passed to the tracer; instead, the start span functions return a
+ *   no-op span, whose operations do nothing.  Its span context is
+ *   injected by the wrapper's own encoder as not sampled, so that the next
+ *   service does not sample it either; that is why the header format must
+ *   be set with otc_tracer_propagation_format() before the sampler.  The
+ *   no-op span of a trace that was extracted as not sampled keeps its
+ *   trace id.  The sampler runs in addition to the sampler of the tracer,
+ *   which only sees the sampled spans.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 if the arguments are not valid or if the
+ *   header format is not set.
+ */
+int otc_tracer_sampler(otc_sampler_type_t type, double param, bool parent_based)
+{
+	if (((type != otc_sampler_none) || parent_based) && (ot_tracer_propagation_format() == otc_propagation_format_none))
+		return -1;
+
+	if (type == otc_sampler_probabilistic) {
+		if (!OT_IN_RANGE(param, 0.0, 1.0))
+			return -1;
+
+		ot_sampler_threshold.store((param >= 1.0) ? UINT64_MAX : OT_CAST_STAT(uint64_t, param * 18446744073709551616.0), std::memory_order_relaxed);
+	}
+	else if (type == otc_sampler_rate_limiting) {
+		if (!(param >= 0.0) || (param > 1e9))
+			return -1;
+
+		ot_sampler_interval_ns.store((param > 0.0) ? OT_CAST_STAT(int64_t, std::max(std::min(1e9 / param, 1e18), 1.0)) : 0, std::memory_order_relaxed);
+	}
+	else if (type != otc_sampler_none) {
+		return -1;
+	}
+
+	ot_sampler_parent_based.store(parent_based, std::memory_order_relaxed);
+	ot_sampler_type.store(type, std::memory_order_relaxed);
+
+	return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
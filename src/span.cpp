@@ -17,23 +17,1426 @@
 
 
 #ifdef OT_THREADS_NO_LOCKING
-thread_local Handle<opentracing::Span>        ot_span_handle;
-thread_local Handle<opentracing::SpanContext> ot_span_context_handle;
-struct HandleData                             ot_span;
-struct HandleData                             ot_span_context;
+struct HandleData<opentracing::Span>               ot_span;
+struct HandleData<opentracing::SpanContext>        ot_span_context;
+thread_local HandleLocal<opentracing::Span>        ot_span_handle_tl(ot_span);
+thread_local HandleLocal<opentracing::SpanContext> ot_span_context_handle_tl(ot_span_context);
 #else
-struct Handle<opentracing::Span>              ot_span;
-struct Handle<opentracing::SpanContext>       ot_span_context;
+struct Handle<opentracing::Span>                   ot_span;
+struct Handle<opentracing::SpanContext>            ot_span_context;
 #endif /* OT_THREADS_NO_LOCKING */
+#if OT_TAG_BUFFER > 0
+static thread_local otc_pool                       ot_span_pool(sizeof(struct otc_span_buffered), OT_STAT_SPAN_POOL_HIT, OT_STAT_SPAN_POOL_MISS, OT_STAT_MEM_SPAN);
+#else
+static thread_local otc_pool                       ot_span_pool(sizeof(struct otc_span), OT_STAT_SPAN_POOL_HIT, OT_STAT_SPAN_POOL_MISS, OT_STAT_MEM_SPAN);
+#endif
+static thread_local otc_pool                       ot_span_context_pool(sizeof(struct otc_span_context), OT_STAT_CTX_POOL_HIT, OT_STAT_CTX_POOL_MISS, OT_STAT_MEM_CTX);
+static thread_local std::vector<std::pair<opentracing::string_view, opentracing::Value>> ot_log_fields;
+#if OT_TAG_BUFFER > 0
+static thread_local std::vector<struct otc_log_field> ot_log_fields_atom;
+#endif
+
+
+#ifndef OT_THREADS_NO_LOCKING
+/***
+ * NAME
+ *   Handle<T>::Handle -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   The constructor of the sharded handle table.  It is defined here, out
+ *   of line, because it constructs all the shards and there is no point in
+ *   inlining it into the initialization of the handle tables.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+template<typename T> Handle<T>::Handle() : key(0)
+{
+}
+#endif /* OT_THREADS_NO_LOCKING */
+
+
+/***
+ * NAME
+ *   ot_nolock_span_log_fields -
+ *
+ * ARGUMENTS
+ *   span_obj   -
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   Adds one log entry with the given fields to the span.  The number of
+ *   fields is not limited, and the fields with an invalid value type are
+ *   skipped.  The field list is kept per thread, so after the first few
+ *   calls no memory is allocated for it.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_nolock_span_log_fields(opentracing::Span &span_obj, const struct otc_log_field *fields, int num_fields)
+{
+	ot_log_fields.clear();
+
+	for (int i = 0; i < num_fields; i++) {
+		opentracing::Value field_value;
+
+		if (ot_value_set(field_value, &(fields[i].value)))
+			ot_log_fields.emplace_back(fields[i].key, std::move(field_value));
+	}
+
+	if (!ot_log_fields.empty())
+		span_obj.Log(ot_clock_system(), ot_log_fields);
+
+	ot_log_fields.clear();
+}
+
+
+/***
+ * NAME
+ *   ot_nolock_span_set_tags -
+ *
+ * ARGUMENTS
+ *   span_obj -
+ *   tags     -
+ *   num_tags -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_nolock_span_set_tags(opentracing::Span &span_obj, const struct otc_tag *tags, int num_tags)
+{
+	opentracing::Value tag_value;
+
+	for (int i = 0; i < num_tags; i++)
+		if ((tags[i].key != nullptr) && ot_value_set(tag_value, &(tags[i].value)))
+			span_obj.SetTag(tags[i].key, tag_value);
+}
+
+
+/***
+ * NAME
+ *   ot_span_tag_entries_apply -
+ *
+ * ARGUMENTS
+ *   span_obj     -
+ *   entry        - the tags and log records, in the format of the tag buffer
+ *   num_entries  -
+ *   span_options - the finish options, or nullptr
+ *
+ * DESCRIPTION
+ *   Passes the tags and log records to the span object, in the order in
+ *   which they are given.  The tags are set one by one; the log records are
+ *   added to the finish options if they are given, otherwise they are
+ *   logged to the span object with their timestamps.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void ot_span_tag_entries_apply(opentracing::Span &span_obj, const struct otc_span_tag_entry *entry, int num_entries, struct opentracing::FinishSpanOptions *span_options)
+{
+	for (int i = 0; i < num_entries; i++) {
+		const struct otc_span_tag_entry *header = entry + i;
+		opentracing::Value               value;
+
+		if (header->key != nullptr) {
+			if (ot_value_set(value, &(header->value)))
+				span_obj.SetTag(header->key, value);
+
+			continue;
+		}
+
+		const opentracing::SystemTime timestamp(std::chrono::duration_cast<opentracing::SystemClock::duration>(std::chrono::nanoseconds(header->value.value.int64_value)));
+
+		if (span_options != nullptr) {
+			struct opentracing::LogRecord record;
+
+			if (header->value.value.int64_value != 0)
+				record.timestamp = timestamp;
+			for (int j = 1; j <= header->count; j++)
+				if (ot_value_set(value, &(header[j].value)))
+					record.fields.emplace_back(header[j].key, std::move(value));
+
+			span_options->log_records.push_back(std::move(record));
+		} else {
+			ot_log_fields.clear();
+			for (int j = 1; j <= header->count; j++)
+				if (ot_value_set(value, &(header[j].value)))
+					ot_log_fields.emplace_back(header[j].key, std::move(value));
+
+			span_obj.Log(timestamp, ot_log_fields);
+			ot_log_fields.clear();
+		}
+
+		i += header->count;
+	}
+}
+
+
+#if OT_TAG_BUFFER > 0
+
+/***
+ * NAME
+ *   ot_span_buffer_string -
+ *
+ * ARGUMENTS
+ *   buffered -
+ *   str      -
+ *
+ * DESCRIPTION
+ *   Copies the string to the data area of the tag buffer.
+ *
+ * RETURN VALUE
+ *   Returns the copy of the string, or nullptr if there is not enough room
+ *   for it.
+ */
+static const char *ot_span_buffer_string(struct otc_span_buffered *buffered, const char *str)
+{
+	const size_t  len = strlen(str) + 1;
+	char         *retptr;
+
+	if (len > (sizeof(buffered->data) - buffered->data_used))
+		return nullptr;
+
+	retptr = buffered->data + buffered->data_used;
+	(void)memcpy(retptr, str, len);
+	buffered->data_used += len;
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_span_buffer_add -
+ *
+ * ARGUMENTS
+ *   buffered -
+ *   key      -
+ *   value    -
+ *
+ * DESCRIPTION
+ *   Adds one entry to the tag buffer.  The key and the string value that is
+ *   not persistent are copied to the data area of the buffer; if the entry
+ *   does not fit, the buffer is left partially changed and the caller must
+ *   restore it.
+ *
+ * RETURN VALUE
+ *   Returns true if the entry is added, false if there is no room for it.
+ */
+static bool ot_span_buffer_add(struct otc_span_buffered *buffered, const char *key, const struct otc_value *value)
+{
+	struct otc_span_tag_entry *entry;
+
+	if (buffered->num_entries >= OT_TAG_BUFFER)
+		return false;
+
+	entry = buffered->entry + buffered->num_entries;
+	if ((entry->key = ot_span_buffer_string(buffered, key)) == nullptr)
+		return false;
+
+	entry->value = *value;
+	entry->count = 0;
+
+	if ((OT_VALUE_TYPE(value) == otc_value_string) && !(value->type & OTC_VALUE_PERSISTENT) && (value->value.string_value != nullptr))
+		if ((entry->value.value.string_value = ot_span_buffer_string(buffered, value->value.string_value)) == nullptr)
+			return false;
+
+	buffered->num_entries++;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_span_buffer_tags -
+ *
+ * ARGUMENTS
+ *   buffered -
+ *   tags     -
+ *   num_tags -
+ *
+ * DESCRIPTION
+ *   Adds the tags to the tag buffer, either all of them or none.  The tags
+ *   without a key or with an invalid value type are skipped.
+ *
+ * RETURN VALUE
+ *   Returns true if the tags are added, false if there is no room for them.
+ */
+static bool ot_span_buffer_tags(struct otc_span_buffered *buffered, const struct otc_tag *tags, int num_tags)
+{
+	const int    num_entries = buffered->num_entries;
+	const size_t data_used   = buffered->data_used;
+
+	for (int i = 0; i < num_tags; i++)
+		if ((tags[i].key == nullptr) || !OT_IN_RANGE(OT_VALUE_TYPE(&(tags[i].value)), otc_value_bool, otc_value_null))
+			/* Do nothing. */;
+		else if (!ot_span_buffer_add(buffered, tags[i].key, &(tags[i].value))) {
+			buffered->num_entries = num_entries;
+			buffered->data_used   = data_used;
+
+			return false;
+		}
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_span_buffer_log -
+ *
+ * ARGUMENTS
+ *   buffered   -
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   Adds one log record with the current time to the tag buffer, either
+ *   with all its fields or not at all.  The fields with an invalid value
+ *   type are skipped.
+ *
+ * RETURN VALUE
+ *   Returns true if the log record is added, false if there is no room for
+ *   it.
+ */
+static bool ot_span_buffer_log(struct otc_span_buffered *buffered, const struct otc_log_field *fields, int num_fields)
+{
+	const int                  num_entries = buffered->num_entries;
+	const size_t               data_used   = buffered->data_used;
+	struct otc_span_tag_entry *header;
+
+	if (buffered->num_entries >= OT_TAG_BUFFER)
+		return false;
+
+	header                          = buffered->entry + buffered->num_entries++;
+	header->key                     = nullptr;
+	header->value.type              = otc_value_int64;
+	header->value.value.int64_value = std::chrono::duration_cast<std::chrono::nanoseconds>(ot_clock_system().time_since_epoch()).count();
+	header->count                   = 0;
+
+	for (int i = 0; i < num_fields; i++)
+		if ((fields[i].key == nullptr) || !OT_IN_RANGE(OT_VALUE_TYPE(&(fields[i].value)), otc_value_bool, otc_value_null))
+			/* Do nothing. */;
+		else if (ot_span_buffer_add(buffered, fields[i].key, &(fields[i].value)))
+			header->count++;
+		else {
+			buffered->num_entries = num_entries;
+			buffered->data_used   = data_used;
+
+			return false;
+		}
+
+	/* A log record without fields is not kept. */
+	if (header->count == 0)
+		buffered->num_entries = num_entries;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_nolock_span_buffer_flush -
+ *
+ * ARGUMENTS
+ *   span         -
+ *   span_options - the finish options, or nullptr
+ *
+ * DESCRIPTION
+ *   Passes the content of the tag buffer to the span object, in the order
+ *   in which it was added, and empties the buffer.  The tags are set one by
+ *   one; the log records are added to the finish options if they are given
+ *   (when the span is finished), otherwise they are logged to the span
+ *   object with their original timestamps.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_nolock_span_buffer_flush(struct otc_span *span, struct opentracing::FinishSpanOptions *span_options)
+{
+	struct otc_span_buffered *buffered = OT_SPAN_BUFFERED(span);
+
+	ot_span_tag_entries_apply(OT_SPAN_OBJ(span), buffered->entry, buffered->num_entries, span_options);
+
+	buffered->num_entries = 0;
+	buffered->data_used   = 0;
+}
+
+
+/***
+ * NAME
+ *   ot_span_buffer_set_tags -
+ *
+ * ARGUMENTS
+ *   span     -
+ *   tags     -
+ *   num_tags -
+ *
+ * DESCRIPTION
+ *   Adds the tags to the tag buffer of the span, without locking.  When the
+ *   buffer is full, it is flushed to the span object first; the tags that
+ *   do not fit even in the empty buffer are set directly.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_buffer_set_tags(struct otc_span *span, const struct otc_tag *tags, int num_tags)
+{
+	if (ot_span_buffer_tags(OT_SPAN_BUFFERED(span), tags, num_tags))
+		return;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	ot_nolock_span_buffer_flush(span, nullptr);
+	if (!ot_span_buffer_tags(OT_SPAN_BUFFERED(span), tags, num_tags))
+		ot_nolock_span_set_tags(OT_SPAN_OBJ(span), tags, num_tags);
+}
+
+
+/***
+ * NAME
+ *   ot_span_buffer_log_fields -
+ *
+ * ARGUMENTS
+ *   span       -
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   Adds one log record to the tag buffer of the span, the same way as
+ *   ot_span_buffer_set_tags() adds the tags.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_buffer_log_fields(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
+{
+	if (ot_span_buffer_log(OT_SPAN_BUFFERED(span), fields, num_fields))
+		return;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	ot_nolock_span_buffer_flush(span, nullptr);
+	if (!ot_span_buffer_log(OT_SPAN_BUFFERED(span), fields, num_fields))
+		ot_nolock_span_log_fields(OT_SPAN_OBJ(span), fields, num_fields);
+}
+
+#endif /* OT_TAG_BUFFER > 0 */
+
+
+/***
+ * NAME
+ *   ot_nolock_span_finish -
+ *
+ * ARGUMENTS
+ *   span         -
+ *   span_options -
+ *
+ * DESCRIPTION
+ *   Finishes the span object of the span, which is then destroyed.  If the
+ *   finish time is not set, it is taken from the clock source selected with
+ *   otc_tracer_clock().
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_nolock_span_finish(struct otc_span *span, struct opentracing::FinishSpanOptions &span_options)
+{
+#if OT_TAG_BUFFER > 0
+	ot_nolock_span_buffer_flush(span, &span_options);
+
+#endif
+	if ((span_options.finish_steady_timestamp == std::chrono::time_point<std::chrono::steady_clock>()) && ot_clock_is_set())
+		span_options.finish_steady_timestamp = ot_clock_steady();
+
+	OT_SPAN_PTR(span)->FinishWithOptions(span_options);
+
+	ot_nolock_span_destroy(&span);
+}
+
+
+#ifdef USE_THREADS
+
+/***
+ * NAME
+ *   ot_nolock_span_finish_data -
+ *
+ * ARGUMENTS
+ *   data       - the data to fill, or to count only
+ *   span       -
+ *   tags       -
+ *   num_tags   -
+ *   fields     -
+ *   num_fields -
+ *   timestamp  - the time of the log fields (ns)
+ *   options    -
+ *
+ * DESCRIPTION
+ *   Adds the content of the tag buffer, the tags, the log fields and the
+ *   log records of the finish options to the data of the span that is
+ *   finished in the background, in that order.  Called twice: first to
+ *   count the data, then to copy it.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_nolock_span_finish_data(struct otc_finisher_data *data, struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields, int64_t timestamp, const struct otc_finish_span_options *options)
+{
+#if OT_TAG_BUFFER > 0
+	const struct otc_span_buffered *buffered = OT_SPAN_BUFFERED(span);
+
+	for (int i = 0; i < buffered->num_entries; i++)
+		ot_finisher_data_add(data, buffered->entry[i].key, &(buffered->entry[i].value), buffered->entry[i].count);
+#else
+	(void)span;
+#endif
+
+	for (int i = 0; i < num_tags; i++)
+		if (tags[i].key != nullptr)
+			ot_finisher_data_add(data, tags[i].key, &(tags[i].value), 0);
+
+	ot_finisher_data_log(data, timestamp, fields, num_fields);
+
+	if ((options != nullptr) && (options->log_records != nullptr))
+		for (int i = 0; i < options->num_log_records; i++) {
+			const struct timespec *ts = &(options->log_records[i].timestamp.value);
+
+			ot_finisher_data_log(data, (ts->tv_sec > 0) ? (OT_CAST_STAT(int64_t, ts->tv_sec) * 1000000000 + ts->tv_nsec) : 0, options->log_records[i].fields, options->log_records[i].num_fields);
+		}
+}
+
+
+/***
+ * NAME
+ *   ot_span_finish_async -
+ *
+ * ARGUMENTS
+ *   span       -
+ *   tags       -
+ *   num_tags   -
+ *   fields     -
+ *   num_fields -
+ *   options    -
+ *
+ * DESCRIPTION
+ *   Hands the span over to the background thread.  Under the lock of the
+ *   span, only the content of the tag buffer and the given tags, log fields
+ *   and log records are copied to one block, and the span object is
+ *   detached from the span, which is then destroyed.  The finish options
+ *   are built and the tags and log records are passed to the span object
+ *   by the background thread.  The span object is queued after the lock is
+ *   released, so that waiting for room in the queue does not stall the
+ *   other spans of the same shard.
+ *
+ * RETURN VALUE
+ *   Returns true if the span is handed over, false if the data cannot be
+ *   allocated (the span is then left untouched).
+ */
+static bool ot_span_finish_async(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields, const struct otc_finish_span_options *options)
+{
+	struct otc_finisher_data               size = { nullptr, 0, nullptr, 0 }, *data = nullptr;
+	std::chrono::steady_clock::time_point  finish_time;
+	opentracing::Span                     *span_ptr;
+	int64_t                                timestamp = 0;
+
+	if ((options != nullptr) && (options->finish_time.value.tv_sec > 0))
+		finish_time = std::chrono::steady_clock::time_point(timespec_to_duration(&(options->finish_time.value)));
+	else
+		finish_time = ot_clock_is_set() ? ot_clock_steady() : std::chrono::steady_clock::now();
+
+	if ((fields != nullptr) && (num_fields > 0))
+		timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(ot_clock_system().time_since_epoch()).count();
+	else
+		num_fields = 0;
+	if ((tags == nullptr) || (num_tags <= 0))
+		num_tags = 0;
+
+	{
+		OT_SPAN_LOCK_GUARD(span);
+
+		ot_nolock_span_finish_data(&size, span, tags, num_tags, fields, num_fields, timestamp, options);
+		if (size.num_entries > 0) {
+			if ((data = ot_finisher_data_new(&size)) == nullptr)
+				return false;
+
+			ot_nolock_span_finish_data(data, span, tags, num_tags, fields, num_fields, timestamp, options);
+		}
+
+#  ifdef OT_DIRECT_SPANS
+		span_ptr     = OT_SPAN_PTR(span);
+		span->handle = nullptr;
+
+		OT_STAT_INC(SPAN_ERASE);
+#  else
+		span_ptr = OT_SPAN_PTR(span).release();
+#  endif
+
+		ot_nolock_span_destroy(&span);
+	}
+
+	ot_finisher.push(span_ptr, finish_time, data);
+
+	return true;
+}
+
+#endif /* USE_THREADS */
+
+
+/***
+ * NAME
+ *   ot_span_finish_with_options -
+ *
+ * ARGUMENTS
+ *   span    -
+ *   options -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_finish_with_options(struct otc_span *span, const struct otc_finish_span_options *options)
+{
+	struct opentracing::FinishSpanOptions span_options;
+
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span))
+		return;
+
+#ifdef USE_THREADS
+	if (ot_finisher.is_enabled() && ot_span_finish_async(span, nullptr, 0, nullptr, 0, options))
+		return;
+#endif
+
+	OT_SPAN_LOCK_GUARD(span);
+
+#if OT_TAG_BUFFER > 0
+	/* The buffered log records precede the ones given here. */
+	ot_nolock_span_buffer_flush(span, &span_options);
+
+#endif
+	if (options != nullptr) {
+		if (options->finish_time.value.tv_sec > 0) {
+			auto dt = timespec_to_duration(&(options->finish_time.value));
+
+			span_options.finish_steady_timestamp = std::chrono::time_point<std::chrono::steady_clock>(dt);
+		}
+
+		if (options->log_records != nullptr) {
+			for (int i = 0; i < options->num_log_records; i++) {
+				struct opentracing::LogRecord record;
+
+				if (options->log_records[i].timestamp.value.tv_sec > 0) {
+#ifdef __clang__
+					auto dt = timespec_to_duration_us(&(options->log_records[i].timestamp.value));
+#else
+					auto dt = timespec_to_duration(&(options->log_records[i].timestamp.value));
+#endif
+
+					record.timestamp = std::chrono::time_point<std::chrono::system_clock>(dt);
+				}
+
+				for (int j = 0; j < options->log_records[i].num_fields; j++) {
+					opentracing::Value field_value;
+
+					if (ot_value_set(field_value, &(options->log_records[i].fields[j].value)))
+						record.fields.emplace_back(options->log_records[i].fields[j].key, std::move(field_value));
+				}
+
+				span_options.log_records.push_back(std::move(record));
+			}
+		}
+	}
+
+	ot_nolock_span_finish(span, span_options);
+}
+
+
+/***
+ * NAME
+ *   ot_span_finish -
+ *
+ * ARGUMENTS
+ *   span -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_finish(struct otc_span *span)
+{
+	ot_span_finish_with_options(span, nullptr);
+}
+
+
+/***
+ * NAME
+ *   ot_span_get_context -
+ *
+ * ARGUMENTS
+ *   span -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_span_context *ot_span_get_context(struct otc_span *span)
+{
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span))
+		return nullptr;
+
+	return ot_span_context_new(span);
+}
+
+
+/***
+ * NAME
+ *   ot_span_set_operation_name -
+ *
+ * ARGUMENTS
+ *   span           -
+ *   operation_name -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_set_operation_name(struct otc_span *span, const char *operation_name)
+{
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (operation_name == nullptr))
+		return;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	OT_SPAN_PTR(span)->SetOperationName(operation_name);
+}
+
+
+/***
+ * NAME
+ *   ot_span_set_tag -
+ *
+ * ARGUMENTS
+ *   span  -
+ *   key   -
+ *   value -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_set_tag(struct otc_span *span, const char *key, const struct otc_value *value)
+{
+#if OT_TAG_BUFFER > 0
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (key == nullptr) || (value == nullptr))
+		return;
+
+	const struct otc_tag tag = { key, *value };
+
+	ot_span_buffer_set_tags(span, &tag, 1);
+#else
+	opentracing::Value tag_value;
+
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (key == nullptr) || (value == nullptr))
+		return;
+	else if (!ot_value_set(tag_value, value))
+		return;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	OT_SPAN_PTR(span)->SetTag(key, tag_value);
+#endif
+}
+
+
+/***
+ * NAME
+ *   ot_span_log_fields -
+ *
+ * ARGUMENTS
+ *   span       -
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_log_fields(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
+{
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (fields == nullptr) || (num_fields <= 0))
+		return;
+
+#if OT_TAG_BUFFER > 0
+	ot_span_buffer_log_fields(span, fields, num_fields);
+#else
+	OT_SPAN_LOCK_GUARD(span);
+
+	ot_nolock_span_log_fields(OT_SPAN_OBJ(span), fields, num_fields);
+#endif
+}
+
+
+/***
+ * NAME
+ *   ot_span_set_tags -
+ *
+ * ARGUMENTS
+ *   span     -
+ *   tags     -
+ *   num_tags -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_set_tags(struct otc_span *span, const struct otc_tag *tags, int num_tags)
+{
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (tags == nullptr) || (num_tags <= 0))
+		return;
+
+#if OT_TAG_BUFFER > 0
+	ot_span_buffer_set_tags(span, tags, num_tags);
+#else
+	OT_SPAN_LOCK_GUARD(span);
+
+	ot_nolock_span_set_tags(OT_SPAN_OBJ(span), tags, num_tags);
+#endif
+}
+
+
+/***
+ * NAME
+ *   ot_span_set_tags_log_finish -
+ *
+ * ARGUMENTS
+ *   span       -
+ *   tags       -
+ *   num_tags   -
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_set_tags_log_finish(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields)
+{
+	struct opentracing::FinishSpanOptions span_options;
+
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span))
+		return;
+
+#ifdef USE_THREADS
+	if (ot_finisher.is_enabled() && ot_span_finish_async(span, tags, num_tags, fields, num_fields, nullptr))
+		return;
+#endif
+
+	OT_SPAN_LOCK_GUARD(span);
+
+#if OT_TAG_BUFFER > 0
+	/*
+	 * The buffered tags must not override the ones given here, and the
+	 * buffered log records must precede the fields logged here.
+	 */
+	ot_nolock_span_buffer_flush(span, nullptr);
+
+#endif
+	if ((tags != nullptr) && (num_tags > 0))
+		ot_nolock_span_set_tags(OT_SPAN_OBJ(span), tags, num_tags);
+
+	if ((fields != nullptr) && (num_fields > 0))
+		ot_nolock_span_log_fields(OT_SPAN_OBJ(span), fields, num_fields);
+
+	ot_nolock_span_finish(span, span_options);
+}
+
+
+/***
+ * NAME
+ *   ot_span_set_tag_atom -
+ *
+ * ARGUMENTS
+ *   span  -
+ *   key   -
+ *   value -
+ *
+ * DESCRIPTION
+ *   The same as ot_span_set_tag(), with the interned key.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_set_tag_atom(struct otc_span *span, otc_atom_t key, const struct otc_value *value)
+{
+	const struct otc_atom_entry *atom = ot_atom_get(key);
+
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (atom == nullptr) || (value == nullptr))
+		return;
+
+#if OT_TAG_BUFFER > 0
+	const struct otc_tag tag = { atom->str.get(), *value };
+
+	ot_span_buffer_set_tags(span, &tag, 1);
+#else
+	opentracing::Value tag_value;
+
+	if (!ot_value_set(tag_value, value))
+		return;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	OT_SPAN_PTR(span)->SetTag(OT_ATOM_VIEW(atom), tag_value);
+#endif
+}
+
+
+/***
+ * NAME
+ *   ot_span_log_fields_atom -
+ *
+ * ARGUMENTS
+ *   span       -
+ *   fields     -
+ *   num_fields -
+ *
+ * DESCRIPTION
+ *   The same as ot_span_log_fields(), with the interned keys.  The fields
+ *   whose keys are not valid atoms are skipped.  With the tag buffer the
+ *   fields are converted to the ordinary log fields first, since the buffer
+ *   refers to the keys by their strings.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_log_fields_atom(struct otc_span *span, const struct otc_log_field_atom *fields, int num_fields)
+{
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (fields == nullptr) || (num_fields <= 0))
+		return;
+
+#if OT_TAG_BUFFER > 0
+	ot_log_fields_atom.clear();
+
+	for (int i = 0; i < num_fields; i++) {
+		const struct otc_atom_entry *atom = ot_atom_get(fields[i].key);
+
+		if (atom != nullptr)
+			ot_log_fields_atom.push_back({ atom->str.get(), fields[i].value });
+	}
+
+	if (!ot_log_fields_atom.empty())
+		ot_span_buffer_log_fields(span, ot_log_fields_atom.data(), ot_log_fields_atom.size());
+#else
+	OT_SPAN_LOCK_GUARD(span);
+
+	ot_log_fields.clear();
+
+	for (int i = 0; i < num_fields; i++) {
+		const struct otc_atom_entry *atom = ot_atom_get(fields[i].key);
+		opentracing::Value           field_value;
+
+		if ((atom != nullptr) && ot_value_set(field_value, &(fields[i].value)))
+			ot_log_fields.emplace_back(OT_ATOM_VIEW(atom), std::move(field_value));
+	}
+
+	if (!ot_log_fields.empty())
+		OT_SPAN_PTR(span)->Log(ot_clock_system(), ot_log_fields);
+
+	ot_log_fields.clear();
+#endif
+}
+
+
+/***
+ * NAME
+ *   ot_span_set_baggage_item -
+ *
+ * ARGUMENTS
+ *   span  -
+ *   key   -
+ *   value -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_set_baggage_item(struct otc_span *span, const char *key, const char *value)
+{
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (key == nullptr) || (value == nullptr))
+		return;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	OT_SPAN_PTR(span)->SetBaggageItem(key, value);
+}
+
+
+/***
+ * NAME
+ *   ot_span_baggage_item -
+ *
+ * ARGUMENTS
+ *   span -
+ *   key  -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static const char *ot_span_baggage_item(const struct otc_span *span, const char *key)
+{
+	const char *retptr = "";
+
+	OT_STAT_INC(CALLS);
+
+	if (!OT_SPAN_IS_VALID(span) || (key == nullptr))
+		return retptr;
+
+	OT_SPAN_LOCK_GUARD(span);
+
+	auto baggage = OT_SPAN_PTR(span)->BaggageItem(key);
+	if (!baggage.empty() && ((retptr = OTC_DBG_STRDUP(baggage.c_str())) != nullptr))
+		OT_STAT_ADD(BAGGAGE_RETURNED, baggage.size() + 1);
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_span_tracer -
+ *
+ * ARGUMENTS
+ *   span - NOT USED
+ *
+ * DESCRIPTION
+ *   - NOT IMPLEMENTED
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_tracer *ot_span_tracer(const struct otc_span *span)
+{
+	struct otc_tracer *retptr = nullptr;
+
+	if (!OT_SPAN_IS_VALID(span))
+		return retptr;
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_nolock_span_destroy -
+ *
+ * ARGUMENTS
+ *   span -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void ot_nolock_span_destroy(struct otc_span **span)
+{
+	if ((span == nullptr) || ((*span) == nullptr))
+		return;
+
+	if (OT_SPAN_KEY_IS_VALID(*span)) {
+#ifdef OT_DIRECT_SPANS
+		delete OT_SPAN_PTR(*span);
+		(*span)->handle = nullptr;
+#else
+		ot_span_handle((*span)->idx).erase((*span)->idx);
+#endif
+		OT_STAT_INC(SPAN_ERASE);
+	}
+
+	OT_STAT_INC(SPAN_DESTROY);
+
+	ot_span_pool.release(span);
+}
+
+
+/***
+ * NAME
+ *   ot_span_destroy -
+ *
+ * ARGUMENTS
+ *   span -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_destroy(struct otc_span **span)
+{
+	if ((span == nullptr) || (*span == nullptr))
+		return;
+
+	OT_SPAN_LOCK_GUARD(*span);
+
+	ot_nolock_span_destroy(span);
+}
+
+
+/***
+ * NAME
+ *   ot_span_new -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+struct otc_span *ot_span_new(void)
+{
+#ifdef OTC_COMPACT_ABI
+	const static struct otc_span_ops span_ops = {
+		.finish              = ot_span_finish,              /* lock span */
+		.finish_with_options = ot_span_finish_with_options, /* lock span */
+		.span_context        = ot_span_get_context,         /* lock not required */
+		.set_operation_name  = ot_span_set_operation_name,  /* lock span */
+		.set_tag             = ot_span_set_tag,             /* lock span */
+		.log_fields          = ot_span_log_fields,          /* lock span */
+		.set_baggage_item    = ot_span_set_baggage_item,    /* lock span */
+		.baggage_item        = ot_span_baggage_item,        /* lock span */
+		.tracer              = ot_span_tracer,              /* NOT IMPLEMENTED */
+		.destroy             = ot_span_destroy,             /* lock span */
+		.set_tags            = ot_span_set_tags,            /* lock span */
+		.set_tags_log_finish = ot_span_set_tags_log_finish, /* lock span */
+		.set_tag_atom        = ot_span_set_tag_atom,        /* lock span */
+		.log_fields_atom     = ot_span_log_fields_atom      /* lock span */
+	};
+	const static struct otc_span span_init = {
+		.idx                 = 0,
+		.handle              = nullptr,
+		.ops                 = &span_ops
+	};
+#else
+	const static struct otc_span span_init = {
+		.idx                 = 0,
+		.finish              = ot_span_finish,              /* lock span */
+		.finish_with_options = ot_span_finish_with_options, /* lock span */
+		.span_context        = ot_span_get_context,         /* lock not required */
+		.set_operation_name  = ot_span_set_operation_name,  /* lock span */
+		.set_tag             = ot_span_set_tag,             /* lock span */
+		.log_fields          = ot_span_log_fields,          /* lock span */
+		.set_baggage_item    = ot_span_set_baggage_item,    /* lock span */
+		.baggage_item        = ot_span_baggage_item,        /* lock span */
+		.tracer              = ot_span_tracer,              /* NOT IMPLEMENTED */
+		.destroy             = ot_span_destroy,             /* lock span */
+		.handle              = nullptr,
+		.set_tags            = ot_span_set_tags,            /* lock span */
+		.set_tags_log_finish = ot_span_set_tags_log_finish, /* lock span */
+		.set_tag_atom        = ot_span_set_tag_atom,        /* lock span */
+		.log_fields_atom     = ot_span_log_fields_atom      /* lock span */
+	};
+#endif
+	int64_t          idx = OT_KEY_NEW(span);
+	struct otc_span *retptr;
+
+	if ((retptr = OT_CAST_TYPEOF(retptr, ot_span_pool.alloc())) != nullptr) {
+#if OT_TAG_BUFFER > 0
+		OT_SPAN_BUFFERED(retptr)->num_entries = 0;
+		OT_SPAN_BUFFERED(retptr)->data_used   = 0;
+#endif
+		(void)memcpy(retptr, &span_init, sizeof(*retptr));
+		retptr->idx = idx;
+	} else {
+		OT_STAT_INC(SPAN_ALLOC_FAIL);
+	}
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_nolock_span_context_destroy -
+ *
+ * ARGUMENTS
+ *   context -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_nolock_span_context_destroy(struct otc_span_context **context)
+{
+	if ((context == nullptr) || (*context == nullptr))
+		return;
+
+	if (OT_CTX_KEY_IS_VALID(*context)) {
+#ifdef OT_DIRECT_SPANS
+		delete OT_CTX_PTR(*context);
+		(*context)->handle = nullptr;
+#else
+		ot_span_context_handle((*context)->idx).erase((*context)->idx);
+#endif
+		OT_STAT_INC(CTX_ERASE);
+	}
+
+	OT_STAT_INC(CTX_DESTROY);
+
+	ot_span_context_pool.release(context);
+}
+
+
+/***
+ * NAME
+ *   ot_span_context_destroy -
+ *
+ * ARGUMENTS
+ *   context -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_context_destroy(struct otc_span_context **context)
+{
+	if ((context == nullptr) || (*context == nullptr))
+		return;
+
+	OT_CTX_LOCK_GUARD(*context);
+
+	ot_nolock_span_context_destroy(context);
+}
+
+
+/***
+ * NAME
+ *   ot_span_context_new -
+ *
+ * ARGUMENTS
+ *   span -
+ *
+ * DESCRIPTION
+ *   Creates the span context of the span, or an empty span context for the
+ *   span context object that is to be extracted if the span is not given.
+ *   Only the latter gets its index, as the span context of a span uses the
+ *   span object.
+ *
+ * RETURN VALUE
+ *   -
+ */
+struct otc_span_context *ot_span_context_new(const struct otc_span *span)
+{
+	struct otc_span_context *retptr;
+
+	if ((retptr = OT_CAST_TYPEOF(retptr, ot_span_context_pool.alloc())) == nullptr) {
+		OT_STAT_INC(CTX_ALLOC_FAIL);
+
+		return retptr;
+	}
+
+	retptr->idx     = (span == nullptr) ? OT_KEY_NEW(span_context) : -1;
+	retptr->span    = span;
+	retptr->destroy = ot_span_context_destroy; /* lock span_context */
+	retptr->handle  = nullptr;
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_span_noop_finish -
+ *
+ * ARGUMENTS
+ *   span - NOT USED
+ *
+ * DESCRIPTION
+ *   The operations of the no-op span, which is returned by the tracer for
+ *   the spans that are not sampled.  They do nothing.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_finish(struct otc_span *span)
+{
+	(void)span;
+}
+
+
+/***
+ * NAME
+ *   ot_span_noop_finish_with_options -
+ *
+ * ARGUMENTS
+ *   span    - NOT USED
+ *   options - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_finish_with_options(struct otc_span *span, const struct otc_finish_span_options *options)
+{
+	(void)span;
+	(void)options;
+}
+
+
+/***
+ * NAME
+ *   ot_span_noop_get_context -
+ *
+ * ARGUMENTS
+ *   span - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_span_context *ot_span_noop_get_context(struct otc_span *span)
+{
+	(void)span;
+
+	return &ot_span_context_noop;
+}
+
+
+/***
+ * NAME
+ *   ot_span_noop_set_operation_name -
+ *
+ * ARGUMENTS
+ *   span           - NOT USED
+ *   operation_name - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_set_operation_name(struct otc_span *span, const char *operation_name)
+{
+	(void)span;
+	(void)operation_name;
+}
+
+
+/***
+ * NAME
+ *   ot_span_noop_set_tag -
+ *
+ * ARGUMENTS
+ *   span  - NOT USED
+ *   key   - NOT USED
+ *   value - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_set_tag(struct otc_span *span, const char *key, const struct otc_value *value)
+{
+	(void)span;
+	(void)key;
+	(void)value;
+}
+
+
+/***
+ * NAME
+ *   ot_span_noop_log_fields -
+ *
+ * ARGUMENTS
+ *   span       - NOT USED
+ *   fields     - NOT USED
+ *   num_fields - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_log_fields(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
+{
+	(void)span;
+	(void)fields;
+	(void)num_fields;
+}
 
 
 /***
  * NAME
- *   ot_span_finish_with_options -
+ *   ot_span_noop_set_baggage_item -
  *
  * ARGUMENTS
- *   span    -
- *   options -
+ *   span  - NOT USED
+ *   key   - NOT USED
+ *   value - NOT USED
  *
  * DESCRIPTION
  *   -
@@ -41,74 +1444,61 @@ struct Handle<opentracing::SpanContext>       ot_span_context;
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_finish_with_options(struct otc_span *span, const struct otc_finish_span_options *options)
+static void ot_span_noop_set_baggage_item(struct otc_span *span, const char *key, const char *value)
 {
-	OT_LOCK_GUARD(span);
-
-	if (!OT_SPAN_IS_VALID(span))
-		return;
-
-	if (options == nullptr) {
-		ot_span_handle.at(span->idx)->Finish();
-	} else {
-		struct opentracing::FinishSpanOptions span_options;
-
-		if (options->finish_time.value.tv_sec > 0) {
-			auto dt = timespec_to_duration(&(options->finish_time.value));
-
-			span_options.finish_steady_timestamp = std::chrono::time_point<std::chrono::steady_clock>(dt);
-		}
+	(void)span;
+	(void)key;
+	(void)value;
+}
 
-		if (options->log_records != nullptr) {
-			for (int i = 0; i < options->num_log_records; i++) {
-				struct opentracing::LogRecord record;
 
-				if (options->log_records[i].timestamp.value.tv_sec > 0) {
-#ifdef __clang__
-					auto dt = timespec_to_duration_us(&(options->log_records[i].timestamp.value));
-#else
-					auto dt = timespec_to_duration(&(options->log_records[i].timestamp.value));
-#endif
+/***
+ * NAME
+ *   ot_span_noop_baggage_item -
+ *
+ * ARGUMENTS
+ *   span - NOT USED
+ *   key  - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static const char *ot_span_noop_baggage_item(const struct otc_span *span, const char *key)
+{
+	(void)span;
+	(void)key;
 
-					record.timestamp = std::chrono::time_point<std::chrono::system_clock>(dt);
-				}
+	return "";
+}
 
-				for (int j = 0; j < options->log_records[i].num_fields; j++)
-					if (options->log_records[i].fields[j].value.type == otc_value_bool) {
-						record.fields.push_back(std::make_pair(options->log_records[i].fields[j].key, options->log_records[i].fields[j].value.value.bool_value));
-					}
-					else if (options->log_records[i].fields[j].value.type == otc_value_double) {
-						record.fields.push_back(std::make_pair(options->log_records[i].fields[j].key, options->log_records[i].fields[j].value.value.double_value));
-					}
-					else if (options->log_records[i].fields[j].value.type == otc_value_int64) {
-						record.fields.push_back(std::make_pair(options->log_records[i].fields[j].key, options->log_records[i].fields[j].value.value.int64_value));
-					}
-					else if (options->log_records[i].fields[j].value.type == otc_value_uint64) {
-						record.fields.push_back(std::make_pair(options->log_records[i].fields[j].key, options->log_records[i].fields[j].value.value.uint64_value));
-					}
-					else if (options->log_records[i].fields[j].value.type == otc_value_string) {
-						std::string str_value = options->log_records[i].fields[j].value.value.string_value;
-
-						record.fields.push_back(std::make_pair(options->log_records[i].fields[j].key, str_value));
-					}
-					else if (options->log_records[i].fields[j].value.type == otc_value_null) {
-						record.fields.push_back(std::make_pair(options->log_records[i].fields[j].key, nullptr));
-					}
-
-				span_options.log_records.push_back(record);
-			}
-		}
 
-		ot_span_handle.at(span->idx)->FinishWithOptions(span_options);
-	}
+/***
+ * NAME
+ *   ot_span_noop_tracer -
+ *
+ * ARGUMENTS
+ *   span - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_tracer *ot_span_noop_tracer(const struct otc_span *span)
+{
+	(void)span;
 
-	ot_nolock_span_destroy(&span);
+	return nullptr;
 }
 
 
 /***
  * NAME
- *   ot_span_finish -
+ *   ot_span_noop_destroy -
  *
  * ARGUMENTS
  *   span -
@@ -119,43 +1509,71 @@ static void ot_span_finish_with_options(struct otc_span *span, const struct otc_
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_finish(struct otc_span *span)
+static void ot_span_noop_destroy(struct otc_span **span)
 {
-	ot_span_finish_with_options(span, nullptr);
+	if (span != nullptr)
+		*span = nullptr;
 }
 
 
 /***
  * NAME
- *   ot_span_get_context -
+ *   ot_span_noop_set_tags -
  *
  * ARGUMENTS
- *   span -
+ *   span     - NOT USED
+ *   tags     - NOT USED
+ *   num_tags - NOT USED
  *
  * DESCRIPTION
  *   -
  *
  * RETURN VALUE
- *   -
+ *   This function does not return a value.
  */
-static struct otc_span_context *ot_span_get_context(struct otc_span *span)
+static void ot_span_noop_set_tags(struct otc_span *span, const struct otc_tag *tags, int num_tags)
 {
-	OT_LOCK(span, span_context);
+	(void)span;
+	(void)tags;
+	(void)num_tags;
+}
 
-	if (!OT_SPAN_IS_VALID(span))
-		return nullptr;
 
-	return ot_span_context_new(span);
+/***
+ * NAME
+ *   ot_span_noop_set_tags_log_finish -
+ *
+ * ARGUMENTS
+ *   span       - NOT USED
+ *   tags       - NOT USED
+ *   num_tags   - NOT USED
+ *   fields     - NOT USED
+ *   num_fields - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_set_tags_log_finish(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields)
+{
+	(void)span;
+	(void)tags;
+	(void)num_tags;
+	(void)fields;
+	(void)num_fields;
 }
 
 
 /***
  * NAME
- *   ot_span_set_operation_name -
+ *   ot_span_noop_set_tag_atom -
  *
  * ARGUMENTS
- *   span           -
- *   operation_name -
+ *   span  - NOT USED
+ *   key   - NOT USED
+ *   value - NOT USED
  *
  * DESCRIPTION
  *   -
@@ -163,25 +1581,43 @@ static struct otc_span_context *ot_span_get_context(struct otc_span *span)
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_set_operation_name(struct otc_span *span, const char *operation_name)
+static void ot_span_noop_set_tag_atom(struct otc_span *span, otc_atom_t key, const struct otc_value *value)
 {
-	OT_LOCK_GUARD(span);
+	(void)span;
+	(void)key;
+	(void)value;
+}
 
-	if (!OT_SPAN_IS_VALID(span) || (operation_name == nullptr))
-		return;
 
-	ot_span_handle.at(span->idx)->SetOperationName(operation_name);
+/***
+ * NAME
+ *   ot_span_noop_log_fields_atom -
+ *
+ * ARGUMENTS
+ *   span       - NOT USED
+ *   fields     - NOT USED
+ *   num_fields - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_span_noop_log_fields_atom(struct otc_span *span, const struct otc_log_field_atom *fields, int num_fields)
+{
+	(void)span;
+	(void)fields;
+	(void)num_fields;
 }
 
 
 /***
  * NAME
- *   ot_span_set_tag -
+ *   ot_span_context_noop_destroy -
  *
  * ARGUMENTS
- *   span  -
- *   key   -
- *   value -
+ *   context -
  *
  * DESCRIPTION
  *   -
@@ -189,47 +1625,100 @@ static void ot_span_set_operation_name(struct otc_span *span, const char *operat
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_set_tag(struct otc_span *span, const char *key, const struct otc_value *value)
+static void ot_span_context_noop_destroy(struct otc_span_context **context)
 {
-	OT_LOCK_GUARD(span);
+	if (context != nullptr)
+		*context = nullptr;
+}
 
-	if (!OT_SPAN_IS_VALID(span) || (key == nullptr) || (value == nullptr))
-		return;
 
-	if (value->type == otc_value_bool) {
-		ot_span_handle.at(span->idx)->SetTag(key, value->value.bool_value);
-	}
-	else if (value->type == otc_value_double) {
-		ot_span_handle.at(span->idx)->SetTag(key, value->value.double_value);
-	}
-	else if (value->type == otc_value_int64) {
-		ot_span_handle.at(span->idx)->SetTag(key, value->value.int64_value);
-	}
-	else if (value->type == otc_value_uint64) {
-		ot_span_handle.at(span->idx)->SetTag(key, value->value.uint64_value);
-	}
-	else if (value->type == otc_value_string) {
-		std::string str_value = value->value.string_value;
+/***
+ * The no-op span and its span context are shared by all the spans that
+ * are not sampled and whose trace context is not known (the others keep it,
+ * see ot_span_trace_new()).  Their indices are not valid, so they are
+ * refused by all the functions that work with the span objects.
+ */
+#ifdef OTC_COMPACT_ABI
+static const struct otc_span_ops ot_span_noop_ops = {
+	.finish              = ot_span_noop_finish,
+	.finish_with_options = ot_span_noop_finish_with_options,
+	.span_context        = ot_span_noop_get_context,
+	.set_operation_name  = ot_span_noop_set_operation_name,
+	.set_tag             = ot_span_noop_set_tag,
+	.log_fields          = ot_span_noop_log_fields,
+	.set_baggage_item    = ot_span_noop_set_baggage_item,
+	.baggage_item        = ot_span_noop_baggage_item,
+	.tracer              = ot_span_noop_tracer,
+	.destroy             = ot_span_noop_destroy,
+	.set_tags            = ot_span_noop_set_tags,
+	.set_tags_log_finish = ot_span_noop_set_tags_log_finish,
+	.set_tag_atom        = ot_span_noop_set_tag_atom,
+	.log_fields_atom     = ot_span_noop_log_fields_atom
+};
+
+struct otc_span ot_span_noop = {
+	.idx                 = -1,
+	.handle              = nullptr,
+	.ops                 = &ot_span_noop_ops
+};
+#else
+struct otc_span ot_span_noop = {
+	.idx                 = -1,
+	.finish              = ot_span_noop_finish,
+	.finish_with_options = ot_span_noop_finish_with_options,
+	.span_context        = ot_span_noop_get_context,
+	.set_operation_name  = ot_span_noop_set_operation_name,
+	.set_tag             = ot_span_noop_set_tag,
+	.log_fields          = ot_span_noop_log_fields,
+	.set_baggage_item    = ot_span_noop_set_baggage_item,
+	.baggage_item        = ot_span_noop_baggage_item,
+	.tracer              = ot_span_noop_tracer,
+	.destroy             = ot_span_noop_destroy,
+	.handle              = nullptr,
+	.set_tags            = ot_span_noop_set_tags,
+	.set_tags_log_finish = ot_span_noop_set_tags_log_finish,
+	.set_tag_atom        = ot_span_noop_set_tag_atom,
+	.log_fields_atom     = ot_span_noop_log_fields_atom
+};
+#endif
 
-		ot_span_handle.at(span->idx)->SetTag(key, str_value);
-	}
-	else if (value->type == otc_value_null) {
-		ot_span_handle.at(span->idx)->SetTag(key, nullptr);
-	}
-	else {
-		/* Do nothing. */
-	}
+struct otc_span_context ot_span_context_noop = {
+	.idx                 = -1,
+	.span                = &ot_span_noop,
+	.destroy             = ot_span_context_noop_destroy,
+	.handle              = nullptr
+};
+
+
+/***
+ * NAME
+ *   ot_span_trace_size -
+ *
+ * ARGUMENTS
+ *   size  - the size of the structure that keeps the trace context
+ *   trace - the trace context
+ *
+ * DESCRIPTION
+ *   The no-op span and span context of a sampled-out trace keep its trace
+ *   context, with the tracestate string copied right after the structure.
+ *
+ * RETURN VALUE
+ *   Returns the number of bytes to allocate for the structure.
+ */
+static size_t ot_span_trace_size(size_t size, const struct otc_trace_context *trace)
+{
+	return size + ((trace->tracestate == nullptr) ? 0 : (strlen(trace->tracestate) + 1));
 }
 
 
 /***
  * NAME
- *   ot_span_log_fields -
+ *   ot_span_trace_copy -
  *
  * ARGUMENTS
- *   span       -
- *   fields     -
- *   num_fields -
+ *   dst  - the trace context to copy to
+ *   src  - the trace context to copy from
+ *   data - the memory for the tracestate string
  *
  * DESCRIPTION
  *   -
@@ -237,51 +1726,21 @@ static void ot_span_set_tag(struct otc_span *span, const char *key, const struct
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_log_fields(struct otc_span *span, const struct otc_log_field *fields, int num_fields)
+static void ot_span_trace_copy(struct otc_trace_context *dst, const struct otc_trace_context *src, char *data)
 {
-	OT_LOCK_GUARD(span);
-	std::string str_value[OTC_MAXLOGFIELDS];
-
-	if (!OT_SPAN_IS_VALID(span) || (fields == nullptr) || !OT_IN_RANGE(num_fields, 1, OTC_MAXLOGFIELDS))
-		return;
+	*dst = *src;
 
-	/* XXX  The only data type supported in this function is string. */
-	for (int i = 0; (i < num_fields) && (i < OTC_MAXLOGFIELDS); i++) {
-		if (fields[i].value.type != otc_value_string)
-			str_value[i] = "invalid data type";
-		else if (fields[i].value.value.string_value != nullptr)
-			str_value[i] = fields[i].value.value.string_value;
-		else
-			str_value[i] = "";
-	}
-
-	if (num_fields == 1)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0) });
-	else if (num_fields == 2)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1) });
-	else if (num_fields == 3)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1), OT_LF(2) });
-	else if (num_fields == 4)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1), OT_LF(2), OT_LF(3) });
-	else if (num_fields == 5)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1), OT_LF(2), OT_LF(3), OT_LF(4) });
-	else if (num_fields == 6)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1), OT_LF(2), OT_LF(3), OT_LF(4), OT_LF(5) });
-	else if (num_fields == 7)
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1), OT_LF(2), OT_LF(3), OT_LF(4), OT_LF(5), OT_LF(6) });
-	else
-		ot_span_handle.at(span->idx)->Log({ OT_LF(0), OT_LF(1), OT_LF(2), OT_LF(3), OT_LF(4), OT_LF(5), OT_LF(6), OT_LF(7) });
+	if (src->tracestate != nullptr)
+		dst->tracestate = strcpy(data, src->tracestate);
 }
 
 
 /***
  * NAME
- *   ot_span_set_baggage_item -
+ *   ot_span_context_trace_destroy -
  *
  * ARGUMENTS
- *   span  -
- *   key   -
- *   value -
+ *   context -
  *
  * DESCRIPTION
  *   -
@@ -289,103 +1748,118 @@ static void ot_span_log_fields(struct otc_span *span, const struct otc_log_field
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_set_baggage_item(struct otc_span *span, const char *key, const char *value)
+static void ot_span_context_trace_destroy(struct otc_span_context **context)
 {
-	OT_LOCK_GUARD(span);
+	struct otc_span_context_trace *context_trace;
 
-	if (!OT_SPAN_IS_VALID(span) || (key == nullptr) || (value == nullptr))
+	if ((context == nullptr) || (*context == nullptr))
 		return;
 
-	ot_span_handle.at(span->idx)->SetBaggageItem(key, value);
+	context_trace = OT_SPAN_CONTEXT_TRACE(*context);
+	OT_MEM_FREE_CLEAR(CTX, context_trace, ot_span_trace_size(sizeof(*context_trace), &(context_trace->trace)));
+
+	*context = nullptr;
 }
 
 
 /***
  * NAME
- *   ot_span_baggage_item -
+ *   ot_span_context_trace_new -
  *
  * ARGUMENTS
- *   span -
- *   key  -
+ *   trace - the trace context of the sampled-out trace
  *
  * DESCRIPTION
- *   -
+ *   Creates the no-op span context that keeps the trace context of a
+ *   sampled-out trace, so that it is injected with the ids of that trace.
+ *   Like the shared no-op span context, it refers to the no-op span, so it
+ *   is recognized by OT_CTX_IS_NOOP().  A trace context without the trace
+ *   id has nothing to keep.
  *
  * RETURN VALUE
- *   -
+ *   Returns the new span context, or the shared no-op span context if the
+ *   trace id is not known or in case of an error.
  */
-static const char *ot_span_baggage_item(const struct otc_span *span, const char *key)
+struct otc_span_context *ot_span_context_trace_new(const struct otc_trace_context *trace)
 {
-	OT_LOCK_GUARD(span);
-	const char *retptr = "";
+	struct otc_span_context_trace *retptr;
+	const size_t                   size = ot_span_trace_size(sizeof(*retptr), trace);
 
-	if (!OT_SPAN_IS_VALID(span) || (key == nullptr))
-		return retptr;
+	if ((trace->trace_id == 0) && (trace->trace_id_high == 0))
+		return &ot_span_context_noop;
 
-	auto baggage = ot_span_handle.at(span->idx)->BaggageItem(key);
-	if (!baggage.empty())
-		retptr = OTC_DBG_STRDUP(baggage.c_str());
+	if ((retptr = OT_CAST_TYPEOF(retptr, OT_MEM_MALLOC(CTX, size))) == nullptr) {
+		OT_STAT_INC(CTX_ALLOC_FAIL);
 
-	return retptr;
+		return &ot_span_context_noop;
+	}
+
+	retptr->context.idx     = -1;
+	retptr->context.span    = &ot_span_noop;
+	retptr->context.destroy = ot_span_context_trace_destroy;
+	retptr->context.handle  = nullptr;
+	ot_span_trace_copy(&(retptr->trace), trace, OT_CAST_REINTERPRET(char *, retptr + 1));
+
+	return &(retptr->context);
 }
 
 
 /***
  * NAME
- *   ot_span_tracer -
+ *   ot_span_context_trace -
  *
  * ARGUMENTS
- *   span - NOT USED
+ *   context -
  *
  * DESCRIPTION
- *   - NOT IMPLEMENTED
+ *   -
  *
  * RETURN VALUE
- *   -
+ *   Returns the trace context kept by the no-op span context, or nullptr if
+ *   the span context does not keep one.
  */
-static struct otc_tracer *ot_span_tracer(const struct otc_span *span)
+const struct otc_trace_context *ot_span_context_trace(const struct otc_span_context *context)
 {
-	struct otc_tracer *retptr = nullptr;
-
-	if (!OT_SPAN_IS_VALID(span))
-		return retptr;
+	if ((context == nullptr) || (context->destroy != ot_span_context_trace_destroy))
+		return nullptr;
 
-	return retptr;
+	return &(OT_CAST_REINTERPRET(const struct otc_span_context_trace *, context)->trace);
 }
 
 
 /***
  * NAME
- *   ot_nolock_span_destroy -
+ *   ot_span_trace_destroy -
  *
  * ARGUMENTS
  *   span -
  *
  * DESCRIPTION
- *   -
+ *   The operations of the no-op span that keeps the trace context of a
+ *   sampled-out trace.  They do nothing, except that the span is released
+ *   when it is finished or destroyed, and that its span context keeps the
+ *   trace context.
  *
  * RETURN VALUE
  *   This function does not return a value.
  */
-void ot_nolock_span_destroy(struct otc_span **span)
+static void ot_span_trace_destroy(struct otc_span **span)
 {
-	if ((span == nullptr) || ((*span) == nullptr))
-		return;
+	struct otc_span_trace *span_trace;
 
-	if (OT_SPAN_KEY_IS_VALID(*span)) {
-		ot_span_handle.erase((*span)->idx);
-		ot_span.erase_cnt++;
-	}
+	if ((span == nullptr) || (*span == nullptr))
+		return;
 
-	ot_span.destroy_cnt++;
+	span_trace = OT_SPAN_TRACE(*span);
+	OT_MEM_FREE_CLEAR(SPAN, span_trace, ot_span_trace_size(sizeof(*span_trace), &(span_trace->trace)));
 
-	OT_EXT_FREE_CLEAR(*span);
+	*span = nullptr;
 }
 
 
 /***
  * NAME
- *   ot_span_destroy -
+ *   ot_span_trace_finish -
  *
  * ARGUMENTS
  *   span -
@@ -396,67 +1870,44 @@ void ot_nolock_span_destroy(struct otc_span **span)
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_span_destroy(struct otc_span **span)
+static void ot_span_trace_finish(struct otc_span *span)
 {
-	OT_LOCK_GUARD(span);
-
-	ot_nolock_span_destroy(span);
+	ot_span_trace_destroy(&span);
 }
 
 
 /***
  * NAME
- *   ot_span_new -
+ *   ot_span_trace_finish_with_options -
  *
  * ARGUMENTS
- *   This function takes no arguments.
+ *   span    -
+ *   options - NOT USED
  *
  * DESCRIPTION
  *   -
  *
  * RETURN VALUE
- *   -
+ *   This function does not return a value.
  */
-struct otc_span *ot_span_new(void)
+static void ot_span_trace_finish_with_options(struct otc_span *span, const struct otc_finish_span_options *options)
 {
-	const static struct otc_span span_init = {
-		.idx                 = 0,
-		.finish              = ot_span_finish,              /* lock span */
-		.finish_with_options = ot_span_finish_with_options, /* lock span */
-		.span_context        = ot_span_get_context,         /* lock span and span_context */
-		.set_operation_name  = ot_span_set_operation_name,  /* lock span */
-		.set_tag             = ot_span_set_tag,             /* lock span */
-		.log_fields          = ot_span_log_fields,          /* lock span */
-		.set_baggage_item    = ot_span_set_baggage_item,    /* lock span */
-		.baggage_item        = ot_span_baggage_item,        /* lock span */
-		.tracer              = ot_span_tracer,              /* NOT IMPLEMENTED */
-		.destroy             = ot_span_destroy              /* lock span */
-	};
-	int64_t          idx = ot_span.key++;
-	struct otc_span *retptr;
-
-	if (idx == 0) {
-		ot_span_handle.clear();
-		ot_span_handle.reserve(8192);
-	}
-
-	if ((retptr = OT_CAST_TYPEOF(retptr, OT_EXT_MALLOC(sizeof(*retptr)))) != nullptr) {
-		(void)memcpy(retptr, &span_init, sizeof(*retptr));
-		retptr->idx = idx;
-	} else {
-		ot_span.alloc_fail_cnt++;
-	}
+	(void)options;
 
-	return retptr;
+	ot_span_trace_destroy(&span);
 }
 
 
 /***
  * NAME
- *   ot_nolock_span_context_destroy -
+ *   ot_span_trace_set_tags_log_finish -
  *
  * ARGUMENTS
- *   context -
+ *   span       -
+ *   tags       - NOT USED
+ *   num_tags   - NOT USED
+ *   fields     - NOT USED
+ *   num_fields - NOT USED
  *
  * DESCRIPTION
  *   -
@@ -464,77 +1915,121 @@ struct otc_span *ot_span_new(void)
  * RETURN VALUE
  *   This function does not return a value.
  */
-static void ot_nolock_span_context_destroy(struct otc_span_context **context)
+static void ot_span_trace_set_tags_log_finish(struct otc_span *span, const struct otc_tag *tags, int num_tags, const struct otc_log_field *fields, int num_fields)
 {
-	if ((context == nullptr) || (*context == nullptr))
-		return;
-
-	if (OT_CTX_KEY_IS_VALID(*context)) {
-		ot_span_context_handle.erase((*context)->idx);
-		ot_span_context.erase_cnt++;
-	}
-
-	ot_span_context.destroy_cnt++;
+	(void)tags;
+	(void)num_tags;
+	(void)fields;
+	(void)num_fields;
 
-	OT_EXT_FREE_CLEAR(*context);
+	ot_span_trace_destroy(&span);
 }
 
 
 /***
  * NAME
- *   ot_span_context_destroy -
+ *   ot_span_trace_get_context -
  *
  * ARGUMENTS
- *   context -
+ *   span -
  *
  * DESCRIPTION
  *   -
  *
  * RETURN VALUE
- *   This function does not return a value.
+ *   Returns the no-op span context with the trace context of the span.
  */
-static void ot_span_context_destroy(struct otc_span_context **context)
+static struct otc_span_context *ot_span_trace_get_context(struct otc_span *span)
 {
-	OT_LOCK_GUARD(span_context);
-
-	ot_nolock_span_context_destroy(context);
+	return ot_span_context_trace_new(&(OT_SPAN_TRACE(span)->trace));
 }
 
 
 /***
  * NAME
- *   ot_span_context_new -
+ *   ot_span_trace_new -
  *
  * ARGUMENTS
- *   span -
+ *   options - the start options of the span that is not sampled
  *
  * DESCRIPTION
- *   -
+ *   Creates the no-op span for a span that is not sampled.  If the span
+ *   references a no-op span context that keeps the trace context of a
+ *   sampled-out trace, the new span keeps it too, with its own span id, so
+ *   that the trace id is injected further; otherwise, nothing is allocated
+ *   and the shared no-op span is used.
  *
  * RETURN VALUE
- *   -
+ *   Returns the new no-op span, or the shared no-op span.
  */
-struct otc_span_context *ot_span_context_new(const struct otc_span *span)
+struct otc_span *ot_span_trace_new(const struct otc_start_span_options *options)
 {
-	int64_t                  idx = ot_span_context.key++;
-	struct otc_span_context *retptr;
+#ifdef OTC_COMPACT_ABI
+	const static struct otc_span_ops span_ops = {
+		.finish              = ot_span_trace_finish,
+		.finish_with_options = ot_span_trace_finish_with_options,
+		.span_context        = ot_span_trace_get_context,
+		.set_operation_name  = ot_span_noop_set_operation_name,
+		.set_tag             = ot_span_noop_set_tag,
+		.log_fields          = ot_span_noop_log_fields,
+		.set_baggage_item    = ot_span_noop_set_baggage_item,
+		.baggage_item        = ot_span_noop_baggage_item,
+		.tracer              = ot_span_noop_tracer,
+		.destroy             = ot_span_trace_destroy,
+		.set_tags            = ot_span_noop_set_tags,
+		.set_tags_log_finish = ot_span_trace_set_tags_log_finish,
+		.set_tag_atom        = ot_span_noop_set_tag_atom,
+		.log_fields_atom     = ot_span_noop_log_fields_atom
+	};
+	const static struct otc_span span_init = {
+		.idx                 = -1,
+		.handle              = nullptr,
+		.ops                 = &span_ops
+	};
+#else
+	const static struct otc_span span_init = {
+		.idx                 = -1,
+		.finish              = ot_span_trace_finish,
+		.finish_with_options = ot_span_trace_finish_with_options,
+		.span_context        = ot_span_trace_get_context,
+		.set_operation_name  = ot_span_noop_set_operation_name,
+		.set_tag             = ot_span_noop_set_tag,
+		.log_fields          = ot_span_noop_log_fields,
+		.set_baggage_item    = ot_span_noop_set_baggage_item,
+		.baggage_item        = ot_span_noop_baggage_item,
+		.tracer              = ot_span_noop_tracer,
+		.destroy             = ot_span_trace_destroy,
+		.handle              = nullptr,
+		.set_tags            = ot_span_noop_set_tags,
+		.set_tags_log_finish = ot_span_trace_set_tags_log_finish,
+		.set_tag_atom        = ot_span_noop_set_tag_atom,
+		.log_fields_atom     = ot_span_noop_log_fields_atom
+	};
+#endif
+	const struct otc_trace_context *trace = nullptr;
+	struct otc_span_trace          *retptr;
 
-	if (idx == 0) {
-		ot_span_context_handle.clear();
-		ot_span_context_handle.reserve(8192);
-	}
+	if ((options != nullptr) && (options->references != nullptr))
+		for (int i = 0; (trace == nullptr) && (i < options->num_references); i++)
+			trace = ot_span_context_trace(options->references[i].referenced_context);
 
-	if ((retptr = OT_CAST_TYPEOF(retptr, OT_EXT_MALLOC(sizeof(*retptr)))) == nullptr) {
-		ot_span_context.alloc_fail_cnt++;
+	if (trace == nullptr)
+		return &ot_span_noop;
 
-		return retptr;
+	if ((retptr = OT_CAST_TYPEOF(retptr, OT_MEM_MALLOC(SPAN, ot_span_trace_size(sizeof(*retptr), trace)))) == nullptr) {
+		OT_STAT_INC(SPAN_ALLOC_FAIL);
+
+		return &ot_span_noop;
 	}
 
-	retptr->idx     = (span == nullptr) ? idx : -1;
-	retptr->span    = span;
-	retptr->destroy = ot_span_context_destroy; /* lock span_context */
+	(void)memcpy(&(retptr->span), &span_init, sizeof(retptr->span));
+	ot_span_trace_copy(&(retptr->trace), trace, OT_CAST_REINTERPRET(char *, retptr + 1));
+	retptr->trace.parent_span_id = trace->span_id;
+	do
+		retptr->trace.span_id = ot_sampler_rand();
+	while (retptr->trace.span_id == 0);
 
-	return retptr;
+	return &(retptr->span);
 }
 
 /*
@@ -18,6 +18,19 @@
 
 static std::unique_ptr<const opentracing::DynamicTracingLibraryHandle> ot_dynlib = nullptr;
 static std::shared_ptr<opentracing::Tracer>                            ot_tracer = nullptr;
+static thread_local std::string                                        ot_inject_buffer;
+static thread_local struct otc_carrier_cache                           ot_extract_cache;
+static std::atomic<otc_propagation_format_t>                           ot_propagation_format(otc_propagation_format_none);
+static bool                                                            ot_tracer_is_noop = false;
+
+#ifdef USE_THREADS
+/*
+ * The finisher is defined after the tracer and its library, so that at exit
+ * it is destroyed first: the spans that are still queued are then finished
+ * while the tracer and its plugin are loaded.
+ */
+otc_finisher ot_finisher;
+#endif
 
 
 /***
@@ -111,6 +124,11 @@ static void ot_tracer_close(struct otc_tracer *tracer)
 	if (ot_dynlib == nullptr)
 		return;
 
+#ifdef USE_THREADS
+	/* The queued spans are finished before the tracer is closed. */
+	ot_finisher.stop();
+#endif
+
 	if (ot_tracer != nullptr)
 		ot_tracer->Close();
 	tracer->destroy(&tracer);
@@ -119,38 +137,56 @@ static void ot_tracer_close(struct otc_tracer *tracer)
 
 /***
  * NAME
- *   ot_tracer_start_span_with_options -
+ *   ot_tracer_start_span_name -
  *
  * ARGUMENTS
- *   tracer         - NOT USED
  *   operation_name -
+ *   hash           - the hash of the operation name, or 0 if not known
  *   options        -
  *
  * DESCRIPTION
- *   -
+ *   Starts the span, common to the functions that take the operation name
+ *   as a string or as an atom.
  *
  * RETURN VALUE
  *   -
  */
-static struct otc_span *ot_tracer_start_span_with_options(struct otc_tracer *tracer, const char *operation_name, const struct otc_start_span_options *options)
+static struct otc_span *ot_tracer_start_span_name(opentracing::string_view operation_name, uint64_t hash, const struct otc_start_span_options *options)
 {
-	OT_LOCK_GUARD(span);
 	std::unique_ptr<opentracing::Span>  span_maybe = nullptr;
 	struct otc_span                    *retptr = nullptr;
 
 	if (ot_tracer == nullptr)
 		return retptr;
-	else if ((tracer == nullptr) || (operation_name == nullptr))
-		return retptr;
+
+	/* The spans that are not sampled do not get to the tracer at all. */
+	if (!ot_sampler_is_sampled(operation_name, hash, options)) {
+		OT_STAT_INC(SPAN_SAMPLED_OUT);
+
+		return ot_span_trace_new(options);
+	}
 
 	/* Allocating memory for the span. */
 	if ((retptr = ot_span_new()) == nullptr)
 		return retptr;
 
 	if (options == nullptr) {
-		span_maybe = ot_tracer->StartSpan(operation_name);
+		struct opentracing::StartSpanOptions span_options;
+
+		if (ot_clock_is_set() && ot_clock_now(span_options.start_steady_timestamp, span_options.start_system_timestamp))
+			span_maybe = ot_tracer->StartSpanWithOptions(operation_name, span_options);
+		else
+			span_maybe = ot_tracer->StartSpan(operation_name);
 	} else {
 		struct opentracing::StartSpanOptions span_options;
+		otc_lock_set                         lock_set;
+
+		/*
+		 * The start time is taken from the clock source only if the
+		 * application has set neither of the start times.
+		 */
+		if ((options->start_time_steady.value.tv_sec <= 0) && (options->start_time_system.value.tv_sec <= 0) && ot_clock_is_set())
+			(void)ot_clock_now(span_options.start_steady_timestamp, span_options.start_system_timestamp);
 
 		if (options->start_time_steady.value.tv_sec > 0) {
 			auto dt = timespec_to_duration(&(options->start_time_steady.value));
@@ -169,66 +205,59 @@ static struct otc_span *ot_tracer_start_span_with_options(struct otc_tracer *tra
 		}
 
 		if (options->references != nullptr) {
-			int lock_cnt = 0;
+#ifndef OT_THREADS_NO_LOCKING
+#  ifndef OT_DIRECT_SPANS
+			/*
+			 * The referenced spans and span contexts can be located
+			 * in different shards of the handle tables.  All the
+			 * required shards are locked at once, and they stay
+			 * locked until the new span is started.
+			 */
+			for (int i = 0; i < options->num_references; i++)
+				if (OT_SPAN_IS_VALID(options->references[i].referenced_context->span))
+					lock_set.add(OT_SHARD(span, options->references[i].referenced_context->span->idx).mutex);
+				else if (OT_CTX_KEY_IS_VALID(options->references[i].referenced_context))
+					lock_set.add(OT_SHARD(span_context, options->references[i].referenced_context->idx).mutex);
+
+			lock_set.lock();
+#  endif
+#endif
 
 			for (int i = 0; i < options->num_references; i++) {
 				const opentracing::SpanContext *context = nullptr;
 
-				if (OT_SPAN_IS_VALID(options->references[i].referenced_context->span)) {
-					context = &(ot_span_handle.at(options->references[i].referenced_context->span->idx)->context());
-				}
-				else if (OT_CTX_KEY_IS_VALID(options->references[i].referenced_context)) {
-#ifdef OT_THREADS_NO_LOCKING
-					lock_cnt++;
-#else
-					if (lock_cnt++ == 0)
-						ot_span_context.mutex.lock();
-#endif
-
-					context = ot_span_context_handle.at(options->references[i].referenced_context->idx).get();
-				}
+				if (OT_SPAN_IS_VALID(options->references[i].referenced_context->span))
+					context = &(OT_SPAN_PTR(options->references[i].referenced_context->span)->context());
+				else if (OT_CTX_KEY_IS_VALID(options->references[i].referenced_context))
+					context = OT_CTX_PTR(options->references[i].referenced_context);
 
 				if (options->references[i].type == otc_span_reference_child_of)
 					span_options.references.push_back(std::make_pair(opentracing::SpanReferenceType::ChildOfRef, context));
 				else if (options->references[i].type == otc_span_reference_follows_from)
 					span_options.references.push_back(std::make_pair(opentracing::SpanReferenceType::FollowsFromRef, context));
 			}
-
-#ifndef OT_THREADS_NO_LOCKING
-			if (lock_cnt > 0)
-				ot_span_context.mutex.unlock();
-#endif
 		}
 
 		if (options->tags != nullptr) {
-			for (int i = 0; i < options->num_tags; i++)
-				if (options->tags[i].value.type == otc_value_bool) {
-					span_options.tags.push_back(std::make_pair(options->tags[i].key, options->tags[i].value.value.bool_value));
-				}
-				else if (options->tags[i].value.type == otc_value_double) {
-					span_options.tags.push_back(std::make_pair(options->tags[i].key, options->tags[i].value.value.double_value));
-				}
-				else if (options->tags[i].value.type == otc_value_int64) {
-					span_options.tags.push_back(std::make_pair(options->tags[i].key, options->tags[i].value.value.int64_value));
-				}
-				else if (options->tags[i].value.type == otc_value_uint64) {
-					span_options.tags.push_back(std::make_pair(options->tags[i].key, options->tags[i].value.value.uint64_value));
-				}
-				else if (options->tags[i].value.type == otc_value_string) {
-					std::string str_value = options->tags[i].value.value.string_value;
-
-					span_options.tags.push_back(std::make_pair(options->tags[i].key, str_value));
-				}
-				else if (options->tags[i].value.type == otc_value_null) {
-					span_options.tags.push_back(std::make_pair(options->tags[i].key, nullptr));
-				}
+			for (int i = 0; i < options->num_tags; i++) {
+				opentracing::Value tag_value;
+
+				if (ot_value_set(tag_value, &(options->tags[i].value)))
+					span_options.tags.emplace_back(options->tags[i].key, std::move(tag_value));
+			}
 		}
 
 		span_maybe = ot_tracer->StartSpanWithOptions(operation_name, span_options);
 	}
 
+	OT_SPAN_LOCK_GUARD(retptr);
+
 	if (span_maybe != nullptr)
-		ot_span_handle.emplace(retptr->idx, std::move(span_maybe));
+#ifdef OT_DIRECT_SPANS
+		retptr->handle = span_maybe.release();
+#else
+		ot_span_handle(retptr->idx).emplace(retptr->idx, std::move(span_maybe));
+#endif
 	else
 		ot_nolock_span_destroy(&retptr);
 
@@ -236,6 +265,61 @@ static struct otc_span *ot_tracer_start_span_with_options(struct otc_tracer *tra
 }
 
 
+/***
+ * NAME
+ *   ot_tracer_start_span_with_options -
+ *
+ * ARGUMENTS
+ *   tracer         - NOT USED
+ *   operation_name -
+ *   options        -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_span *ot_tracer_start_span_with_options(struct otc_tracer *tracer, const char *operation_name, const struct otc_start_span_options *options)
+{
+	OT_STAT_INC(CALLS);
+
+	if ((tracer == nullptr) || (operation_name == nullptr))
+		return nullptr;
+
+	return ot_tracer_start_span_name(operation_name, 0, options);
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_start_span_atom -
+ *
+ * ARGUMENTS
+ *   tracer         - NOT USED
+ *   operation_name - the atom of the operation name
+ *   options        -
+ *
+ * DESCRIPTION
+ *   Starts the span with the interned operation name, whose length and hash
+ *   are already known.
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_span *ot_tracer_start_span_atom(struct otc_tracer *tracer, otc_atom_t operation_name, const struct otc_start_span_options *options)
+{
+	const struct otc_atom_entry *atom = ot_atom_get(operation_name);
+
+	OT_STAT_INC(CALLS);
+
+	if ((tracer == nullptr) || (atom == nullptr))
+		return nullptr;
+
+	return ot_tracer_start_span_name(OT_ATOM_VIEW(atom), atom->hash, options);
+}
+
+
 /***
  * NAME
  *   ot_tracer_start_span -
@@ -258,66 +342,147 @@ static struct otc_span *ot_tracer_start_span(struct otc_tracer *tracer, const ch
 
 /***
  * NAME
- *   ot_tracer_inject_text_map -
+ *   ot_tracer_inject_is_noop -
  *
  * ARGUMENTS
- *   tracer       - NOT USED
- *   carrier      -
  *   span_context -
  *
  * DESCRIPTION
+ *   Checks whether the span context is the no-op one and the header format
+ *   is set, in which case the inject functions write a trace context that
+ *   is not sampled.
+ *
+ * RETURN VALUE
+ *   Returns true if the span context is injected as not sampled, false
+ *   otherwise.
+ */
+static bool ot_tracer_inject_is_noop(const struct otc_span_context *span_context)
+{
+	return (span_context != nullptr) && OT_CTX_IS_NOOP(span_context) && (ot_propagation_format.load(std::memory_order_relaxed) != otc_propagation_format_none);
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_inject_noop -
+ *
+ * ARGUMENTS
+ *   carrier_writer -
+ *   span_context   - the no-op span context
+ *
+ * DESCRIPTION
+ *   Writes a trace context that is not sampled, with the wrapper's own
+ *   encoder, through the carrier writer.  The ids are those of the
+ *   sampled-out trace kept by the no-op span context (see
+ *   ot_span_context_trace_new()); the shared no-op span context does not
+ *   belong to any known trace, so it starts a new one with random ids.
+ *   The headers are encoded in an arena on the stack first.
+ *
+ * RETURN VALUE
  *   -
+ */
+static opentracing::expected<void> ot_tracer_inject_noop(const opentracing::TextMapWriter &carrier_writer, const struct otc_span_context *span_context)
+{
+	const struct otc_trace_context *trace = ot_span_context_trace(span_context);
+	struct otc_trace_context        context = { };
+	struct otc_text_map             text_map, *text_map_ptr = &text_map;
+	uint64_t                        buffer[192];
+	opentracing::expected<void>     rc = opentracing::make_unexpected(opentracing::span_context_corrupted_error);
+
+	if (trace != nullptr) {
+		context = *trace;
+	} else {
+		context.trace_id = ot_sampler_rand();
+		context.span_id  = ot_sampler_rand();
+	}
+	context.flags = 0;
+
+	if (otc_text_map_arena_init(&text_map, 4, buffer, sizeof(buffer)) == nullptr)
+		return rc;
+
+	if (otc_propagation_encode(&text_map, ot_propagation_format.load(std::memory_order_relaxed), &context) == otc_propagation_error_code_success)
+		for (size_t i = 0; i < text_map.count; i++)
+			if (!(rc = carrier_writer.Set(text_map.key[i], text_map.value[i])))
+				break;
+
+	otc_text_map_destroy(&text_map_ptr, OT_CAST_STAT(otc_text_map_flags_t, 0));
+
+	return rc;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_inject_writer -
+ *
+ * ARGUMENTS
+ *   carrier      -
+ *   span_context -
+ *
+ * DESCRIPTION
+ *   Injects the span context through the carrier writer, which passes the
+ *   data set by the tracer directly to the writer of the caller (the no-op
+ *   span context is written by ot_tracer_inject_noop()).  If the
+ *   writer has no set() callback, its text map is initialized here and the
+ *   keys and values are duplicated, so that they can be released one by
+ *   one with free().  If the text map is an arena made by the caller with
+ *   otc_text_map_arena_new() or otc_text_map_arena_init(), it is cleared
+ *   and the data is copied to it instead, so that a long-lived writer does
+ *   not allocate memory again; any other content of the text map is
+ *   overwritten, as it may not be initialized.  In case of an error, the
+ *   text map is released or cleared.
  *
  * RETURN VALUE
  *   -
  */
-static otc_propagation_error_code_t ot_tracer_inject_text_map(struct otc_tracer *tracer, struct otc_text_map_writer *carrier, const struct otc_span_context *span_context)
+template<typename T, typename C> static otc_propagation_error_code_t ot_tracer_inject_writer(C *carrier, const struct otc_span_context *span_context)
 {
-	TextMap                     text_map;
-	TextMapCarrier              text_map_carrier(text_map);
+	T                           carrier_writer(carrier, ot_inject_buffer);
 	opentracing::expected<void> rc;
+	bool                        is_new = false;
 
-	if (ot_tracer == nullptr)
-		return otc_propagation_error_code_invalid_tracer;
-	else if ((tracer == nullptr) || (carrier == nullptr))
-		return otc_propagation_error_code_invalid_carrier;
-	else if (!OT_CTX_IS_VALID(span_context))
-		return otc_propagation_error_code_span_context_corrupted;
+	if (carrier->set != nullptr)
+		/* Do nothing. */;
+	else if (OT_TEXT_MAP_IS_ARENA(&(carrier->text_map)))
+		otc_text_map_clear(&(carrier->text_map), OT_CAST_STAT(otc_text_map_flags_t, 0));
+	else if (otc_text_map_new(&(carrier->text_map), OT_TEXT_MAP_INJECT_SIZE) == nullptr)
+		return otc_propagation_error_code_unknown;
+	else
+		is_new = true;
 
-	if (OT_SPAN_IS_VALID(span_context->span)) {
-		OT_LOCK_GUARD(span);
+	if (ot_tracer_inject_is_noop(span_context)) {
+		rc = ot_tracer_inject_noop(carrier_writer, span_context);
+	}
+	else if (OT_SPAN_IS_VALID(span_context->span)) {
+		OT_SPAN_LOCK_GUARD(span_context->span);
 
-		rc = ot_tracer->Inject(ot_span_handle.at(span_context->span->idx)->context(), text_map_carrier);
+		rc = ot_tracer->Inject(OT_SPAN_PTR(span_context->span)->context(), carrier_writer);
 	}
 	else if (OT_CTX_KEY_IS_VALID(span_context)) {
-		OT_LOCK_GUARD(span_context);
+		OT_CTX_LOCK_GUARD(span_context);
 
-		rc = ot_tracer->Inject(*(ot_span_context_handle.at(span_context->idx)), text_map_carrier);
+		rc = ot_tracer->Inject(*OT_CTX_PTR(span_context), carrier_writer);
 	}
 
-	if (!rc)
-		return otc_propagation_error_code_unknown;
-	else if (text_map.empty())
-		return otc_propagation_error_code_unknown;
-	else if (otc_text_map_new(&(carrier->text_map), text_map.size()) == nullptr)
-		return otc_propagation_error_code_unknown;
+	if (rc && (carrier_writer.count() > 0))
+		return otc_propagation_error_code_success;
 
-	for (auto const &it : text_map)
-		if (carrier->set != nullptr) {
-			otc_propagation_error_code_t retval = carrier->set(carrier, it.first.c_str(), it.second.c_str());
-			if (retval != otc_propagation_error_code_success)
-				return retval;
-		}
-		else if (otc_text_map_add(&(carrier->text_map), it.first.c_str(), 0, it.second.c_str(), 0, OT_CAST_STAT(otc_text_map_flags_t, OTC_TEXT_MAP_DUP_KEY | OTC_TEXT_MAP_DUP_VALUE)) == -1)
-			return otc_propagation_error_code_unknown;
+	if ((carrier->set == nullptr) && is_new) {
+		struct otc_text_map *text_map = &(carrier->text_map);
 
-	return otc_propagation_error_code_success;
+		otc_text_map_destroy(&text_map, OT_CAST_STAT(otc_text_map_flags_t, OTC_TEXT_MAP_FREE_KEY | OTC_TEXT_MAP_FREE_VALUE));
+	}
+	else if (carrier->set == nullptr) {
+		otc_text_map_clear(&(carrier->text_map), OT_CAST_STAT(otc_text_map_flags_t, 0));
+	}
+
+	return (carrier_writer.rc() != otc_propagation_error_code_success) ? carrier_writer.rc() : otc_propagation_error_code_unknown;
 }
 
 
 /***
  * NAME
- *   ot_tracer_inject_http_headers -
+ *   ot_tracer_inject_text_map -
  *
  * ARGUMENTS
  *   tracer       - NOT USED
@@ -330,47 +495,48 @@ static otc_propagation_error_code_t ot_tracer_inject_text_map(struct otc_tracer
  * RETURN VALUE
  *   -
  */
-static otc_propagation_error_code_t ot_tracer_inject_http_headers(struct otc_tracer *tracer, struct otc_http_headers_writer *carrier, const struct otc_span_context *span_context)
+static otc_propagation_error_code_t ot_tracer_inject_text_map(struct otc_tracer *tracer, struct otc_text_map_writer *carrier, const struct otc_span_context *span_context)
 {
-	TextMap                     text_map;
-	HTTPHeadersCarrier          http_headers_carrier(text_map);
-	opentracing::expected<void> rc;
+	OT_STAT_INC(CALLS);
 
 	if (ot_tracer == nullptr)
 		return otc_propagation_error_code_invalid_tracer;
 	else if ((tracer == nullptr) || (carrier == nullptr))
 		return otc_propagation_error_code_invalid_carrier;
-	else if (!OT_CTX_IS_VALID(span_context))
+	else if (!OT_CTX_IS_VALID(span_context) && !ot_tracer_inject_is_noop(span_context))
 		return otc_propagation_error_code_span_context_corrupted;
 
-	if (OT_SPAN_IS_VALID(span_context->span)) {
-		OT_LOCK_GUARD(span);
-
-		rc = ot_tracer->Inject(ot_span_handle.at(span_context->span->idx)->context(), http_headers_carrier);
-	}
-	else if (OT_CTX_KEY_IS_VALID(span_context)) {
-		OT_LOCK_GUARD(span_context);
+	return ot_tracer_inject_writer<TextMapCarrierWriter>(carrier, span_context);
+}
 
-		rc = ot_tracer->Inject(*(ot_span_context_handle.at(span_context->idx)), http_headers_carrier);
-	}
 
-	if (!rc)
-		return otc_propagation_error_code_unknown;
-	else if (text_map.empty())
-		return otc_propagation_error_code_unknown;
-	else if (otc_text_map_new(&(carrier->text_map), text_map.size()) == nullptr)
-		return otc_propagation_error_code_unknown;
+/***
+ * NAME
+ *   ot_tracer_inject_http_headers -
+ *
+ * ARGUMENTS
+ *   tracer       - NOT USED
+ *   carrier      -
+ *   span_context -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static otc_propagation_error_code_t ot_tracer_inject_http_headers(struct otc_tracer *tracer, struct otc_http_headers_writer *carrier, const struct otc_span_context *span_context)
+{
+	OT_STAT_INC(CALLS);
 
-	for (auto const &it : text_map)
-		if (carrier->set != nullptr) {
-			otc_propagation_error_code_t retval = carrier->set(carrier, it.first.c_str(), it.second.c_str());
-			if (retval != otc_propagation_error_code_success)
-				return retval;
-		}
-		else if (otc_text_map_add(&(carrier->text_map), it.first.c_str(), 0, it.second.c_str(), 0, OT_CAST_STAT(otc_text_map_flags_t, OTC_TEXT_MAP_DUP_KEY | OTC_TEXT_MAP_DUP_VALUE)) == -1)
-			return otc_propagation_error_code_unknown;
+	if (ot_tracer == nullptr)
+		return otc_propagation_error_code_invalid_tracer;
+	else if ((tracer == nullptr) || (carrier == nullptr))
+		return otc_propagation_error_code_invalid_carrier;
+	else if (!OT_CTX_IS_VALID(span_context) && !ot_tracer_inject_is_noop(span_context))
+		return otc_propagation_error_code_span_context_corrupted;
 
-	return otc_propagation_error_code_success;
+	return ot_tracer_inject_writer<HTTPHeadersCarrierWriter>(carrier, span_context);
 }
 
 
@@ -391,9 +557,10 @@ static otc_propagation_error_code_t ot_tracer_inject_http_headers(struct otc_tra
  */
 static otc_propagation_error_code_t ot_tracer_inject_binary(struct otc_tracer *tracer, struct otc_custom_carrier_writer *carrier, const struct otc_span_context *span_context)
 {
-	std::ostringstream          oss(std::ios::binary);
 	opentracing::expected<void> rc;
 
+	OT_STAT_INC(CALLS);
+
 	if (ot_tracer == nullptr)
 		return otc_propagation_error_code_invalid_tracer;
 	else if ((tracer == nullptr) || (carrier == nullptr))
@@ -401,22 +568,29 @@ static otc_propagation_error_code_t ot_tracer_inject_binary(struct otc_tracer *t
 	else if (!OT_CTX_IS_VALID(span_context))
 		return otc_propagation_error_code_span_context_corrupted;
 
+	BinaryWriteBuf buf(&(carrier->binary_data));
+	std::ostream   os(&buf);
+
 	if (OT_SPAN_IS_VALID(span_context->span)) {
-		OT_LOCK_GUARD(span);
+		OT_SPAN_LOCK_GUARD(span_context->span);
 
-		rc = ot_tracer->Inject(ot_span_handle.at(span_context->span->idx)->context(), oss);
+		rc = ot_tracer->Inject(OT_SPAN_PTR(span_context->span)->context(), os);
 	}
 	else if (OT_CTX_KEY_IS_VALID(span_context)) {
-		OT_LOCK_GUARD(span_context);
+		OT_CTX_LOCK_GUARD(span_context);
+
+		rc = ot_tracer->Inject(*OT_CTX_PTR(span_context), os);
+	}
 
-		rc = ot_tracer->Inject(*(ot_span_context_handle.at(span_context->idx)), oss);
+	if (!rc || !os.good()) {
+		buf.abort();
+
+		return otc_propagation_error_code_unknown;
 	}
 
-	if (rc)
-		if (otc_binary_data_new(&(carrier->binary_data), oss.str().c_str(), oss.str().size()) != nullptr)
-			return otc_propagation_error_code_success;
+	buf.commit();
 
-	return otc_propagation_error_code_unknown;
+	return otc_propagation_error_code_success;
 }
 
 
@@ -455,22 +629,31 @@ static otc_propagation_error_code_t ot_tracer_inject_custom(struct otc_tracer *t
  *   span_context_maybe -
  *
  * DESCRIPTION
- *   -
+ *   Creates the span context for the extracted span context object, which
+ *   is then kept in the span context handle table, or in the span context
+ *   itself if the spans are accessed directly.
  *
  * RETURN VALUE
  *   -
  */
 static otc_propagation_error_code_t ot_span_context_add(struct otc_span_context **span_context, std::unique_ptr<opentracing::SpanContext> &span_context_maybe)
 {
-	OT_LOCK_GUARD(span_context);
-
-	if ((*span_context = ot_span_context_new(nullptr)) == nullptr) {
+	/* The tracer can report a missing span context as an empty one. */
+	if (span_context_maybe == nullptr)
+		return otc_propagation_error_code_span_context_not_found;
+	else if ((*span_context = ot_span_context_new(nullptr)) == nullptr) {
 		span_context_maybe.reset(nullptr);
 
 		return otc_propagation_error_code_unknown;
 	}
 
-	ot_span_context_handle.emplace((*span_context)->idx, std::move(span_context_maybe));
+#ifdef OT_DIRECT_SPANS
+	(*span_context)->handle = span_context_maybe.release();
+#else
+	OT_CTX_LOCK_GUARD(*span_context);
+
+	ot_span_context_handle((*span_context)->idx).emplace((*span_context)->idx, std::move(span_context_maybe));
+#endif
 
 	return otc_propagation_error_code_success;
 }
@@ -478,29 +661,93 @@ static otc_propagation_error_code_t ot_span_context_add(struct otc_span_context
 
 /***
  * NAME
- *   ot_tracer_text_map_add -
+ *   ot_tracer_extract_check -
  *
  * ARGUMENTS
- *   arg   -
- *   key   -
- *   value -
+ *   carrier_reader -
+ *   context        - the decoded trace context
  *
  * DESCRIPTION
- *   -
+ *   If the header format of the tracer is set, the carrier is first read
+ *   with the wrapper's own decoder.  Only a carrier whose trace context
+ *   headers are found to be invalid is refused without calling the tracer;
+ *   a carrier without them (for example, one with only the baggage or the
+ *   headers of another format) is left to the tracer.  The pairs read by
+ *   the decoder stay in the cache of the reader, so that the tracer does
+ *   not read the carrier again.  If the header format is not set, or the
+ *   headers are not found, the sampling decision in the context is left
+ *   as deferred.
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_success if the tracer should
+ *   extract the span context (or the decoded one is not sampled),
+ *   otherwise the error code of the decoder or the reader.
+ */
+template<typename T> static otc_propagation_error_code_t ot_tracer_extract_check(const T &carrier_reader, struct otc_trace_context *context)
+{
+	const otc_propagation_format_t format = ot_propagation_format.load(std::memory_order_relaxed);
+	otc_propagation_error_code_t   rc;
+
+	context->flags = OTC_TRACE_FLAG_DEFERRED;
+
+	if (format == otc_propagation_format_none)
+		return otc_propagation_error_code_success;
+	else if ((rc = carrier_reader.load()) != otc_propagation_error_code_success)
+		return rc;
+
+	otc_codec_decoder decoder(format, context);
+
+	for (size_t i = 0; i < carrier_reader.count(); i++)
+		if (decoder.add(carrier_reader.key_at(i), carrier_reader.value_at(i)) != otc_propagation_error_code_success)
+			break;
+
+	rc = decoder.finish();
+
+	return (rc == otc_propagation_error_code_span_context_not_found) ? otc_propagation_error_code_success : rc;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_extract_reader -
+ *
+ * ARGUMENTS
+ *   carrier      -
+ *   span_context -
+ *
+ * DESCRIPTION
+ *   Extracts the span context through the carrier reader, which reads the
+ *   data directly from the reader of the caller.  With the parent-based
+ *   sampling, a span context that the carrier marks as not sampled is not
+ *   passed to the tracer; a no-op span context that keeps the decoded trace
+ *   context is returned instead, so that the spans referencing it are not
+ *   sampled either and the trace id is injected further.
  *
  * RETURN VALUE
  *   -
  */
-static otc_propagation_error_code_t ot_tracer_text_map_add(void *arg, const char *key, const char *value)
+template<typename T, typename C> static otc_propagation_error_code_t ot_tracer_extract_reader(const C *carrier, struct otc_span_context **span_context)
 {
-	TextMap *text_map = OT_CAST_REINTERPRET(TextMap *, arg);
+	T                            carrier_reader(carrier, ot_extract_cache);
+	struct otc_trace_context     context;
+	otc_propagation_error_code_t rc;
 
-	if ((arg == nullptr) || (key == nullptr) || (value == nullptr))
-		return otc_propagation_error_code_unknown;
+	if ((rc = ot_tracer_extract_check(carrier_reader, &context)) != otc_propagation_error_code_success)
+		return rc;
 
-	text_map->emplace(key, value);
+	if (!ot_sampler_is_sampled_parent(&context)) {
+		*span_context = ot_span_context_trace_new(&context);
 
-	return otc_propagation_error_code_success;
+		return otc_propagation_error_code_success;
+	}
+
+	auto span_context_maybe = ot_tracer->Extract(carrier_reader);
+	if (carrier_reader.rc() != otc_propagation_error_code_success)
+		return carrier_reader.rc();
+	else if (!span_context_maybe)
+		return otc_propagation_error_code_span_context_not_found;
+
+	return ot_span_context_add(span_context, *span_context_maybe);
 }
 
 
@@ -521,8 +768,7 @@ static otc_propagation_error_code_t ot_tracer_text_map_add(void *arg, const char
  */
 static otc_propagation_error_code_t ot_tracer_extract_text_map(struct otc_tracer *tracer, const struct otc_text_map_reader *carrier, struct otc_span_context **span_context)
 {
-	TextMap        text_map;
-	TextMapCarrier text_map_carrier(text_map);
+	OT_STAT_INC(CALLS);
 
 	if (ot_tracer == nullptr)
 		return otc_propagation_error_code_invalid_tracer;
@@ -531,20 +777,7 @@ static otc_propagation_error_code_t ot_tracer_extract_text_map(struct otc_tracer
 	else if (span_context == nullptr)
 		return otc_propagation_error_code_invalid_span_context;
 
-	if (carrier->foreach_key != nullptr) {
-		otc_propagation_error_code_t rc = carrier->foreach_key(OT_CAST_CONST(struct otc_text_map_reader *, carrier), ot_tracer_text_map_add, &text_map);
-		if (rc != otc_propagation_error_code_success)
-			return rc;
-	} else {
-		for (size_t i = 0; i < carrier->text_map.count; i++)
-			text_map[carrier->text_map.key[i]] = carrier->text_map.value[i];
-	}
-
-	auto span_context_maybe = ot_tracer->Extract(text_map_carrier);
-	if (!span_context_maybe)
-		return otc_propagation_error_code_span_context_not_found;
-
-	return ot_span_context_add(span_context, *span_context_maybe);
+	return ot_tracer_extract_reader<TextMapCarrierReader>(carrier, span_context);
 }
 
 
@@ -565,8 +798,7 @@ static otc_propagation_error_code_t ot_tracer_extract_text_map(struct otc_tracer
  */
 static otc_propagation_error_code_t ot_tracer_extract_http_headers(struct otc_tracer *tracer, const struct otc_http_headers_reader *carrier, struct otc_span_context **span_context)
 {
-	TextMap            text_map;
-	HTTPHeadersCarrier http_headers_carrier(text_map);
+	OT_STAT_INC(CALLS);
 
 	if (ot_tracer == nullptr)
 		return otc_propagation_error_code_invalid_tracer;
@@ -575,20 +807,7 @@ static otc_propagation_error_code_t ot_tracer_extract_http_headers(struct otc_tr
 	else if (span_context == nullptr)
 		return otc_propagation_error_code_invalid_span_context;
 
-	if (carrier->foreach_key != nullptr) {
-		otc_propagation_error_code_t rc = carrier->foreach_key(OT_CAST_CONST(struct otc_http_headers_reader *, carrier), ot_tracer_text_map_add, &text_map);
-		if (rc != otc_propagation_error_code_success)
-			return rc;
-	} else {
-		for (size_t i = 0; i < carrier->text_map.count; i++)
-			text_map[carrier->text_map.key[i]] = carrier->text_map.value[i];
-	}
-
-	auto span_context_maybe = ot_tracer->Extract(http_headers_carrier);
-	if (!span_context_maybe)
-		return otc_propagation_error_code_span_context_not_found;
-
-	return ot_span_context_add(span_context, *span_context_maybe);
+	return ot_tracer_extract_reader<HTTPHeadersCarrierReader>(carrier, span_context);
 }
 
 
@@ -609,6 +828,8 @@ static otc_propagation_error_code_t ot_tracer_extract_http_headers(struct otc_tr
  */
 static otc_propagation_error_code_t ot_tracer_extract_binary(struct otc_tracer *tracer, const struct otc_custom_carrier_reader *carrier, struct otc_span_context **span_context)
 {
+	OT_STAT_INC(CALLS);
+
 	if (ot_tracer == nullptr)
 		return otc_propagation_error_code_invalid_tracer;
 	else if ((tracer == nullptr) || (carrier == nullptr))
@@ -619,10 +840,10 @@ static otc_propagation_error_code_t ot_tracer_extract_binary(struct otc_tracer *
 	if ((carrier->binary_data.data == nullptr) || (carrier->binary_data.size == 0))
 		return otc_propagation_error_code_invalid_carrier;
 
-	std::string        iss_data(OT_CAST_REINTERPRET(const char *, carrier->binary_data.data), carrier->binary_data.size);
-	std::istringstream iss(iss_data, std::ios::binary);
+	BinaryReadBuf buf(&(carrier->binary_data));
+	std::istream  is(&buf);
 
-	auto span_context_maybe = ot_tracer->Extract(iss);
+	auto span_context_maybe = ot_tracer->Extract(is);
 	if (!span_context_maybe)
 		return otc_propagation_error_code_span_context_not_found;
 
@@ -676,6 +897,192 @@ static void ot_tracer_destroy(struct otc_tracer **tracer)
 }
 
 
+/***
+ * NAME
+ *   ot_tracer_noop_close -
+ *
+ * ARGUMENTS
+ *   tracer -
+ *
+ * DESCRIPTION
+ *   The operations of the no-op tracer, which is used when no tracer
+ *   library is loaded.  The spans it starts are the shared no-op span,
+ *   nothing can be injected and no span context is ever extracted.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_tracer_noop_close(struct otc_tracer *tracer)
+{
+	if (tracer == nullptr)
+		return;
+
+	tracer->destroy(&tracer);
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_noop_start_span_with_options -
+ *
+ * ARGUMENTS
+ *   tracer         - NOT USED
+ *   operation_name - NOT USED
+ *   options        - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the no-op span.
+ */
+static struct otc_span *ot_tracer_noop_start_span_with_options(struct otc_tracer *tracer, const char *operation_name, const struct otc_start_span_options *options)
+{
+	(void)tracer;
+	(void)operation_name;
+	(void)options;
+
+	return &ot_span_noop;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_noop_start_span -
+ *
+ * ARGUMENTS
+ *   tracer         - NOT USED
+ *   operation_name - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the no-op span.
+ */
+static struct otc_span *ot_tracer_noop_start_span(struct otc_tracer *tracer, const char *operation_name)
+{
+	(void)tracer;
+	(void)operation_name;
+
+	return &ot_span_noop;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_noop_start_span_atom -
+ *
+ * ARGUMENTS
+ *   tracer         - NOT USED
+ *   operation_name - NOT USED
+ *   options        - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the no-op span.
+ */
+static struct otc_span *ot_tracer_noop_start_span_atom(struct otc_tracer *tracer, otc_atom_t operation_name, const struct otc_start_span_options *options)
+{
+	(void)tracer;
+	(void)operation_name;
+	(void)options;
+
+	return &ot_span_noop;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_noop_inject -
+ *
+ * ARGUMENTS
+ *   tracer       - NOT USED
+ *   carrier      - NOT USED
+ *   span_context - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_invalid_span_context.
+ */
+template<typename C> static otc_propagation_error_code_t ot_tracer_noop_inject(struct otc_tracer *tracer, C *carrier, const struct otc_span_context *span_context)
+{
+	(void)tracer;
+	(void)carrier;
+	(void)span_context;
+
+	return otc_propagation_error_code_invalid_span_context;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_noop_extract -
+ *
+ * ARGUMENTS
+ *   tracer       - NOT USED
+ *   carrier      - NOT USED
+ *   span_context - NOT USED
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_span_context_not_found.
+ */
+template<typename C> static otc_propagation_error_code_t ot_tracer_noop_extract(struct otc_tracer *tracer, const C *carrier, struct otc_span_context **span_context)
+{
+	(void)tracer;
+	(void)carrier;
+	(void)span_context;
+
+	return otc_propagation_error_code_span_context_not_found;
+}
+
+
+/***
+ * NAME
+ *   ot_tracer_noop_new -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static struct otc_tracer *ot_tracer_noop_new(void)
+{
+	const static struct otc_tracer tracer_init = {
+		.close                   = ot_tracer_noop_close,
+		.start_span              = ot_tracer_noop_start_span,
+		.start_span_with_options = ot_tracer_noop_start_span_with_options,
+		.inject_text_map         = ot_tracer_noop_inject<struct otc_text_map_writer>,
+		.inject_http_headers     = ot_tracer_noop_inject<struct otc_http_headers_writer>,
+		.inject_binary           = ot_tracer_noop_inject<struct otc_custom_carrier_writer>,
+		.inject_custom           = ot_tracer_noop_inject<struct otc_custom_carrier_writer>,
+		.extract_text_map        = ot_tracer_noop_extract<struct otc_text_map_reader>,
+		.extract_http_headers    = ot_tracer_noop_extract<struct otc_http_headers_reader>,
+		.extract_binary          = ot_tracer_noop_extract<struct otc_custom_carrier_reader>,
+		.extract_custom          = ot_tracer_noop_extract<struct otc_custom_carrier_reader>,
+		.destroy                 = ot_tracer_destroy,
+		.start_span_atom         = ot_tracer_noop_start_span_atom
+	};
+	struct otc_tracer *retptr;
+
+	if ((retptr = OT_CAST_TYPEOF(retptr, OTC_DBG_CALLOC(1, sizeof(*retptr)))) != nullptr)
+		(void)memcpy(retptr, &tracer_init, sizeof(*retptr));
+
+	return retptr;
+}
+
+
 /***
  * NAME
  *   ot_tracer_new -
@@ -703,7 +1110,8 @@ struct otc_tracer *ot_tracer_new(void)
 		.extract_http_headers    = ot_tracer_extract_http_headers,    /* lock span_context */
 		.extract_binary          = ot_tracer_extract_binary,          /* lock span_context */
 		.extract_custom          = ot_tracer_extract_custom,          /* NOT IMPLEMENTED */
-		.destroy                 = ot_tracer_destroy                  /* lock not required */
+		.destroy                 = ot_tracer_destroy,                 /* lock not required */
+		.start_span_atom         = ot_tracer_start_span_atom          /* lock span */
 	};
 	struct otc_tracer *retptr;
 
@@ -719,12 +1127,14 @@ struct otc_tracer *ot_tracer_new(void)
  *   otc_tracer_load -
  *
  * ARGUMENTS
- *   library   -
+ *   library   - the tracer plugin library, or NULL or "noop" for none
  *   errbuf    -
  *   errbufsiz -
  *
  * DESCRIPTION
- *   -
+ *   Loads the tracer plugin library.  If the library is not specified, no
+ *   plugin is loaded and the no-op tracer is returned, whose spans do
+ *   nothing; the tracing then stays configured, but disabled.
  *
  * RETURN VALUE
  *   -
@@ -736,14 +1146,19 @@ struct otc_tracer *otc_tracer_load(const char *library, char *errbuf, int errbuf
 	};
 	struct otc_tracer *retptr = nullptr;
 
-	if ((retptr = ot_tracer_new()) == nullptr) {
+	if ((library == nullptr) || (strcmp(library, OT_TRACER_NOOP) == 0)) {
+		if ((retptr = ot_tracer_noop_new()) != nullptr)
+			ot_tracer_is_noop = true;
+	}
+	else if ((retptr = ot_tracer_new()) == nullptr) {
 		/* Do nothing. */;
 	}
 	else if (ot_tracer_load(library, errbuf, errbufsiz, *handle) == -1) {
 		retptr->destroy(&retptr);
 	}
 	else {
-		ot_dynlib = std::move(handle);
+		ot_dynlib         = std::move(handle);
+		ot_tracer_is_noop = false;
 	}
 
 	return retptr;
@@ -761,7 +1176,8 @@ struct otc_tracer *otc_tracer_load(const char *library, char *errbuf, int errbuf
  *   errbufsiz -
  *
  * DESCRIPTION
- *   -
+ *   Starts the loaded tracer with the given configuration.  The no-op
+ *   tracer does not use the configuration, its start always succeeds.
  *
  * RETURN VALUE
  *   -
@@ -772,6 +1188,10 @@ int otc_tracer_start(const char *cfgfile, const char *cfgbuf, char *errbuf, int
 	char                                 *config = OT_CAST_CONST(char *, cfgbuf);
 	int                                   retval = -1;
 
+	/* The no-op tracer does not need any configuration. */
+	if (ot_tracer_is_noop)
+		return 0;
+
 	if (cfgfile != nullptr) {
 		config = otc_file_read(cfgfile, "#", errbuf, errbufsiz);
 		if (config == nullptr)
@@ -863,6 +1283,61 @@ void otc_tracer_init_global(struct otc_tracer *tracer)
 		return;
 }
 
+
+/***
+ * NAME
+ *   ot_tracer_propagation_format -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the trace context header format set with
+ *   otc_tracer_propagation_format().
+ */
+otc_propagation_format_t ot_tracer_propagation_format(void)
+{
+	return ot_propagation_format.load(std::memory_order_relaxed);
+}
+
+
+/***
+ * NAME
+ *   otc_tracer_propagation_format -
+ *
+ * ARGUMENTS
+ *   format - the trace context header format used by the tracer
+ *
+ * DESCRIPTION
+ *   Sets the trace context header format of the loaded tracer.  This
+ *   should only be done if the tracer is known to use that format.  The
+ *   text map and http headers extract functions then check the carrier
+ *   with the wrapper's own decoder before passing it to the tracer.  The
+ *   format otc_propagation_format_none disables the check; it cannot be
+ *   set while the sampler of the wrapper is set (see otc_tracer_sampler()),
+ *   because the no-op spans could not be injected without a format.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 if the format is not valid.
+ */
+int otc_tracer_propagation_format(otc_propagation_format_t format)
+{
+	if (format == otc_propagation_format_none) {
+		if (ot_sampler_is_set())
+			return -1;
+	}
+	else if (!OT_CODEC_FORMAT_IS_VALID(format)) {
+		return -1;
+	}
+
+	ot_propagation_format.store(format, std::memory_order_relaxed);
+
+	return 0;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 8
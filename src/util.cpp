@@ -19,46 +19,141 @@
 otc_ext_malloc_t otc_ext_malloc = OT_IFDEF_DBG(otc_dbg_malloc, malloc);
 otc_ext_free_t   otc_ext_free   = OT_IFDEF_DBG(otc_dbg_free,   free);
 
+/* The list of the statistics counters of all threads. */
+static struct {
+	std::mutex                                         mutex;
+	std::vector<otc_stats_local *>                     list;
+	int64_t                                            retired[OT_STAT_MAX];
+	int64_t                                            calls;
+	std::chrono::time_point<std::chrono::steady_clock> time = std::chrono::steady_clock::now();
+} ot_stats;
+
+thread_local otc_stats_local ot_stats_tl;
+
 
 /***
  * NAME
- *   timespec_to_duration_us -
+ *   otc_stats_local::otc_stats_local -
  *
  * ARGUMENTS
- *   ts -
+ *   This function takes no arguments.
  *
  * DESCRIPTION
- *   -
+ *   Adds the statistics counters of the thread to the list.
  *
  * RETURN VALUE
- *   -
+ *   This function does not return a value.
  */
-std::chrono::microseconds timespec_to_duration_us(const struct timespec *ts)
+otc_stats_local::otc_stats_local()
 {
-	auto duration = std::chrono::seconds{ts->tv_sec} + std::chrono::microseconds{ts->tv_nsec / 1000};
+	const std::lock_guard<std::mutex> guard(ot_stats.mutex);
 
-	return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+	for (auto &it : cnt)
+		it.store(0, std::memory_order_relaxed);
+
+	ot_stats.list.push_back(this);
 }
 
 
 /***
  * NAME
- *   timespec_to_duration -
+ *   otc_stats_local::~otc_stats_local -
  *
  * ARGUMENTS
- *   ts -
+ *   This function takes no arguments.
  *
  * DESCRIPTION
- *   -
+ *   Removes the statistics counters of the thread from the list.  Their
+ *   values are preserved in the counters of the finished threads.
  *
  * RETURN VALUE
- *   -
+ *   This function does not return a value.
+ */
+otc_stats_local::~otc_stats_local()
+{
+	const std::lock_guard<std::mutex> guard(ot_stats.mutex);
+
+	for (int i = 0; i < OT_STAT_MAX; i++)
+		ot_stats.retired[i] += get(i);
+
+	ot_stats.list.erase(std::find(ot_stats.list.begin(), ot_stats.list.end(), this));
+}
+
+
+/***
+ * NAME
+ *   ot_stats_get -
+ *
+ * ARGUMENTS
+ *   cnt - array of OT_STAT_MAX counters
+ *
+ * DESCRIPTION
+ *   Sums up the statistics counters of all threads.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void ot_stats_get(int64_t *cnt)
+{
+	const std::lock_guard<std::mutex> guard(ot_stats.mutex);
+
+	for (int i = 0; i < OT_STAT_MAX; i++) {
+		cnt[i] = ot_stats.retired[i];
+
+		for (auto it : ot_stats.list)
+			cnt[i] += it->get(i);
+	}
+}
+
+
+/***
+ * NAME
+ *   ot_value_set -
+ *
+ * ARGUMENTS
+ *   dst - OpenTracing value
+ *   src - value to be converted
+ *
+ * DESCRIPTION
+ *   Converts the value to the OpenTracing value.  The string value is
+ *   copied, unless it is marked with the OTC_VALUE_PERSISTENT flag; then
+ *   only its reference is passed to the tracer.
+ *
+ * RETURN VALUE
+ *   Returns true if the value type is valid, false otherwise.
  */
-std::chrono::nanoseconds timespec_to_duration(const struct timespec *ts)
+bool ot_value_set(opentracing::Value &dst, const struct otc_value *src)
 {
-	auto duration = std::chrono::seconds{ts->tv_sec} + std::chrono::nanoseconds{ts->tv_nsec};
+	const otc_value_type_t type = OT_VALUE_TYPE(src);
+
+	if (type == otc_value_bool) {
+		dst = OT_CAST_STAT(bool, src->value.bool_value);
+	}
+	else if (type == otc_value_double) {
+		dst = src->value.double_value;
+	}
+	else if (type == otc_value_int64) {
+		dst = src->value.int64_value;
+	}
+	else if (type == otc_value_uint64) {
+		dst = src->value.uint64_value;
+	}
+	else if (type == otc_value_string) {
+		const char *str = (src->value.string_value == nullptr) ? "" : src->value.string_value;
 
-	return std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+		if (src->type & OTC_VALUE_PERSISTENT)
+			dst = opentracing::string_view(str);
+		else
+			dst = std::string(str);
+	}
+	else if (type == otc_value_null) {
+		dst = nullptr;
+	}
+	else {
+		return false;
+	}
+
+	return true;
 }
 
 
@@ -102,19 +197,272 @@ struct otc_text_map *otc_text_map_new(struct otc_text_map *text_map, size_t size
 	struct otc_text_map *retptr = text_map;
 
 	if (retptr == nullptr)
-		retptr = OT_CAST_TYPEOF(retptr, OTC_DBG_CALLOC(1, sizeof(*retptr)));
+		retptr = OT_CAST_TYPEOF(retptr, OT_MEM_CALLOC(TEXT_MAP, 1, sizeof(*retptr)));
 
 	if (retptr != nullptr) {
 		retptr->count      = 0;
 		retptr->size       = size;
 		retptr->is_dynamic = text_map == nullptr;
+		retptr->is_arena   = false;
+		retptr->magic      = OT_CARRIER_MAGIC;
 
 		if (size == 0)
 			/* Do nothing. */;
-		else if ((retptr->key = OT_CAST_TYPEOF(retptr->key, OTC_DBG_CALLOC(size, sizeof(*(retptr->key))))) == nullptr)
+		else if ((retptr->key = OT_CAST_TYPEOF(retptr->key, OT_MEM_CALLOC(TEXT_MAP, size, sizeof(*(retptr->key))))) == nullptr)
+			otc_text_map_destroy(&retptr, OT_CAST_STAT(otc_text_map_flags_t, 0));
+		else if ((retptr->value = OT_CAST_TYPEOF(retptr->value, OT_MEM_CALLOC(TEXT_MAP, size, sizeof(*(retptr->value))))) == nullptr)
+			otc_text_map_destroy(&retptr, OT_CAST_STAT(otc_text_map_flags_t, 0));
+	}
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   ot_text_map_arena_set -
+ *
+ * ARGUMENTS
+ *   text_map    -
+ *   block       -
+ *   block_size  -
+ *   size        -
+ *   is_external -
+ *
+ * DESCRIPTION
+ *   Places the arena header and the arrays of key and value pointers for
+ *   'size' pairs at the beginning of the block.  The rest of the block is
+ *   used for the string data.
+ *
+ * RETURN VALUE
+ *   Returns true if the block is large enough, false otherwise.
+ */
+static bool ot_text_map_arena_set(struct otc_text_map *text_map, void *block, size_t block_size, size_t size, bool is_external)
+{
+	struct otc_text_map_arena *arena = OT_CAST_TYPEOF(arena, block);
+
+	if ((block == nullptr) || (block_size < (sizeof(*arena) + 2 * size * sizeof(*(text_map->key)))))
+		return false;
+
+	arena->size        = block_size;
+	arena->used        = 0;
+	arena->is_external = is_external;
+
+	text_map->key      = OT_CAST_REINTERPRET(char **, arena + 1);
+	text_map->value    = text_map->key + size;
+	text_map->count    = 0;
+	text_map->size     = size;
+	text_map->is_arena = true;
+	text_map->magic    = OT_CARRIER_MAGIC;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_text_map_arena_avail -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   Returns the number of string data bytes still available in the arena.
+ */
+static size_t ot_text_map_arena_avail(const struct otc_text_map *text_map)
+{
+	const struct otc_text_map_arena *arena = OT_TEXT_MAP_ARENA(text_map);
+
+	return arena->size - (OT_TEXT_MAP_DATA(text_map) - OT_CAST_REINTERPRET(const char *, arena)) - arena->used;
+}
+
+
+/***
+ * NAME
+ *   ot_text_map_arena_grow -
+ *
+ * ARGUMENTS
+ *   text_map - text map in the arena mode
+ *   len      - the number of string data bytes needed
+ *
+ * DESCRIPTION
+ *   Moves the text map to a larger block.  The number of pairs and the
+ *   size of the string data are increased (as needed) by half of their
+ *   current values.  The key and value pointers that point to the string
+ *   data are relocated to the new block; the other pointers are retained.
+ *   A block provided by the caller is not released.
+ *
+ * RETURN VALUE
+ *   Returns true on success, false otherwise.
+ */
+static bool ot_text_map_arena_grow(struct otc_text_map *text_map, size_t len)
+{
+	struct otc_text_map_arena *arena     = OT_TEXT_MAP_ARENA(text_map);
+	struct otc_text_map        retval    = *text_map;
+	const char                *data      = OT_TEXT_MAP_DATA(text_map);
+	size_t                     size      = text_map->size;
+	size_t                     data_size = ot_text_map_arena_avail(text_map) + arena->used;
+	size_t                     block_size;
+	void                      *block;
+
+	if (text_map->count >= size)
+		size += (size > 1) ? (size / 2) : 1;
+	if ((arena->used + len) > data_size)
+		data_size = std::max(data_size + data_size / 2, arena->used + len);
+
+	block_size = sizeof(*arena) + 2 * size * sizeof(*(text_map->key)) + data_size;
+	if ((block = OT_MEM_MALLOC(TEXT_MAP, block_size)) == nullptr)
+		return false;
+
+	(void)ot_text_map_arena_set(&retval, block, block_size, size, false);
+	(void)memcpy(OT_TEXT_MAP_DATA(&retval), data, arena->used);
+	OT_TEXT_MAP_ARENA(&retval)->used = arena->used;
+
+	for (retval.count = 0; retval.count < text_map->count; retval.count++) {
+		char *key   = text_map->key[retval.count];
+		char *value = text_map->value[retval.count];
+
+		retval.key[retval.count]   = OT_IN_RANGE(key, data, data + arena->used - 1) ? (OT_TEXT_MAP_DATA(&retval) + (key - data)) : key;
+		retval.value[retval.count] = OT_IN_RANGE(value, data, data + arena->used - 1) ? (OT_TEXT_MAP_DATA(&retval) + (value - data)) : value;
+	}
+
+	if (!arena->is_external)
+		OT_MEM_FREE_CLEAR(TEXT_MAP, arena, arena->size);
+
+	*text_map = retval;
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   ot_text_map_arena_dup -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *   str      -
+ *   len      -
+ *
+ * DESCRIPTION
+ *   Copies the string to the arena and terminates it with the null
+ *   character.  There must be at least len + 1 bytes available.
+ *
+ * RETURN VALUE
+ *   Returns the copy of the string.
+ */
+static char *ot_text_map_arena_dup(struct otc_text_map *text_map, const char *str, size_t len)
+{
+	struct otc_text_map_arena *arena  = OT_TEXT_MAP_ARENA(text_map);
+	char                      *retptr = OT_TEXT_MAP_DATA(text_map) + arena->used;
+
+	(void)memcpy(retptr, str, len);
+	retptr[len]  = '\0';
+	arena->used += len + 1;
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   otc_text_map_arena_new -
+ *
+ * ARGUMENTS
+ *   text_map  -
+ *   size      -
+ *   data_size -
+ *
+ * DESCRIPTION
+ *   Initializes the text map in the arena mode: the arrays of key and value
+ *   pointers for 'size' pairs and 'data_size' bytes of string data are
+ *   allocated in one block.  If text_map is NULL, the text_map structure is
+ *   allocated too.  The keys and values duplicated by otc_text_map_add()
+ *   are copied to the arena, and otc_text_map_destroy() releases the whole
+ *   block at once.
+ *
+ * RETURN VALUE
+ *   Returns the initialized text map, or NULL in case of an error.
+ */
+struct otc_text_map *otc_text_map_arena_new(struct otc_text_map *text_map, size_t size, size_t data_size)
+{
+	struct otc_text_map *retptr = text_map;
+	size_t               block_size;
+
+	if (retptr == nullptr)
+		retptr = OT_CAST_TYPEOF(retptr, OT_MEM_CALLOC(TEXT_MAP, 1, sizeof(*retptr)));
+
+	if (retptr != nullptr) {
+		retptr->key        = nullptr;
+		retptr->value      = nullptr;
+		retptr->is_dynamic = text_map == nullptr;
+		retptr->is_arena   = false;
+		retptr->magic      = 0;
+
+		block_size = sizeof(struct otc_text_map_arena) + 2 * size * sizeof(*(retptr->key)) + data_size;
+		if (!ot_text_map_arena_set(retptr, OT_MEM_MALLOC(TEXT_MAP, block_size), block_size, size, false)) {
 			otc_text_map_destroy(&retptr, OT_CAST_STAT(otc_text_map_flags_t, 0));
-		else if ((retptr->value = OT_CAST_TYPEOF(retptr->value, OTC_DBG_CALLOC(size, sizeof(*(retptr->value))))) == nullptr)
+
+			retptr = nullptr;
+		}
+	}
+
+	return retptr;
+}
+
+
+/***
+ * NAME
+ *   otc_text_map_arena_init -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *   size     -
+ *   buffer   -
+ *   bufsiz   -
+ *
+ * DESCRIPTION
+ *   The same as otc_text_map_arena_new(), but the arena is placed in the
+ *   buffer provided by the caller (for example, on the stack), so no memory
+ *   is allocated as long as the data fits in the buffer.  If it does not,
+ *   the text map is moved to an allocated block; the buffer itself is never
+ *   released.  The buffer must be large enough for the arrays of key and
+ *   value pointers for 'size' pairs.
+ *
+ * RETURN VALUE
+ *   Returns the initialized text map, or NULL in case of an error.
+ */
+struct otc_text_map *otc_text_map_arena_init(struct otc_text_map *text_map, size_t size, void *buffer, size_t bufsiz)
+{
+	struct otc_text_map *retptr = text_map;
+	size_t               align;
+
+	if (buffer == nullptr)
+		return nullptr;
+
+	/* The arena header must be aligned. */
+	align = -OT_CAST_REINTERPRET(uintptr_t, buffer) & (alignof(struct otc_text_map_arena) - 1);
+	if (bufsiz < align)
+		return nullptr;
+
+	if (retptr == nullptr)
+		retptr = OT_CAST_TYPEOF(retptr, OT_MEM_CALLOC(TEXT_MAP, 1, sizeof(*retptr)));
+
+	if (retptr != nullptr) {
+		retptr->key        = nullptr;
+		retptr->value      = nullptr;
+		retptr->is_dynamic = text_map == nullptr;
+		retptr->is_arena   = false;
+		retptr->magic      = 0;
+
+		if (!ot_text_map_arena_set(retptr, OT_CAST_REINTERPRET(char *, buffer) + align, bufsiz - align, size, true)) {
 			otc_text_map_destroy(&retptr, OT_CAST_STAT(otc_text_map_flags_t, 0));
+
+			retptr = nullptr;
+		}
 	}
 
 	return retptr;
@@ -146,6 +494,24 @@ int otc_text_map_add(struct otc_text_map *text_map, const char *key, size_t key_
 	if ((text_map == nullptr) || (key == nullptr) || (value == nullptr))
 		return retval;
 
+	/*
+	 * In the arena mode the duplicated keys and values are copied to the
+	 * arena, which is enlarged if there is not enough space in it.
+	 */
+	if (OT_TEXT_MAP_IS_ARENA(text_map)) {
+		size_t key_size   = (flags & OTC_TEXT_MAP_DUP_KEY) ? (((key_len > 0) ? strnlen(key, key_len) : strlen(key)) + 1) : 0;
+		size_t value_size = (flags & OTC_TEXT_MAP_DUP_VALUE) ? (((value_len > 0) ? strnlen(value, value_len) : strlen(value)) + 1) : 0;
+
+		if ((text_map->count >= text_map->size) || (ot_text_map_arena_avail(text_map) < (key_size + value_size)))
+			if (!ot_text_map_arena_grow(text_map, key_size + value_size))
+				return retval;
+
+		text_map->key[text_map->count]   = (key_size > 0) ? ot_text_map_arena_dup(text_map, key, key_size - 1) : OT_CAST_CONST(char *, key);
+		text_map->value[text_map->count] = (value_size > 0) ? ot_text_map_arena_dup(text_map, value, value_size - 1) : OT_CAST_CONST(char *, value);
+
+		return text_map->count++;
+	}
+
 	/*
 	 * Check if it is necessary to increase the number of key/value pairs.
 	 * The number of pairs is increased by half the current number of pairs
@@ -156,19 +522,27 @@ int otc_text_map_add(struct otc_text_map *text_map, const char *key, size_t key_
 		typeof(text_map->value) ptr_value;
 		size_t                  size_add = (text_map->size > 1) ? (text_map->size / 2) : 1;
 
+		/*
+		 * The memory counter is increased only when both arrays are
+		 * enlarged, because the number of pairs is not changed if one
+		 * of them cannot be.  The arrays that were not allocated by the
+		 * library are not counted.
+		 */
 		if ((ptr_key = OT_CAST_TYPEOF(ptr_key, OTC_DBG_REALLOC(text_map->key, OT_TEXT_MAP_SIZE(key, size_add)))) == nullptr)
 			return retval;
 
 		text_map->key = ptr_key;
-		(void)memset(text_map->key + OT_TEXT_MAP_SIZE(key, 0), 0, sizeof(*(text_map->key)) * size_add);
+		(void)memset(text_map->key + text_map->size, 0, sizeof(*(text_map->key)) * size_add);
 
 		if ((ptr_value = OT_CAST_TYPEOF(ptr_value, OTC_DBG_REALLOC(text_map->value, OT_TEXT_MAP_SIZE(value, size_add)))) == nullptr)
 			return retval;
 
 		text_map->value = ptr_value;
-		(void)memset(text_map->value + OT_TEXT_MAP_SIZE(value, 0), 0, sizeof(*(text_map->value)) * size_add);
+		(void)memset(text_map->value + text_map->size, 0, sizeof(*(text_map->value)) * size_add);
 
 		text_map->size += size_add;
+		if (OT_CARRIER_IS_OWN(text_map))
+			OT_STAT_ADD(MEM_TEXT_MAP, size_add * (sizeof(*(text_map->key)) + sizeof(*(text_map->value))));
 	}
 
 	text_map->key[text_map->count]   = (flags & OTC_TEXT_MAP_DUP_KEY) ? ((key_len > 0) ? OTC_DBG_STRNDUP(key, key_len) : OTC_DBG_STRDUP(key)) : OT_CAST_CONST(char *, key);
@@ -183,6 +557,47 @@ int otc_text_map_add(struct otc_text_map *text_map, const char *key, size_t key_
 }
 
 
+/***
+ * NAME
+ *   otc_text_map_clear -
+ *
+ * ARGUMENTS
+ *   text_map -
+ *   flags    -
+ *
+ * DESCRIPTION
+ *   Removes all key/value pairs from the text map, but keeps the memory
+ *   allocated for them, so the text map can be reused without allocating
+ *   it again.  The keys and values are released according to the flags,
+ *   except in the arena mode, where the flags are not used.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_text_map_clear(struct otc_text_map *text_map, otc_text_map_flags_t flags)
+{
+	if ((text_map == nullptr) || (text_map->key == nullptr))
+		return;
+
+	if (OT_TEXT_MAP_IS_ARENA(text_map)) {
+		OT_TEXT_MAP_ARENA(text_map)->used = 0;
+	} else {
+		for (size_t i = 0; i < text_map->count; i++) {
+			if (flags & OTC_TEXT_MAP_FREE_KEY)
+				OT_FREE(text_map->key[i]);
+			if ((flags & OTC_TEXT_MAP_FREE_VALUE) && (text_map->value != nullptr))
+				OT_FREE(text_map->value[i]);
+
+			text_map->key[i] = nullptr;
+			if (text_map->value != nullptr)
+				text_map->value[i] = nullptr;
+		}
+	}
+
+	text_map->count = 0;
+}
+
+
 /***
  * NAME
  *   otc_text_map_destroy -
@@ -199,15 +614,36 @@ int otc_text_map_add(struct otc_text_map *text_map, const char *key, size_t key_
  */
 void otc_text_map_destroy(struct otc_text_map **text_map, otc_text_map_flags_t flags)
 {
+	size_t size;
+
 	if ((text_map == nullptr) || (*text_map == nullptr))
 		return;
 
+	/*
+	 * In the arena mode, all the data is released at once (unless the
+	 * arena is provided by the caller), the flags are not used.
+	 */
+	if (OT_TEXT_MAP_IS_ARENA(*text_map)) {
+		if (!OT_TEXT_MAP_ARENA(*text_map)->is_external) {
+			struct otc_text_map_arena *arena = OT_TEXT_MAP_ARENA(*text_map);
+
+			OT_MEM_FREE_CLEAR(TEXT_MAP, arena, arena->size);
+		}
+
+		(*text_map)->key      = nullptr;
+		(*text_map)->value    = nullptr;
+		(*text_map)->is_arena = false;
+	}
+
+	/* The arrays that were not allocated by the library are not counted. */
+	size = OT_CARRIER_IS_OWN(*text_map) ? (*text_map)->size : 0;
+
 	if ((*text_map)->key != nullptr) {
 		if (flags & OTC_TEXT_MAP_FREE_KEY)
 			for (size_t i = 0; i < (*text_map)->count; i++)
 				OT_FREE((*text_map)->key[i]);
 
-		OT_FREE_CLEAR((*text_map)->key);
+		OT_MEM_FREE_CLEAR(TEXT_MAP, (*text_map)->key, size * sizeof(*((*text_map)->key)));
 	}
 
 	if ((*text_map)->value != nullptr) {
@@ -215,14 +651,15 @@ void otc_text_map_destroy(struct otc_text_map **text_map, otc_text_map_flags_t f
 			for (size_t i = 0; i < (*text_map)->count; i++)
 				OT_FREE((*text_map)->value[i]);
 
-		OT_FREE_CLEAR((*text_map)->value);
+		OT_MEM_FREE_CLEAR(TEXT_MAP, (*text_map)->value, size * sizeof(*((*text_map)->value)));
 	}
 
 	if ((*text_map)->is_dynamic) {
-		OT_FREE_CLEAR(*text_map);
+		OT_MEM_FREE_CLEAR(TEXT_MAP, *text_map, sizeof(**text_map));
 	} else {
 		(*text_map)->count = 0;
 		(*text_map)->size  = 0;
+		(*text_map)->magic = 0;
 	}
 }
 
@@ -247,24 +684,55 @@ struct otc_binary_data *otc_binary_data_new(struct otc_binary_data *binary_data,
 	struct otc_binary_data *retptr = binary_data;
 
 	if (retptr == nullptr)
-		retptr = OT_CAST_TYPEOF(retptr, OTC_DBG_CALLOC(1, sizeof(*retptr)));
+		retptr = OT_CAST_TYPEOF(retptr, OT_MEM_CALLOC(BINARY_DATA, 1, sizeof(*retptr)));
 
 	if (retptr != nullptr) {
 		retptr->size       = size;
 		retptr->is_dynamic = binary_data == nullptr;
+		retptr->magic      = 0;
+		retptr->capacity   = 0;
 
 		if ((data == nullptr) || (size == 0))
 			/* Do nothing. */;
-		else if ((retptr->data = OTC_DBG_MALLOC(size)) != nullptr)
-			(void)memcpy(retptr->data, data, size);
-		else
+		else if ((retptr->data = OT_MEM_MALLOC(BINARY_DATA, size)) == nullptr)
 			otc_binary_data_destroy(&retptr);
+		else {
+			(void)memcpy(retptr->data, data, size);
+
+			retptr->magic    = OT_CARRIER_MAGIC;
+			retptr->capacity = size;
+		}
 	}
 
 	return retptr;
 }
 
 
+/***
+ * NAME
+ *   otc_binary_data_clear -
+ *
+ * ARGUMENTS
+ *   binary_data -
+ *
+ * DESCRIPTION
+ *   Empties the binary data, but keeps its data buffer, so the next inject
+ *   can write into it without allocating it again.  A data buffer that was
+ *   not allocated by the library is left to the caller; the next inject
+ *   then allocates a new one.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_binary_data_clear(struct otc_binary_data *binary_data)
+{
+	if (binary_data == nullptr)
+		return;
+
+	binary_data->size = 0;
+}
+
+
 /***
  * NAME
  *   otc_binary_data_destroy -
@@ -283,12 +751,16 @@ void otc_binary_data_destroy(struct otc_binary_data **binary_data)
 	if ((binary_data == nullptr) || (*binary_data == nullptr))
 		return;
 
-	OT_FREE_CLEAR((*binary_data)->data);
+	/* A data buffer that was not allocated by the library is not counted. */
+	OT_MEM_FREE_CLEAR(BINARY_DATA, (*binary_data)->data, OT_CARRIER_IS_OWN(*binary_data) ? (*binary_data)->capacity : 0);
 
-	if ((*binary_data)->is_dynamic)
-		OT_FREE_CLEAR(*binary_data);
-	else
-		(*binary_data)->size = 0;
+	if ((*binary_data)->is_dynamic) {
+		OT_MEM_FREE_CLEAR(BINARY_DATA, *binary_data, sizeof(**binary_data));
+	} else {
+		(*binary_data)->size     = 0;
+		(*binary_data)->magic    = 0;
+		(*binary_data)->capacity = 0;
+	}
 }
 
 
@@ -421,6 +893,65 @@ char *otc_file_read(const char *filename, const char *comment, char *errbuf, int
 }
 
 
+/***
+ * NAME
+ *   ot_stats_memory -
+ *
+ * ARGUMENTS
+ *   usage - the structure to be filled in
+ *   cnt   - the statistics counters
+ *
+ * DESCRIPTION
+ *   Fills in the memory usage from the statistics counters and the memory
+ *   counters of the handle tables.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void ot_stats_memory(struct otc_memory_usage *usage, const int64_t *cnt)
+{
+	usage->handle       = ot_span.mem() + ot_span_context.mem();
+	usage->span         = cnt[OT_STAT_MEM_SPAN];
+	usage->span_context = cnt[OT_STAT_MEM_CTX];
+	usage->text_map     = cnt[OT_STAT_MEM_TEXT_MAP];
+	usage->binary_data  = cnt[OT_STAT_MEM_BINARY_DATA];
+}
+
+
+/***
+ * NAME
+ *   otc_statistics_memory -
+ *
+ * ARGUMENTS
+ *   usage - the structure to be filled in
+ *
+ * DESCRIPTION
+ *   Reports the number of bytes currently held by the library for the
+ *   handle tables, the span and span context structures, the text maps and
+ *   the binary data.  The bytes are counted per thread when the memory is
+ *   allocated or released, and summed up here.  The keys and values that
+ *   otc_text_map_add() duplicates outside of the arena are not counted,
+ *   because the text map can also release strings it did not duplicate
+ *   (such as the baggage items).  The baggage items are released by the
+ *   application, so they are not counted either; otc_statistics() shows
+ *   the total number of bytes returned so far instead.  The bytes are not
+ *   attributed to call sites (see struct otc_memory_usage for the limits).
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void otc_statistics_memory(struct otc_memory_usage *usage)
+{
+	int64_t cnt[OT_STAT_MAX];
+
+	if (usage == nullptr)
+		return;
+
+	ot_stats_get(cnt);
+	ot_stats_memory(usage, cnt);
+}
+
+
 /***
  * NAME
  *   otc_statistics -
@@ -437,12 +968,62 @@ char *otc_file_read(const char *filename, const char *comment, char *errbuf, int
  */
 void otc_statistics(char *buffer, size_t bufsiz)
 {
+	struct otc_memory_usage usage;
+	size_t                  span_size = 0, span_context_size = 0;
+	int64_t                 span_keys, span_context_keys, cnt[OT_STAT_MAX], calls_rate = 0;
+
 	if ((buffer == nullptr) || (bufsiz < 24))
 		return;
 
-	(void)snprintf(buffer, bufsiz, "span: %" PRId64 "/%" PRId64 "+%" PRId64 "(%" PRId64 ")/%" PRId64 ", context: %" PRId64 "/%" PRId64 "+%" PRId64 "(%"  PRId64 ")/%" PRId64,
-	               ot_span.key, ot_span_handle.size(), ot_span.erase_cnt, ot_span.destroy_cnt, ot_span.alloc_fail_cnt,
-	               ot_span_context.key, ot_span_context_handle.size(), ot_span_context.erase_cnt, ot_span_context.destroy_cnt, ot_span_context.alloc_fail_cnt);
+	span_keys         = ot_span.keys();
+	span_context_keys = ot_span_context.keys();
+	ot_stats_get(cnt);
+	ot_stats_memory(&usage, cnt);
+
+	{
+		const std::lock_guard<std::mutex> guard(ot_stats.mutex);
+		auto                              now = std::chrono::steady_clock::now();
+		auto                              ms  = std::chrono::duration_cast<std::chrono::milliseconds>(now - ot_stats.time).count();
+
+		/* The number of calls per second since the previous call. */
+		if (ms > 0)
+			calls_rate = (cnt[OT_STAT_CALLS] - ot_stats.calls) * 1000 / ms;
+
+		ot_stats.calls = cnt[OT_STAT_CALLS];
+		ot_stats.time  = now;
+	}
+
+#ifdef OT_DIRECT_SPANS
+	/*
+	 * The spans and the extracted span contexts are not kept in the
+	 * handle tables.  Only the extracted span contexts have their index.
+	 */
+	span_size         = OT_CAST_STAT(size_t, span_keys - cnt[OT_STAT_SPAN_ALLOC_FAIL] - cnt[OT_STAT_SPAN_DESTROY]);
+	span_context_size = OT_CAST_STAT(size_t, span_context_keys - cnt[OT_STAT_CTX_ERASE]);
+#elif defined(OT_THREADS_NO_LOCKING)
+	span_size         = ot_span.size();
+	span_context_size = ot_span_context.size();
+#else
+	for (int i = 0; i < OT_HANDLE_SHARDS; i++) {
+		{
+			OT_LOCK_GUARD(span, i);
+
+			span_size += ot_span_handle(i).size();
+		}
+		{
+			OT_LOCK_GUARD(span_context, i);
+
+			span_context_size += ot_span_context_handle(i).size();
+		}
+	}
+#endif
+
+	(void)snprintf(buffer, bufsiz, "span: %" PRId64 "/%zu+%" PRId64 "(%" PRId64 ")/%" PRId64 ", context: %" PRId64 "/%zu+%" PRId64 "(%"  PRId64 ")/%" PRId64 ", pool hit/miss: %" PRId64 "/%" PRId64 "+%" PRId64 "/%" PRId64 ", cross-thread: %" PRId64 ", sampled out: %" PRId64 ", async finish/deleted: %" PRId64 "/%" PRId64 ", calls: %" PRId64 " (%" PRId64 "/s), lock wait: %" PRId64 " (%" PRId64 " us), memory: %" PRId64 "+%" PRId64 "+%" PRId64 "+%" PRId64 "+%" PRId64 " bytes, baggage returned: %" PRId64 " bytes",
+	               span_keys, span_size, cnt[OT_STAT_SPAN_ERASE], cnt[OT_STAT_SPAN_DESTROY], cnt[OT_STAT_SPAN_ALLOC_FAIL],
+	               span_context_keys, span_context_size, cnt[OT_STAT_CTX_ERASE], cnt[OT_STAT_CTX_DESTROY], cnt[OT_STAT_CTX_ALLOC_FAIL],
+	               cnt[OT_STAT_SPAN_POOL_HIT], cnt[OT_STAT_SPAN_POOL_MISS], cnt[OT_STAT_CTX_POOL_HIT], cnt[OT_STAT_CTX_POOL_MISS],
+	               cnt[OT_STAT_CROSS_THREAD], cnt[OT_STAT_SPAN_SAMPLED_OUT], cnt[OT_STAT_FINISH_ASYNC], cnt[OT_STAT_FINISH_DELETED], cnt[OT_STAT_CALLS], calls_rate, cnt[OT_STAT_LOCK_WAIT], cnt[OT_STAT_LOCK_WAIT_NS] / 1000,
+	               usage.handle, usage.span, usage.span_context, usage.text_map, usage.binary_data, cnt[OT_STAT_BAGGAGE_RETURNED]);
 }
 
 /*
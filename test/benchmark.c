@@ -0,0 +1,1141 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+#define BENCH_TAGS   16
+
+
+struct bench_headers {
+	struct otc_http_headers_writer wr;
+	char                           buf[1024];
+	size_t                         len;
+};
+
+
+struct bench_worker {
+	pthread_t                         thread;
+	int                               id;
+	struct otc_tracer                *tracer;
+	uint64_t                          count;
+	struct otc_http_headers_writer    wr;
+	struct otc_custom_carrier_writer  bin_wr;
+};
+
+static __thread struct {
+	struct timespec steady;
+	struct timespec system;
+} bench_clock;
+
+static struct {
+	otc_atom_t span;
+	otc_atom_t event;
+	otc_atom_t tag[BENCH_TAGS];
+} bench_atom;
+
+static struct {
+	const struct bench_def *def;
+	int                     runcount;
+	volatile bool           flag_run;
+	volatile bool           flag_stop;
+	struct bench_worker     worker[BENCHMARK_MAX_THREADS];
+} bench;
+
+
+/***
+ * NAME
+ *   bench_span_run -
+ *
+ * ARGUMENTS
+ *   worker    -
+ *   str_flags - flags of the string values
+ *
+ * DESCRIPTION
+ *   One pass of the span benchmark: a span is started, several tags are set,
+ *   one log entry is added and the span is finished.  Every operation on the
+ *   span goes through the span handle table of the library.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_span_run(struct bench_worker *worker, int str_flags)
+{
+	const struct otc_log_field  fields[] = {
+		{ "event", { .type = otc_value_string | str_flags, .value.string_value = "benchmark" } },
+		{ "count", { .type = otc_value_string | str_flags, .value.string_value = "1" } },
+	};
+	struct otc_value            value;
+	struct otc_span            *span;
+
+	if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark span")))
+		return;
+
+	value.type               = otc_value_string | str_flags;
+	value.value.string_value = "GET";
+	otc_span_set_tag(span, "http.method", &value);
+
+	value.value.string_value = "/index.html";
+	otc_span_set_tag(span, "http.url", &value);
+
+	value.type              = otc_value_int64;
+	value.value.int64_value = 200;
+	otc_span_set_tag(span, "http.status_code", &value);
+
+	value.type             = otc_value_bool;
+	value.value.bool_value = otc_false;
+	otc_span_set_tag(span, "error", &value);
+
+	otc_span_log_fields(span, fields, TABLESIZE(fields));
+
+	otc_span_finish(span);
+}
+
+
+/***
+ * NAME
+ *   bench_span -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The span benchmark, the string values are copied by the library.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_span(struct bench_worker *worker)
+{
+	bench_span_run(worker, 0);
+}
+
+
+/***
+ * NAME
+ *   bench_span_persistent -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The span benchmark, the string values are marked as persistent so the
+ *   library does not copy them.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_span_persistent(struct bench_worker *worker)
+{
+	bench_span_run(worker, OTC_VALUE_PERSISTENT);
+}
+
+
+/***
+ * NAME
+ *   bench_span_sampled -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The span benchmark with the probabilistic sampler of the wrapper, which
+ *   samples 1% of the spans.  The sampler, and the header format that it
+ *   requires, are set only for the duration of the pass.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_span_sampled(struct bench_worker *worker)
+{
+	(void)otc_tracer_propagation_format(otc_propagation_format_w3c);
+	(void)otc_tracer_sampler(otc_sampler_probabilistic, 0.01, false);
+
+	bench_span_run(worker, 0);
+
+	(void)otc_tracer_sampler(otc_sampler_none, 0, false);
+	(void)otc_tracer_propagation_format(otc_propagation_format_none);
+}
+
+
+/***
+ * NAME
+ *   bench_clock_cb -
+ *
+ * ARGUMENTS
+ *   steady -
+ *   system -
+ *
+ * DESCRIPTION
+ *   The clock callback of the span-clock-cb benchmark, which returns the
+ *   time cached by the calling thread.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_clock_cb(struct timespec *steady, struct timespec *system)
+{
+	if (_nNULL(steady))
+		*steady = bench_clock.steady;
+	if (_nNULL(system))
+		*system = bench_clock.system;
+}
+
+
+/***
+ * NAME
+ *   bench_span_clock_cb -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The span benchmark with the timestamps taken from the time cached by
+ *   the thread, the way an event loop reads the time once per iteration and
+ *   uses it for all the requests it processes.  Here the time is read once
+ *   every 16 passes.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_span_clock_cb(struct bench_worker *worker)
+{
+	if ((worker->count % 16) == 0) {
+		(void)clock_gettime(CLOCK_MONOTONIC, &(bench_clock.steady));
+		(void)clock_gettime(CLOCK_REALTIME, &(bench_clock.system));
+	}
+
+	bench_span_run(worker, 0);
+}
+
+
+/***
+ * NAME
+ *   bench_tags_init -
+ *
+ * ARGUMENTS
+ *   tags - array of BENCH_TAGS tags
+ *
+ * DESCRIPTION
+ *   Fills the tag array used by the tag benchmarks.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_tags_init(struct otc_tag *tags)
+{
+	static const char *key[BENCH_TAGS] = {
+		"http.method", "http.url", "http.host", "http.user_agent", "http.status_code", "http.version",
+		"peer.ipv4", "peer.port", "component", "span.kind", "frontend", "backend",
+		"server", "request.size", "response.size", "error"
+	};
+	int i;
+
+	for (i = 0; i < BENCH_TAGS; i++) {
+		tags[i].key = key[i];
+
+		if (i % 4 == 0) {
+			tags[i].value.type              = otc_value_int64;
+			tags[i].value.value.int64_value = i * 100;
+		} else {
+			tags[i].value.type               = otc_value_string;
+			tags[i].value.value.string_value = key[i];
+		}
+	}
+}
+
+
+/***
+ * NAME
+ *   bench_tags -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   One pass of the tags benchmark: a span is started, BENCH_TAGS tags are
+ *   set one by one, one log entry is added and the span is finished.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_tags(struct bench_worker *worker)
+{
+	static const struct otc_log_field  fields[] = {
+		{ "event", { .type = otc_value_string, .value.string_value = "benchmark" } },
+	};
+	struct otc_tag                     tags[BENCH_TAGS];
+	struct otc_span                   *span;
+	int                                i;
+
+	bench_tags_init(tags);
+
+	if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark span")))
+		return;
+
+	for (i = 0; i < BENCH_TAGS; i++)
+		otc_span_set_tag(span, tags[i].key, &(tags[i].value));
+
+	otc_span_log_fields(span, fields, TABLESIZE(fields));
+
+	otc_span_finish(span);
+}
+
+
+/***
+ * NAME
+ *   bench_tags_batch -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The same as bench_tags(), but the tags, the log entry and the span
+ *   completion are passed to the library in one call.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_tags_batch(struct bench_worker *worker)
+{
+	static const struct otc_log_field  fields[] = {
+		{ "event", { .type = otc_value_string, .value.string_value = "benchmark" } },
+	};
+	struct otc_tag                     tags[BENCH_TAGS];
+	struct otc_span                   *span;
+
+	bench_tags_init(tags);
+
+	if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark span")))
+		return;
+
+	otc_span_set_tags_log_finish(span, tags, BENCH_TAGS, fields, TABLESIZE(fields));
+}
+
+
+/***
+ * NAME
+ *   bench_tags_atom -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The same as bench_tags(), with the operation name and the keys interned
+ *   by bench_tags_atom_setup().
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_tags_atom(struct bench_worker *worker)
+{
+	const struct otc_log_field_atom  fields[] = {
+		{ bench_atom.event, { .type = otc_value_string, .value.string_value = "benchmark" } },
+	};
+	struct otc_tag                   tags[BENCH_TAGS];
+	struct otc_span                 *span;
+	int                              i;
+
+	bench_tags_init(tags);
+
+	if (_NULL(span = worker->tracer->start_span_atom(worker->tracer, bench_atom.span, NULL)))
+		return;
+
+	for (i = 0; i < BENCH_TAGS; i++)
+		otc_span_set_tag_atom(span, bench_atom.tag[i], &(tags[i].value));
+
+	otc_span_log_fields_atom(span, fields, TABLESIZE(fields));
+
+	otc_span_finish(span);
+}
+
+
+/***
+ * NAME
+ *   bench_propagation_run -
+ *
+ * ARGUMENTS
+ *   worker -
+ *   wr     - the writer reused by the worker, or NULL
+ *   buffer - the arena buffer for the injected data, or NULL
+ *   bufsiz - the size of the arena buffer
+ *
+ * DESCRIPTION
+ *   One pass of the propagation benchmarks: the context of a new span is
+ *   injected into the HTTP headers, extracted from them again and the span
+ *   is finished.  If the writer is not specified, a new one is used in each
+ *   pass; if the buffer is specified, the headers are injected into the
+ *   arena placed in it.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_propagation_run(struct bench_worker *worker, struct otc_http_headers_writer *wr, void *buffer, size_t bufsiz)
+{
+	struct otc_http_headers_writer  wr_local;
+	struct otc_http_headers_reader  rd;
+	struct otc_text_map            *text_map = &(wr_local.text_map);
+	struct otc_span_context        *context, *context_ex = NULL;
+	struct otc_span                *span;
+
+	if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark span")))
+		return;
+
+	if (_NULL(wr)) {
+		(void)memset(&wr_local, 0, sizeof(wr_local));
+
+		if (_nNULL(buffer))
+			(void)otc_text_map_arena_init(text_map, 4, buffer, bufsiz);
+	}
+	(void)memset(&rd, 0, sizeof(rd));
+
+	if (_nNULL(context = otc_span_get_context(span))) {
+		if (worker->tracer->inject_http_headers(worker->tracer, _NULL(wr) ? &wr_local : wr, context) == otc_propagation_error_code_success) {
+			(void)memcpy(&(rd.text_map), _NULL(wr) ? &(wr_local.text_map) : &(wr->text_map), sizeof(rd.text_map));
+
+			if (worker->tracer->extract_http_headers(worker->tracer, &rd, &context_ex) == otc_propagation_error_code_success)
+				context_ex->destroy(&context_ex);
+		}
+
+		context->destroy(&context);
+	}
+
+	if (_NULL(wr))
+		otc_text_map_destroy(&text_map, OTC_TEXT_MAP_FREE_KEY | OTC_TEXT_MAP_FREE_VALUE);
+
+	otc_span_finish(span);
+}
+
+
+/***
+ * NAME
+ *   bench_propagation -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_propagation(struct bench_worker *worker)
+{
+	bench_propagation_run(worker, NULL, NULL, 0);
+}
+
+
+/***
+ * NAME
+ *   bench_propagation_arena -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_propagation_arena(struct bench_worker *worker)
+{
+	uint64_t buffer[64];
+
+	bench_propagation_run(worker, NULL, buffer, sizeof(buffer));
+}
+
+
+/***
+ * NAME
+ *   bench_propagation_reuse -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   The text map of the writer is an arena, which the inject function
+ *   clears and reuses.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_propagation_reuse(struct bench_worker *worker)
+{
+	if (_NULL(worker->wr.text_map.key))
+		(void)otc_text_map_arena_new(&(worker->wr.text_map), 4, 256);
+
+	bench_propagation_run(worker, &(worker->wr), NULL, 0);
+}
+
+
+/***
+ * NAME
+ *   bench_binary_run -
+ *
+ * ARGUMENTS
+ *   worker -
+ *   wr     - the writer reused by the worker, or NULL
+ *
+ * DESCRIPTION
+ *   One pass of the binary propagation benchmarks: the context of a new
+ *   span is injected in the binary format, extracted again and the span is
+ *   finished.  If the writer is not specified, a new one is used in each
+ *   pass.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_binary_run(struct bench_worker *worker, struct otc_custom_carrier_writer *wr)
+{
+	struct otc_custom_carrier_writer  wr_local;
+	struct otc_custom_carrier_reader  rd;
+	struct otc_binary_data           *binary_data = &(wr_local.binary_data);
+	struct otc_span_context          *context, *context_ex = NULL;
+	struct otc_span                  *span;
+
+	if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark span")))
+		return;
+
+	if (_NULL(wr)) {
+		(void)memset(&wr_local, 0, sizeof(wr_local));
+
+		wr = &wr_local;
+	}
+	(void)memset(&rd, 0, sizeof(rd));
+
+	if (_nNULL(context = otc_span_get_context(span))) {
+		if (worker->tracer->inject_binary(worker->tracer, wr, context) == otc_propagation_error_code_success) {
+			(void)memcpy(&(rd.binary_data), &(wr->binary_data), sizeof(rd.binary_data));
+
+			if (worker->tracer->extract_binary(worker->tracer, &rd, &context_ex) == otc_propagation_error_code_success)
+				context_ex->destroy(&context_ex);
+		}
+
+		context->destroy(&context);
+	}
+
+	if (wr == &wr_local)
+		otc_binary_data_destroy(&binary_data);
+
+	otc_span_finish(span);
+}
+
+
+/***
+ * NAME
+ *   bench_binary -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_binary(struct bench_worker *worker)
+{
+	bench_binary_run(worker, NULL);
+}
+
+
+/***
+ * NAME
+ *   bench_binary_reuse -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_binary_reuse(struct bench_worker *worker)
+{
+	bench_binary_run(worker, &(worker->bin_wr));
+}
+
+
+/***
+ * NAME
+ *   bench_inject_cb_set -
+ *
+ * ARGUMENTS
+ *   writer -
+ *   key    -
+ *   value  -
+ *
+ * DESCRIPTION
+ *   The set() callback of the inject-cb benchmark; the header is written
+ *   to the buffer that follows the writer structure, as a proxy would write
+ *   it to the request.
+ *
+ * RETURN VALUE
+ *   Returns otc_propagation_error_code_success, or
+ *   otc_propagation_error_code_unknown if the buffer is full.
+ */
+static otc_propagation_error_code_t bench_inject_cb_set(struct otc_http_headers_writer *writer, const char *key, const char *value)
+{
+	struct bench_headers *headers = (struct bench_headers *)writer;
+	int                   len;
+
+	len = snprintf(headers->buf + headers->len, sizeof(headers->buf) - headers->len, "%s: %s\r\n", key, value);
+	if ((len < 0) || ((size_t)len >= (sizeof(headers->buf) - headers->len)))
+		return otc_propagation_error_code_unknown;
+
+	headers->len += len;
+
+	return otc_propagation_error_code_success;
+}
+
+
+/***
+ * NAME
+ *   bench_inject_cb -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   One pass of the inject-cb benchmark: the context of a new span is
+ *   injected through the set() callback of the writer and the span is
+ *   finished.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_inject_cb(struct bench_worker *worker)
+{
+	struct bench_headers     headers;
+	struct otc_span_context *context;
+	struct otc_span         *span;
+
+	if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark span")))
+		return;
+
+	(void)memset(&(headers.wr), 0, sizeof(headers.wr));
+	headers.wr.set = bench_inject_cb_set;
+	headers.len    = 0;
+
+	if (_nNULL(context = otc_span_get_context(span))) {
+		(void)worker->tracer->inject_http_headers(worker->tracer, &(headers.wr), context);
+
+		context->destroy(&context);
+	}
+
+	otc_span_finish(span);
+}
+
+
+/***
+ * NAME
+ *   bench_extract_child -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   One pass of the extract-child benchmark: the span context is extracted
+ *   from the http headers of a request and a child span of it is started
+ *   and finished.  The headers are injected from a span only once, in the
+ *   first pass of the thread, into the writer of the thread.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_extract_child(struct bench_worker *worker)
+{
+	struct otc_start_span_options   options;
+	struct otc_span_reference       reference;
+	struct otc_http_headers_reader  rd;
+	struct otc_span_context        *context = NULL;
+	struct otc_span                *span;
+
+	if (worker->wr.text_map.count == 0) {
+		if (_NULL(span = worker->tracer->start_span(worker->tracer, "benchmark parent span")))
+			return;
+
+		if (_nNULL(context = otc_span_get_context(span))) {
+			(void)worker->tracer->inject_http_headers(worker->tracer, &(worker->wr), context);
+
+			context->destroy(&context);
+		}
+
+		otc_span_finish(span);
+	}
+
+	(void)memset(&rd, 0, sizeof(rd));
+	(void)memcpy(&(rd.text_map), &(worker->wr.text_map), sizeof(rd.text_map));
+
+	if (worker->tracer->extract_http_headers(worker->tracer, &rd, &context) != otc_propagation_error_code_success)
+		return;
+
+	(void)memset(&options, 0, sizeof(options));
+	reference.type               = otc_span_reference_child_of;
+	reference.referenced_context = context;
+	options.references           = &reference;
+	options.num_references       = 1;
+
+	if (_nNULL(span = worker->tracer->start_span_with_options(worker->tracer, "benchmark span", &options)))
+		otc_span_finish(span);
+
+	context->destroy(&context);
+}
+
+
+/***
+ * NAME
+ *   bench_codec -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   One pass of the codec benchmark: a W3C trace context is written to the
+ *   arena on the stack and read back, with the wrapper's own codecs only.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_codec(struct bench_worker *worker)
+{
+	struct otc_trace_context context = { 0, worker->count + 1, worker->id + 1, 0, OTC_TRACE_FLAG_SAMPLED, NULL }, context_ex;
+	struct otc_text_map      text_map;
+	char                     buffer[256];
+
+	(void)otc_text_map_arena_init(&text_map, 2, buffer, sizeof(buffer));
+
+	if (otc_propagation_encode(&text_map, otc_propagation_format_w3c, &context) == otc_propagation_error_code_success)
+		(void)otc_propagation_decode(&text_map, otc_propagation_format_w3c, &context_ex);
+}
+
+
+/***
+ * NAME
+ *   bench_extract_miss_run -
+ *
+ * ARGUMENTS
+ *   worker -
+ *   format - the header format checked by the wrapper
+ *
+ * DESCRIPTION
+ *   One pass of the extract-miss benchmarks: the extraction of a span
+ *   context from the http headers of a request that does not carry one.
+ *   The header format is set only for the duration of the pass.
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_extract_miss_run(struct bench_worker *worker, otc_propagation_format_t format)
+{
+	static const char *const key[] = { "host", "user-agent", "accept", "accept-encoding", "accept-language", "cookie", "referer", "x-forwarded-for" };
+	static const char *const value[] = { "www.example.com", "Mozilla/5.0", "*/*", "gzip, deflate, br", "en-US,en;q=0.5", "session=0123456789abcdef", "https://www.example.com/", "192.0.2.1" };
+	struct otc_http_headers_reader  rd;
+	struct otc_span_context        *context = NULL;
+
+	(void)otc_tracer_propagation_format(format);
+
+	(void)memset(&rd, 0, sizeof(rd));
+	rd.text_map.key   = (char **)key;
+	rd.text_map.value = (char **)value;
+	rd.text_map.count = rd.text_map.size = TABLESIZE(key);
+
+	if (worker->tracer->extract_http_headers(worker->tracer, &rd, &context) == otc_propagation_error_code_success)
+		context->destroy(&context);
+
+	(void)otc_tracer_propagation_format(otc_propagation_format_none);
+}
+
+
+/***
+ * NAME
+ *   bench_extract_miss -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_extract_miss(struct bench_worker *worker)
+{
+	bench_extract_miss_run(worker, otc_propagation_format_none);
+}
+
+
+/***
+ * NAME
+ *   bench_extract_miss_codec -
+ *
+ * ARGUMENTS
+ *   worker -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+static void bench_extract_miss_codec(struct bench_worker *worker)
+{
+	bench_extract_miss_run(worker, otc_propagation_format_w3c);
+}
+
+
+/***
+ * NAME
+ *   bench_span_async_setup -
+ *
+ * ARGUMENTS
+ *   flag_start -
+ *
+ * DESCRIPTION
+ *   Sets up the span-async benchmark: the spans are finished by the
+ *   background thread of the library, through a queue of 4096 spans.  The
+ *   thread is stopped at the end of each step, after the time is measured,
+ *   so the spans left in the queue are finished outside of the measured
+ *   time.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 in case of an error.
+ */
+static int bench_span_async_setup(bool flag_start)
+{
+	return otc_tracer_finish_async(flag_start ? 4096 : 0, otc_finish_policy_block);
+}
+
+
+/***
+ * NAME
+ *   bench_tags_atom_setup -
+ *
+ * ARGUMENTS
+ *   flag_start -
+ *
+ * DESCRIPTION
+ *   Interns the operation name and the keys used by the tags-atom
+ *   benchmark.  Interning the same string again returns the same atom.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 in case of an error.
+ */
+static int bench_tags_atom_setup(bool flag_start)
+{
+	struct otc_tag tags[BENCH_TAGS];
+	int            i;
+
+	if (!flag_start)
+		return 0;
+
+	bench_tags_init(tags);
+
+	bench_atom.span  = otc_intern("benchmark span");
+	bench_atom.event = otc_intern("event");
+	if ((bench_atom.span < 0) || (bench_atom.event < 0))
+		return -1;
+
+	for (i = 0; i < BENCH_TAGS; i++)
+		if ((bench_atom.tag[i] = otc_intern(tags[i].key)) < 0)
+			return -1;
+
+	return 0;
+}
+
+
+/***
+ * NAME
+ *   bench_coarse_setup -
+ *
+ * ARGUMENTS
+ *   flag_start -
+ *
+ * DESCRIPTION
+ *   Sets up the span-coarse benchmark: the wrapper reads the coarse clocks
+ *   for the timestamps.  The tracer reads the clocks again after the step.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 in case of an error.
+ */
+static int bench_coarse_setup(bool flag_start)
+{
+	return otc_tracer_clock(flag_start ? otc_clock_coarse : otc_clock_tracer, NULL);
+}
+
+
+/***
+ * NAME
+ *   bench_clock_cb_setup -
+ *
+ * ARGUMENTS
+ *   flag_start -
+ *
+ * DESCRIPTION
+ *   Sets up the span-clock-cb benchmark: the timestamps are taken from the
+ *   bench_clock_cb() callback.
+ *
+ * RETURN VALUE
+ *   Returns 0 on success, or -1 in case of an error.
+ */
+static int bench_clock_cb_setup(bool flag_start)
+{
+	return otc_tracer_clock(flag_start ? otc_clock_callback : otc_clock_tracer, bench_clock_cb);
+}
+
+
+static const struct bench_def {
+	const char  *name;
+	const char  *desc;
+	void       (*fn)(struct bench_worker *);
+	int        (*setup)(bool);
+} bench_def[] = {
+	{ "span",               "start a span, set 4 tags, log 2 fields and finish the span",      bench_span,               NULL                   },
+	{ "span-persistent",    "the same as 'span', with persistent string values",               bench_span_persistent,    NULL                   },
+	{ "span-sampled",       "the same as 'span', with 1% of the spans sampled by the wrapper", bench_span_sampled,       NULL                   },
+	{ "span-async",         "the same as 'span', with the spans finished in the background",   bench_span,               bench_span_async_setup },
+	{ "span-coarse",        "the same as 'span', with the timestamps from the coarse clocks",  bench_span,               bench_coarse_setup     },
+	{ "span-clock-cb",      "the same as 'span', with the timestamps cached by the thread",    bench_span_clock_cb,      bench_clock_cb_setup   },
+	{ "tags",               "start a span, set 16 tags one by one, log and finish",            bench_tags,               NULL                   },
+	{ "tags-batch",         "the same as 'tags', in one set_tags_log_finish call",             bench_tags_batch,         NULL                   },
+	{ "tags-atom",          "the same as 'tags', with the operation name and keys interned",   bench_tags_atom,          bench_tags_atom_setup  },
+	{ "propagation",        "start a span, inject and extract its context, finish",            bench_propagation,        NULL                   },
+	{ "propagation-arena",  "the same as 'propagation', with the arena on the stack",          bench_propagation_arena,  NULL                   },
+	{ "propagation-reuse",  "the same as 'propagation', with a writer reused by the thread",   bench_propagation_reuse,  NULL                   },
+	{ "binary",             "start a span, inject and extract its binary context, finish",     bench_binary,             NULL                   },
+	{ "binary-reuse",       "the same as 'binary', with a writer reused by the thread",        bench_binary_reuse,       NULL                   },
+	{ "codec",              "write and read a W3C trace context with the wrapper codecs",      bench_codec,              NULL                   },
+	{ "extract-miss",       "extract from http headers without a span context",                bench_extract_miss,       NULL                   },
+	{ "extract-miss-codec", "the same as 'extract-miss', checked by the W3C codec first",      bench_extract_miss_codec, NULL                   },
+	{ "inject-cb",          "start a span, inject its context via set(), finish",              bench_inject_cb,          NULL                   },
+	{ "extract-child",      "extract a span context from http headers, start a child span",    bench_extract_child,      NULL                   },
+};
+
+
+/***
+ * NAME
+ *   bench_thread -
+ *
+ * ARGUMENTS
+ *   data -
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static void *bench_thread(void *data)
+{
+	struct bench_worker    *worker = data;
+	struct otc_text_map    *text_map;
+	struct otc_binary_data *binary_data;
+
+	OT_FUNC("%p", data);
+
+	while (!bench.flag_run)
+		nsleep(0, 1000000);
+
+	for ( ; !bench.flag_stop; worker->count++) {
+		if ((bench.runcount > 0) && ((uint)bench.runcount <= worker->count))
+			break;
+
+		bench.def->fn(worker);
+	}
+
+	text_map = &(worker->wr.text_map);
+	otc_text_map_destroy(&text_map, OTC_TEXT_MAP_FREE_KEY | OTC_TEXT_MAP_FREE_VALUE);
+	binary_data = &(worker->bin_wr.binary_data);
+	otc_binary_data_destroy(&binary_data);
+
+	return NULL;
+}
+
+
+/***
+ * NAME
+ *   bench_step -
+ *
+ * ARGUMENTS
+ *   tracer     -
+ *   threads    -
+ *   runtime_ms -
+ *
+ * DESCRIPTION
+ *   Runs the selected benchmark with the specified number of threads and
+ *   prints the achieved throughput.
+ *
+ * RETURN VALUE
+ *   Returns EX_OK on success, or EX_OSERR if the threads could not be
+ *   started.
+ */
+static int bench_step(struct otc_tracer *tracer, int threads, int runtime_ms)
+{
+	struct timespec start, end;
+	uint64_t        total_count = 0, elapsed_us;
+	int             i, num_threads = 0;
+
+	OT_FUNC("%p, %d, %d", tracer, threads, runtime_ms);
+
+	bench.flag_run  = 0;
+	bench.flag_stop = 0;
+
+	if (_nNULL(bench.def->setup) && (bench.def->setup(true) == -1)) {
+		(void)fprintf(stderr, "ERROR: Failed to set up benchmark %s\n", bench.def->name);
+
+		return EX_SOFTWARE;
+	}
+
+	for (i = 0; i < threads; i++) {
+		bench.worker[i].id     = i + 1;
+		bench.worker[i].tracer = tracer;
+		bench.worker[i].count  = 0;
+		(void)memset(&(bench.worker[i].wr), 0, sizeof(bench.worker[i].wr));
+		(void)memset(&(bench.worker[i].bin_wr), 0, sizeof(bench.worker[i].bin_wr));
+
+		if (pthread_create(&(bench.worker[i].thread), NULL, bench_thread, bench.worker + i) != 0) {
+			(void)fprintf(stderr, "ERROR: Failed to start benchmark thread %d: %m\n", bench.worker[i].id);
+
+			break;
+		}
+
+		num_threads++;
+	}
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &start);
+	bench.flag_run = 1;
+
+	if (runtime_ms > 0) {
+		nsleep(runtime_ms / 1000, (runtime_ms % 1000) * 1000000);
+
+		bench.flag_stop = 1;
+	}
+
+	for (i = 0; i < num_threads; i++) {
+		(void)pthread_join(bench.worker[i].thread, NULL);
+
+		total_count += bench.worker[i].count;
+	}
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (_nNULL(bench.def->setup))
+		(void)bench.def->setup(false);
+
+	elapsed_us = (end.tv_sec - start.tv_sec) * 1000000ULL + (end.tv_nsec - start.tv_nsec) / 1000;
+	if (elapsed_us == 0)
+		elapsed_us = 1;
+
+	OT_LOG("benchmark %s: %2d thread(s), %10" PRIu64 " pass(es) in %6" PRIu64 " ms, %12.0f pass(es)/s, %8.1f ns/pass",
+	       bench.def->name, num_threads, total_count, elapsed_us / 1000,
+	       total_count * 1e6 / elapsed_us,
+	       (total_count > 0) ? (elapsed_us * 1e3 * num_threads / total_count) : 0.0);
+
+	return (num_threads == threads) ? EX_OK : EX_OSERR;
+}
+
+
+/***
+ * NAME
+ *   benchmark_run -
+ *
+ * ARGUMENTS
+ *   tracer     -
+ *   name       -
+ *   threads    -
+ *   runtime_ms -
+ *   runcount   -
+ *
+ * DESCRIPTION
+ *   Runs the benchmark named 'name' repeatedly, with 1, 2, 4, ... threads,
+ *   up to 'threads' (but at most BENCHMARK_MAX_THREADS) threads.  Each step
+ *   lasts 'runtime_ms' milliseconds, or each thread executes the benchmark
+ *   'runcount' times.  The name can also be a comma-separated list of
+ *   benchmarks, which are then run one after another so that their results
+ *   can be compared.
+ *
+ * RETURN VALUE
+ *   Returns EX_OK on success, or one of the sysexits error codes.
+ */
+int benchmark_run(struct otc_tracer *tracer, const char *name, int threads, int runtime_ms, int runcount)
+{
+	const char *ptr;
+	size_t      len;
+	int         i, n, retval = EX_OK;
+
+	OT_FUNC("%p, \"%s\", %d, %d, %d", tracer, name, threads, runtime_ms, runcount);
+
+	bench.runcount = (runtime_ms > 0) ? 0 : runcount;
+
+	for (ptr = name; (retval == EX_OK) && (*ptr != '\0'); ptr += len + ((ptr[len] == ',') ? 1 : 0)) {
+		len       = strcspn(ptr, ",");
+		bench.def = NULL;
+
+		for (i = 0; i < TABLESIZE(bench_def); i++)
+			if ((strlen(bench_def[i].name) == len) && (strncmp(bench_def[i].name, ptr, len) == 0))
+				bench.def = bench_def + i;
+
+		if (_NULL(bench.def)) {
+			(void)fprintf(stderr, "ERROR: unknown benchmark '%.*s'\n", (int)len, ptr);
+			benchmark_list();
+
+			return EX_USAGE;
+		}
+
+		for (n = 1; (retval == EX_OK) && (n <= MIN(threads, BENCHMARK_MAX_THREADS)); n <<= 1)
+			retval = bench_step(tracer, n, runtime_ms);
+	}
+
+	return retval;
+}
+
+
+/***
+ * NAME
+ *   benchmark_list -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   This function does not return a value.
+ */
+void benchmark_list(void)
+{
+	int i;
+
+	(void)printf("Benchmarks are:\n");
+	for (i = 0; i < TABLESIZE(bench_def); i++)
+		(void)printf("  %-20s  %s\n", bench_def[i].name, bench_def[i].desc);
+	(void)printf("\n");
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
@@ -0,0 +1,376 @@
+/***
+ * Copyright 2020 HAProxy Technologies
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "include.h"
+
+
+#define CODEC_HEADERS   4
+
+#define ID_HIGH         UINT64_C(0x4bf92f3577b34da6)
+#define ID_LOW          UINT64_C(0xa3ce929d0e0e4736)
+#define ID_SPAN         UINT64_C(0x00f067aa0ba902b7)
+#define ID_PARENT       UINT64_C(0x05e3ac9a4f6e3b90)
+
+#define STR_HIGH        "4bf92f3577b34da6"
+#define STR_LOW         "a3ce929d0e0e4736"
+#define STR_SPAN        "00f067aa0ba902b7"
+#define STR_PARENT      "05e3ac9a4f6e3b90"
+
+#define FLAG_SAMPLED    OTC_TRACE_FLAG_SAMPLED
+#define FLAG_DEBUG      (OTC_TRACE_FLAG_SAMPLED | OTC_TRACE_FLAG_DEBUG)
+#define FLAG_DEFERRED   OTC_TRACE_FLAG_DEFERRED
+
+#define CODEC_CONTEXT(h,l,s,p,f)   { .trace_id_high = (h), .trace_id = (l), .span_id = (s), .parent_span_id = (p), .flags = (f) }
+
+
+/***
+ * A decode case: the headers of the carrier, the expected result and, on
+ * success, the expected trace context.
+ */
+static const struct codec_decode_case {
+	const char                   *name;
+	otc_propagation_format_t      format;
+	const char                   *key[CODEC_HEADERS];
+	const char                   *value[CODEC_HEADERS];
+	otc_propagation_error_code_t  rc;
+	struct otc_trace_context      context;
+} codec_decode_case[] = {
+	{ "jaeger",                   otc_propagation_format_jaeger,     { "uber-trace-id" }, { STR_HIGH ":" STR_SPAN ":0:1" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_SAMPLED) },
+	{ "jaeger %3A",               otc_propagation_format_jaeger,     { "Uber-Trace-Id" }, { STR_HIGH "%3A" STR_SPAN "%3a" STR_PARENT "%3A0" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, ID_PARENT, 0) },
+	{ "jaeger 128-bit",           otc_propagation_format_jaeger,     { "uber-trace-id" }, { STR_HIGH STR_LOW ":" STR_SPAN ":0:3" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, 0, FLAG_DEBUG) },
+	{ "jaeger short ids",         otc_propagation_format_jaeger,     { "uber-trace-id" }, { "1:2:0:1" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, 1, 2, 0, FLAG_SAMPLED) },
+	{ "jaeger 3 fields",          otc_propagation_format_jaeger,     { "uber-trace-id" }, { STR_HIGH ":" STR_SPAN ":0" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger 5 fields",          otc_propagation_format_jaeger,     { "uber-trace-id" }, { STR_HIGH ":" STR_SPAN ":0:1:0" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger bad digit",         otc_propagation_format_jaeger,     { "uber-trace-id" }, { "4bf92f3577b34dxx:" STR_SPAN ":0:1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger 33 digits",         otc_propagation_format_jaeger,     { "uber-trace-id" }, { "0" STR_HIGH STR_LOW ":" STR_SPAN ":0:1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger empty field",       otc_propagation_format_jaeger,     { "uber-trace-id" }, { STR_HIGH "::0:1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger zero trace id",     otc_propagation_format_jaeger,     { "uber-trace-id" }, { "0:" STR_SPAN ":0:1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger zero span id",      otc_propagation_format_jaeger,     { "uber-trace-id" }, { STR_HIGH ":0:0:1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "jaeger no header",         otc_propagation_format_jaeger,     { "x-b3-traceid" }, { STR_HIGH },
+	  otc_propagation_error_code_span_context_not_found, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+
+	{ "b3",                       otc_propagation_format_b3,         { "x-b3-traceid", "x-b3-spanid", "x-b3-parentspanid", "x-b3-sampled" }, { STR_HIGH STR_LOW, STR_SPAN, STR_PARENT, "1" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, ID_PARENT, FLAG_SAMPLED) },
+	{ "b3 case",                  otc_propagation_format_b3,         { "X-B3-TraceId", "X-B3-SpanId", "X-B3-Sampled" }, { STR_HIGH, STR_SPAN, "false" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, 0) },
+	{ "b3 deferred",              otc_propagation_format_b3,         { "x-b3-traceid", "x-b3-spanid" }, { STR_HIGH, STR_SPAN },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEFERRED) },
+	{ "b3 debug",                 otc_propagation_format_b3,         { "x-b3-flags", "x-b3-sampled", "x-b3-traceid", "x-b3-spanid" }, { "1", "0", STR_HIGH, STR_SPAN },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEBUG) },
+	{ "b3 sampling state only",   otc_propagation_format_b3,         { "x-b3-sampled" }, { "0" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "b3 bad sampling state",    otc_propagation_format_b3,         { "x-b3-traceid", "x-b3-spanid", "x-b3-sampled" }, { STR_HIGH, STR_SPAN, "2" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "b3 no span id",            otc_propagation_format_b3,         { "x-b3-traceid", "x-b3-sampled" }, { STR_HIGH, "1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "b3 zero span id",          otc_propagation_format_b3,         { "x-b3-traceid", "x-b3-spanid" }, { STR_HIGH, "0000000000000000" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+
+	{ "b3 single",                otc_propagation_format_b3_single,  { "b3" }, { STR_HIGH STR_LOW "-" STR_SPAN "-1-" STR_PARENT },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, ID_PARENT, FLAG_SAMPLED) },
+	{ "b3 single deferred",       otc_propagation_format_b3_single,  { "B3" }, { STR_HIGH "-" STR_SPAN },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEFERRED) },
+	{ "b3 single debug only",     otc_propagation_format_b3_single,  { "b3" }, { "d" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, 0, 0, 0, FLAG_DEBUG) },
+	{ "b3 single 5 fields",       otc_propagation_format_b3_single,  { "b3" }, { STR_HIGH "-" STR_SPAN "-1-" STR_PARENT "-1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "b3 single bad state",      otc_propagation_format_b3_single,  { "b3" }, { STR_HIGH "-" STR_SPAN "-x" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+
+	{ "w3c",                      otc_propagation_format_w3c,        { "traceparent" }, { "00-" STR_HIGH STR_LOW "-" STR_SPAN "-01" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, 0, FLAG_SAMPLED) },
+	{ "w3c not sampled",          otc_propagation_format_w3c,        { "Traceparent" }, { "00-" STR_HIGH STR_LOW "-" STR_SPAN "-00" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, 0, 0) },
+	{ "w3c future version",       otc_propagation_format_w3c,        { "traceparent" }, { "cc-" STR_HIGH STR_LOW "-" STR_SPAN "-01-what-the-future-holds" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, 0, FLAG_SAMPLED) },
+	{ "w3c version 00 extra",     otc_propagation_format_w3c,        { "traceparent" }, { "00-" STR_HIGH STR_LOW "-" STR_SPAN "-01-00" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "w3c version ff",           otc_propagation_format_w3c,        { "traceparent" }, { "ff-" STR_HIGH STR_LOW "-" STR_SPAN "-01" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "w3c short version",        otc_propagation_format_w3c,        { "traceparent" }, { "0-" STR_HIGH STR_LOW "-" STR_SPAN "-01" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "w3c 64-bit trace id",      otc_propagation_format_w3c,        { "traceparent" }, { "00-" STR_HIGH "-" STR_SPAN "-01" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "w3c zero trace id",        otc_propagation_format_w3c,        { "traceparent" }, { "00-00000000000000000000000000000000-" STR_SPAN "-01" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "w3c zero parent id",       otc_propagation_format_w3c,        { "traceparent" }, { "00-" STR_HIGH STR_LOW "-0000000000000000-01" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "w3c tracestate only",      otc_propagation_format_w3c,        { "tracestate" }, { "congo=t61rcWkgMzE" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, 0, 0, 0, FLAG_DEFERRED) },
+
+	{ "datadog",                  otc_propagation_format_datadog,    { "x-datadog-trace-id", "x-datadog-parent-id", "x-datadog-sampling-priority" }, { "1234567890", "9876543210", "2" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, UINT64_C(1234567890), UINT64_C(9876543210), 0, FLAG_DEBUG) },
+	{ "datadog drop",             otc_propagation_format_datadog,    { "x-datadog-trace-id", "x-datadog-parent-id", "x-datadog-sampling-priority" }, { "18446744073709551615", "1", "-1" },
+	  otc_propagation_error_code_success, CODEC_CONTEXT(0, UINT64_MAX, 1, 0, 0) },
+	{ "datadog overflow",         otc_propagation_format_datadog,    { "x-datadog-trace-id", "x-datadog-parent-id" }, { "18446744073709551616", "1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "datadog hex",              otc_propagation_format_datadog,    { "x-datadog-trace-id", "x-datadog-parent-id" }, { STR_HIGH, "1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "datadog zero trace id",    otc_propagation_format_datadog,    { "x-datadog-trace-id", "x-datadog-parent-id" }, { "0", "1" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+	{ "datadog bad priority",     otc_propagation_format_datadog,    { "x-datadog-trace-id", "x-datadog-parent-id", "x-datadog-sampling-priority" }, { "1", "1", "3" },
+	  otc_propagation_error_code_span_context_corrupted, CODEC_CONTEXT(0, 0, 0, 0, 0) },
+};
+
+/***
+ * An encode case: the trace context, the expected result and, on success,
+ * the expected headers.
+ */
+static const struct codec_encode_case {
+	const char                   *name;
+	otc_propagation_format_t      format;
+	struct otc_trace_context      context;
+	otc_propagation_error_code_t  rc;
+	const char                   *key[CODEC_HEADERS];
+	const char                   *value[CODEC_HEADERS];
+} codec_encode_case[] = {
+	{ "jaeger",                   otc_propagation_format_jaeger,     CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, ID_PARENT, FLAG_SAMPLED),
+	  otc_propagation_error_code_success, { "uber-trace-id" }, { STR_HIGH ":" STR_SPAN ":" STR_PARENT ":1" } },
+	{ "jaeger 128-bit",           otc_propagation_format_jaeger,     CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, 0, FLAG_DEBUG),
+	  otc_propagation_error_code_success, { "uber-trace-id" }, { STR_HIGH STR_LOW ":" STR_SPAN ":0000000000000000:3" } },
+	{ "jaeger not sampled",       otc_propagation_format_jaeger,     CODEC_CONTEXT(0, 1, 2, 0, 0),
+	  otc_propagation_error_code_success, { "uber-trace-id" }, { "0000000000000001:0000000000000002:0000000000000000:0" } },
+	{ "jaeger deferred",          otc_propagation_format_jaeger,     CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEFERRED),
+	  otc_propagation_error_code_invalid_span_context, { NULL }, { NULL } },
+	{ "jaeger zero trace id",     otc_propagation_format_jaeger,     CODEC_CONTEXT(0, 0, ID_SPAN, 0, FLAG_SAMPLED),
+	  otc_propagation_error_code_invalid_span_context, { NULL }, { NULL } },
+
+	{ "b3",                       otc_propagation_format_b3,         CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, ID_PARENT, FLAG_SAMPLED),
+	  otc_propagation_error_code_success, { "x-b3-traceid", "x-b3-spanid", "x-b3-parentspanid", "x-b3-sampled" }, { STR_HIGH STR_LOW, STR_SPAN, STR_PARENT, "1" } },
+	{ "b3 deferred",              otc_propagation_format_b3,         CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEFERRED),
+	  otc_propagation_error_code_success, { "x-b3-traceid", "x-b3-spanid" }, { STR_HIGH, STR_SPAN } },
+	{ "b3 debug",                 otc_propagation_format_b3,         CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEBUG),
+	  otc_propagation_error_code_success, { "x-b3-traceid", "x-b3-spanid", "x-b3-flags" }, { STR_HIGH, STR_SPAN, "1" } },
+	{ "b3 zero span id",          otc_propagation_format_b3,         CODEC_CONTEXT(0, ID_HIGH, 0, 0, FLAG_SAMPLED),
+	  otc_propagation_error_code_invalid_span_context, { NULL }, { NULL } },
+
+	{ "b3 single",                otc_propagation_format_b3_single,  CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, ID_PARENT, 0),
+	  otc_propagation_error_code_success, { "b3" }, { STR_HIGH STR_LOW "-" STR_SPAN "-0-" STR_PARENT } },
+	{ "b3 single deferred",       otc_propagation_format_b3_single,  CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, ID_PARENT, FLAG_DEFERRED),
+	  otc_propagation_error_code_success, { "b3" }, { STR_HIGH "-" STR_SPAN } },
+	{ "b3 single debug",          otc_propagation_format_b3_single,  CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, FLAG_DEBUG),
+	  otc_propagation_error_code_success, { "b3" }, { STR_HIGH "-" STR_SPAN "-d" } },
+
+	{ "w3c",                      otc_propagation_format_w3c,        { .trace_id_high = ID_HIGH, .trace_id = ID_LOW, .span_id = ID_SPAN, .flags = FLAG_SAMPLED, .tracestate = "congo=t61rcWkgMzE" },
+	  otc_propagation_error_code_success, { "traceparent", "tracestate" }, { "00-" STR_HIGH STR_LOW "-" STR_SPAN "-01", "congo=t61rcWkgMzE" } },
+	{ "w3c 64-bit trace id",      otc_propagation_format_w3c,        CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, 0),
+	  otc_propagation_error_code_success, { "traceparent" }, { "00-0000000000000000" STR_HIGH "-" STR_SPAN "-00" } },
+	{ "w3c debug",                otc_propagation_format_w3c,        CODEC_CONTEXT(0, ID_HIGH, ID_SPAN, 0, OTC_TRACE_FLAG_DEBUG | FLAG_DEFERRED),
+	  otc_propagation_error_code_success, { "traceparent" }, { "00-0000000000000000" STR_HIGH "-" STR_SPAN "-01" } },
+	{ "w3c deferred",             otc_propagation_format_w3c,        CODEC_CONTEXT(ID_HIGH, ID_LOW, ID_SPAN, 0, FLAG_DEFERRED),
+	  otc_propagation_error_code_invalid_span_context, { NULL }, { NULL } },
+	{ "w3c zero parent id",       otc_propagation_format_w3c,        CODEC_CONTEXT(ID_HIGH, ID_LOW, 0, 0, FLAG_SAMPLED),
+	  otc_propagation_error_code_invalid_span_context, { NULL }, { NULL } },
+
+	{ "datadog",                  otc_propagation_format_datadog,    CODEC_CONTEXT(0, UINT64_MAX, UINT64_C(9876543210), 0, FLAG_SAMPLED),
+	  otc_propagation_error_code_success, { "x-datadog-trace-id", "x-datadog-parent-id", "x-datadog-sampling-priority" }, { "18446744073709551615", "9876543210", "1" } },
+	{ "datadog deferred",         otc_propagation_format_datadog,    CODEC_CONTEXT(0, 1, 2, 0, FLAG_DEFERRED),
+	  otc_propagation_error_code_success, { "x-datadog-trace-id", "x-datadog-parent-id" }, { "1", "2" } },
+};
+
+
+/***
+ * NAME
+ *   codec_context_cmp -
+ *
+ * ARGUMENTS
+ *   a -
+ *   b -
+ *
+ * DESCRIPTION
+ *   Compares the ids and the flags of two trace contexts; the tracestate
+ *   member is not compared.
+ *
+ * RETURN VALUE
+ *   Returns true if the trace contexts are the same, false otherwise.
+ */
+static bool codec_context_cmp(const struct otc_trace_context *a, const struct otc_trace_context *b)
+{
+	return (a->trace_id_high == b->trace_id_high) && (a->trace_id == b->trace_id) && (a->span_id == b->span_id) && (a->parent_span_id == b->parent_span_id) && (a->flags == b->flags);
+}
+
+
+/***
+ * NAME
+ *   codec_test_decode -
+ *
+ * ARGUMENTS
+ *   test - the decode case
+ *
+ * DESCRIPTION
+ *   Decodes the headers of the case and checks the result.
+ *
+ * RETURN VALUE
+ *   Returns true if the case passed, false otherwise.
+ */
+static bool codec_test_decode(const struct codec_decode_case *test)
+{
+	struct otc_trace_context     context;
+	struct otc_text_map          text_map;
+	otc_propagation_error_code_t rc;
+
+	(void)memset(&text_map, 0, sizeof(text_map));
+	text_map.key   = (char **)test->key;
+	text_map.value = (char **)test->value;
+	for (text_map.count = 0; (text_map.count < CODEC_HEADERS) && _nNULL(test->key[text_map.count]); text_map.count++);
+	text_map.size  = text_map.count;
+
+	rc = otc_propagation_decode(&text_map, test->format, &context);
+	if (rc != test->rc) {
+		(void)printf("FAILED decode '%s': result %d, expected %d\n", test->name, rc, test->rc);
+
+		return false;
+	}
+	else if ((rc == otc_propagation_error_code_success) && !codec_context_cmp(&context, &(test->context))) {
+		(void)printf("FAILED decode '%s': %016" PRIx64 "%016" PRIx64 " %016" PRIx64 " %016" PRIx64 " %02x\n", test->name,
+		             context.trace_id_high, context.trace_id, context.span_id, context.parent_span_id, context.flags);
+
+		return false;
+	}
+
+	return true;
+}
+
+
+/***
+ * NAME
+ *   codec_test_encode -
+ *
+ * ARGUMENTS
+ *   test - the encode case
+ *
+ * DESCRIPTION
+ *   Encodes the trace context of the case and checks the headers.  The
+ *   headers are then decoded again; the trace context read back must be
+ *   the one that was written, except for the parts that the header format
+ *   cannot carry.
+ *
+ * RETURN VALUE
+ *   Returns true if the case passed, false otherwise.
+ */
+static bool codec_test_encode(const struct codec_encode_case *test)
+{
+	struct otc_trace_context      context, context_ex = test->context;
+	struct otc_text_map           text_map, *text_map_ptr = &text_map;
+	otc_propagation_error_code_t  rc;
+	char                          buffer[512];
+	bool                          retval = true;
+	size_t                        i;
+
+	(void)otc_text_map_arena_init(&text_map, CODEC_HEADERS, buffer, sizeof(buffer));
+
+	rc = otc_propagation_encode(&text_map, test->format, &(test->context));
+	if (rc != test->rc) {
+		(void)printf("FAILED encode '%s': result %d, expected %d\n", test->name, rc, test->rc);
+
+		retval = false;
+	}
+	else if (rc == otc_propagation_error_code_success) {
+		for (i = 0; (i < CODEC_HEADERS) && _nNULL(test->key[i]); i++)
+			if ((i >= text_map.count) || (strcmp(text_map.key[i], test->key[i]) != 0) || (strcmp(text_map.value[i], test->value[i]) != 0)) {
+				(void)printf("FAILED encode '%s': header %zu is '%s: %s', expected '%s: %s'\n", test->name, i,
+				             (i < text_map.count) ? text_map.key[i] : "", (i < text_map.count) ? text_map.value[i] : "", test->key[i], test->value[i]);
+
+				retval = false;
+			}
+
+		if (text_map.count != i) {
+			(void)printf("FAILED encode '%s': %zu headers, expected %zu\n", test->name, text_map.count, i);
+
+			retval = false;
+		}
+
+		/*
+		 * The decoder sets the debug flag together with the sampled
+		 * flag, DataDog has 64-bit ids without the parent span id and
+		 * W3C does not have the debug flag and the parent span id.
+		 */
+		if (context_ex.flags & OTC_TRACE_FLAG_DEBUG)
+			context_ex.flags = FLAG_DEBUG;
+		if (test->format == otc_propagation_format_datadog) {
+			context_ex.trace_id_high  = 0;
+			context_ex.parent_span_id = 0;
+		}
+		else if (test->format == otc_propagation_format_w3c) {
+			context_ex.parent_span_id = 0;
+			context_ex.flags         &= OTC_TRACE_FLAG_SAMPLED;
+		}
+		else if ((test->format == otc_propagation_format_b3_single) && (context_ex.flags & FLAG_DEFERRED)) {
+			context_ex.parent_span_id = 0;
+		}
+
+		if (retval && ((otc_propagation_decode(&text_map, test->format, &context) != otc_propagation_error_code_success) || !codec_context_cmp(&context, &context_ex))) {
+			(void)printf("FAILED encode '%s': the decoded trace context differs\n", test->name);
+
+			retval = false;
+		}
+	}
+
+	otc_text_map_destroy(&text_map_ptr, 0);
+
+	return retval;
+}
+
+
+/***
+ * NAME
+ *   codec_test -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   Runs the decode and encode cases of the wrapper's own trace context
+ *   codecs.  The tracer is not needed for that.
+ *
+ * RETURN VALUE
+ *   Returns the number of the cases that failed.
+ */
+int codec_test(void)
+{
+	int i, retval = 0;
+
+	for (i = 0; i < TABLESIZE(codec_decode_case); i++)
+		if (!codec_test_decode(codec_decode_case + i))
+			retval++;
+
+	for (i = 0; i < TABLESIZE(codec_encode_case); i++)
+		if (!codec_test_encode(codec_encode_case + i))
+			retval++;
+
+	(void)printf("codec: %d cases, %d failed\n", TABLESIZE(codec_decode_case) + TABLESIZE(codec_encode_case), retval);
+
+	return retval;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 8
+ *  c-basic-offset: 8
+ * End:
+ *
+ * vi: noexpandtab shiftwidth=8 tabstop=8
+ */
@@ -52,6 +52,8 @@
 
 #include "version.h"
 #include "debug.h"
+#include "benchmark.h"
+#include "codec.h"
 #include "opentracing.h"
 #include "util.h"
 
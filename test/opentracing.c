@@ -118,7 +118,7 @@ int ot_span_tag(struct otc_span *span, const char *key, int type, ...)
 			ot_value.value.string_value = va_arg(ap, typeof(ot_value.value.string_value));
 		else if (type == otc_value_null)
 			ot_value.value.string_value = va_arg(ap, typeof(ot_value.value.string_value));
-		span->set_tag(span, key, &ot_value);
+		otc_span_set_tag(span, key, &ot_value);
 
 		if (_nNULL(key = va_arg(ap, typeof(key))))
 			type = va_arg(ap, typeof(type));
@@ -158,7 +158,7 @@ int ot_span_set_baggage(struct otc_span *span, const char *key, const char *valu
 	for (retval = 0; _nNULL(key); retval++) {
 		OT_DBG(OT, "set baggage: \"%s\" \"%s\"", key, value);
 
-		span->set_baggage_item(span, key, value);
+		otc_span_set_baggage_item(span, key, value);
 
 		if (_nNULL(key = va_arg(ap, typeof(key))))
 			value = va_arg(ap, typeof(value));
@@ -205,7 +205,7 @@ struct otc_text_map *ot_span_baggage(const struct otc_span *span, const char *ke
 	for (i = 0; (i < n) && _nNULL(key); i++) {
 		char *value;
 
-		if (_nNULL(value = (char *)span->baggage_item(span, key))) {
+		if (_nNULL(value = (char *)otc_span_baggage_item(span, key)) && (*value != '\0')) {
 			(void)otc_text_map_add(retptr, key, 0, value, 0, OTC_TEXT_MAP_DUP_KEY);
 
 			OT_DBG(OT, "get baggage[%d]: \"%s\" -> \"%s\"", i, retptr->key[i], retptr->value[i]);
@@ -258,7 +258,7 @@ int ot_span_log_kv(struct otc_span *span, const char *key, const char *value, ..
 	}
 	va_end(ap);
 
-	span->log_fields(span, log_data, retval);
+	otc_span_log_fields(span, log_data, retval);
 
 	return retval;
 }
@@ -390,7 +390,7 @@ struct otc_span_context *ot_inject_text_map(struct otc_tracer *tracer, const str
 	if (_NULL(span))
 		return retptr;
 
-	if (_NULL(retptr = span->span_context((struct otc_span *)span)))
+	if (_NULL(retptr = otc_span_get_context((struct otc_span *)span)))
 		return retptr;
 
 	(void)memset(carrier, 0, sizeof(*carrier));
@@ -402,7 +402,7 @@ struct otc_span_context *ot_inject_text_map(struct otc_tracer *tracer, const str
 	if (rc != otc_propagation_error_code_success) {
 		OT_LOG("  ERROR: inject_text_map() failed: %d", rc);
 
-		OTC_DBG_FREE(retptr);
+		retptr->destroy(&retptr);
 	} else {
 		OT_DBG(OT, "context %p: { %" PRId64 " %p %p }", retptr, retptr->idx, retptr->span, retptr->destroy);
 	}
@@ -450,7 +450,8 @@ struct otc_span_context *ot_extract_text_map(struct otc_tracer *tracer, struct o
 	if (rc != otc_propagation_error_code_success) {
 		OT_LOG("  ERROR: extract_text_map() failed: %d", rc);
 
-		OTC_DBG_FREE(retptr);
+		if (_nNULL(retptr))
+			retptr->destroy(&retptr);
 	}
 	else if (_nNULL(retptr)) {
 		OT_DBG(OT, "context %p: { %" PRId64 " %p %p }", retptr, retptr->idx, retptr->span, retptr->destroy);
@@ -553,7 +554,7 @@ struct otc_span_context *ot_inject_http_headers(struct otc_tracer *tracer, const
 	if (_NULL(span))
 		return retptr;
 
-	if (_NULL(retptr = span->span_context((struct otc_span *)span)))
+	if (_NULL(retptr = otc_span_get_context((struct otc_span *)span)))
 		return retptr;
 
 	(void)memset(carrier, 0, sizeof(*carrier));
@@ -565,7 +566,7 @@ struct otc_span_context *ot_inject_http_headers(struct otc_tracer *tracer, const
 	if (rc != otc_propagation_error_code_success) {
 		OT_LOG("  ERROR: inject_http_headers() failed: %d", rc);
 
-		OTC_DBG_FREE(retptr);
+		retptr->destroy(&retptr);
 	} else {
 		OT_DBG(OT, "context %p: { %" PRId64 " %p %p }", retptr, retptr->idx, retptr->span, retptr->destroy);
 	}
@@ -613,7 +614,8 @@ struct otc_span_context *ot_extract_http_headers(struct otc_tracer *tracer, stru
 	if (rc != otc_propagation_error_code_success) {
 		OT_LOG("  ERROR: extract_http_headers() failed: %d", rc);
 
-		OTC_DBG_FREE(retptr);
+		if (_nNULL(retptr))
+			retptr->destroy(&retptr);
 	}
 	else if (_nNULL(retptr)) {
 		OT_DBG(OT, "context %p: { %" PRId64 " %p %p }", retptr, retptr->idx, retptr->span, retptr->destroy);
@@ -648,7 +650,7 @@ struct otc_span_context *ot_inject_binary(struct otc_tracer *tracer, const struc
 	if (_NULL(span))
 		return retptr;
 
-	if (_NULL(retptr = span->span_context((struct otc_span *)span)))
+	if (_NULL(retptr = otc_span_get_context((struct otc_span *)span)))
 		return retptr;
 
 	(void)memset(carrier, 0, sizeof(*carrier));
@@ -657,7 +659,7 @@ struct otc_span_context *ot_inject_binary(struct otc_tracer *tracer, const struc
 	if (rc != otc_propagation_error_code_success) {
 		OT_LOG("  ERROR: inject_binary() failed: %d", rc);
 
-		OTC_DBG_FREE(retptr);
+		retptr->destroy(&retptr);
 	} else {
 		OT_DBG(OT, "context %p: { %" PRId64 " %p %p }", retptr, retptr->idx, retptr->span, retptr->destroy);
 	}
@@ -716,7 +718,8 @@ struct otc_span_context *ot_extract_binary(struct otc_tracer *tracer, struct otc
 	if (rc != otc_propagation_error_code_success) {
 		OT_LOG("  ERROR: extract_binary() failed: %d", rc);
 
-		OTC_DBG_FREE(retptr);
+		if (_nNULL(retptr))
+			retptr->destroy(&retptr);
 	}
 	else if (_nNULL(retptr)) {
 		OT_DBG(OT, "context %p: { %" PRId64 " %p %p }", retptr, retptr->idx, retptr->span, retptr->destroy);
@@ -756,7 +759,7 @@ void ot_span_finish(struct otc_span **span, const struct timespec *ts_finish)
 
 	OT_DBG(OT, "span %p:%zu finished", *span, (*span)->idx);
 
-	(*span)->finish_with_options(*span, &options);
+	otc_span_finish_with_options(*span, &options);
 
 	*span = NULL;
 }
@@ -25,6 +25,7 @@ typedef unsigned char bool_t;
 enum FLAG_OPT_enum {
 	FLAG_OPT_HELP    = 0x01,
 	FLAG_OPT_VERSION = 0x02,
+	FLAG_OPT_CODEC   = 0x04,
 };
 
 static struct {
@@ -33,6 +34,7 @@ static struct {
 	int                runcount;
 	int                runtime_ms;
 	int                threads;
+	const char        *benchmark;
 	const char        *ot_config;
 	const char        *ot_plugin;
 	struct otc_tracer *ot_tracer;
@@ -320,6 +322,37 @@ static int worker_run(void)
 }
 
 
+/***
+ * NAME
+ *   benchmark -
+ *
+ * ARGUMENTS
+ *   This function takes no arguments.
+ *
+ * DESCRIPTION
+ *   -
+ *
+ * RETURN VALUE
+ *   -
+ */
+static int benchmark(void)
+{
+	char ot_infbuf[BUFSIZ];
+	int  retval;
+
+	OT_FUNC("");
+
+	retval = benchmark_run(cfg.ot_tracer, cfg.benchmark, cfg.threads, cfg.runtime_ms, cfg.runcount);
+
+	cfg.ot_tracer->close(cfg.ot_tracer);
+
+	otc_statistics(ot_infbuf, sizeof(ot_infbuf));
+	OT_LOG("OpenTracing statistics: %s", ot_infbuf);
+
+	return retval;
+}
+
+
 /***
  * NAME
  *   usage -
@@ -338,20 +371,24 @@ static void usage(const char *program_name, bool_t flag_verbose)
 {
 	(void)printf("\nUsage: %s { -h --help }\n", program_name);
 	(void)printf("       %s { -V --version }\n", program_name);
+	(void)printf("       %s { -C --codec }\n", program_name);
 	(void)printf("       %s { -c --config=FILE } { -p --plugin=FILE } { [ -R --runcount=VALUE ] | [ -r --runtime=TIME ] } [OPTION]...\n\n", program_name);
 
 	if (flag_verbose) {
 		(void)printf("Options are:\n");
+		(void)printf("  -b, --benchmark=NAME  Run the named benchmark with 1, 2, 4, ... %d threads.\n", BENCHMARK_MAX_THREADS);
+		(void)printf("  -C, --codec           Run the trace context codec tests, no tracer is needed.\n");
 		(void)printf("  -c, --config=FILE     Specify the configuration for the used tracer.\n");
 #ifdef DEBUG
 		(void)printf("  -d, --debug=LEVEL     Enable and specify the debug mode level (default: %d).\n", DEFAULT_DEBUG_LEVEL);
 #endif
 		(void)printf("  -h, --help            Show this text.\n");
-		(void)printf("  -p, --plugin=FILE     Specify the OpenTracing compatible plugin library.\n");
+		(void)printf("  -p, --plugin=FILE     Specify the OpenTracing compatible plugin library ('noop' for none).\n");
 		(void)printf("  -R, --runcount=VALUE  Execute this program a certain number of passes (0 = unlimited).\n");
 		(void)printf("  -r, --runtime=TIME    Run this program for a certain amount of time (ms, 0 = unlimited).\n");
 		(void)printf("  -t, --threads=VALUE   Specify the number of threads (default: %d).\n", DEFAULT_THREADS_COUNT);
 		(void)printf("  -V, --version         Show program version.\n\n");
+		benchmark_list();
 		(void)printf("Copyright 2020 HAProxy Technologies\n");
 		(void)printf("SPDX-License-Identifier: Apache-2.0\n\n");
 	} else {
@@ -363,23 +400,25 @@ static void usage(const char *program_name, bool_t flag_verbose)
 int main(int argc, char **argv)
 {
 	static const struct option longopts[] = {
-		{ "config",   required_argument, NULL, 'c' },
+		{ "benchmark", required_argument, NULL, 'b' },
+		{ "codec",     no_argument,       NULL, 'C' },
+		{ "config",    required_argument, NULL, 'c' },
 #ifdef DEBUG
-		{ "debug",    required_argument, NULL, 'd' },
+		{ "debug",     required_argument, NULL, 'd' },
 #endif
-		{ "help",     no_argument,       NULL, 'h' },
-		{ "plugin",   required_argument, NULL, 'p' },
-		{ "runcount", required_argument, NULL, 'R' },
-		{ "runtime",  required_argument, NULL, 'r' },
-		{ "threads",  required_argument, NULL, 't' },
-		{ "version",  no_argument,       NULL, 'V' },
-		{ NULL,       0,                 NULL, 0   }
+		{ "help",      no_argument,       NULL, 'h' },
+		{ "plugin",    required_argument, NULL, 'p' },
+		{ "runcount",  required_argument, NULL, 'R' },
+		{ "runtime",   required_argument, NULL, 'r' },
+		{ "threads",   required_argument, NULL, 't' },
+		{ "version",   no_argument,       NULL, 'V' },
+		{ NULL,        0,                 NULL, 0   }
 	};
 #ifdef OTC_DBG_MEM
 	static struct otc_dbg_mem_data  dbg_mem_data[1000000];
 	struct otc_dbg_mem              dbg_mem;
 #endif
-	const char                     *shortopts = "c:d:hp:R:r:t:V";
+	const char                     *shortopts = "b:Cc:d:hp:R:r:t:V";
 	struct timeval                  now;
 	int                             c, longopts_idx = -1, retval = EX_OK;
 	bool_t                          flag_error = 0;
@@ -399,7 +438,11 @@ int main(int argc, char **argv)
 #endif
 
 	while ((c = getopt_long(argc, argv, shortopts, longopts, &longopts_idx)) != EOF) {
-		if (c == 'c')
+		if (c == 'b')
+			cfg.benchmark = optarg;
+		else if (c == 'C')
+			cfg.opt_flags |= FLAG_OPT_CODEC;
+		else if (c == 'c')
 			cfg.ot_config = optarg;
 #ifdef DEBUG
 		else if (c == 'd')
@@ -427,7 +470,7 @@ int main(int argc, char **argv)
 	else if (cfg.opt_flags & FLAG_OPT_VERSION) {
 		(void)printf("\n%s v%s [build %d] by %s, %s\n\n", prg.name, PACKAGE_VERSION, PACKAGE_BUILD, PACKAGE_AUTHOR, __DATE__);
 	}
-	else {
+	else if (!(cfg.opt_flags & FLAG_OPT_CODEC)) {
 		if ((cfg.runcount < 0) && (cfg.runtime_ms < 0)) {
 			(void)fprintf(stderr, "ERROR: run count/time value not set\n");
 			flag_error = 1;
@@ -451,6 +494,8 @@ int main(int argc, char **argv)
 
 	if (flag_error || (cfg.opt_flags & (FLAG_OPT_HELP | FLAG_OPT_VERSION)))
 		return flag_error ? EX_USAGE : EX_OK;
+	else if (cfg.opt_flags & FLAG_OPT_CODEC)
+		return (codec_test() == 0) ? EX_OK : EX_SOFTWARE;
 
 	if (_NULL(cfg.ot_tracer = otc_tracer_load(cfg.ot_plugin, ot_errbuf, sizeof(ot_errbuf)))) {
 		(void)fprintf(stderr, "ERROR: %s\n", (*ot_errbuf == '\0') ? "Unable to load tracing library" : ot_errbuf);
@@ -462,6 +507,9 @@ int main(int argc, char **argv)
 
 		retval = EX_SOFTWARE;
 	}
+	else if (_nNULL(cfg.benchmark)) {
+		retval = benchmark();
+	}
 	else {
 		retval = worker_run();
 	}